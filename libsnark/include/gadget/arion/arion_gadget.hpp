@@ -109,10 +109,11 @@ public:
 
                 i[k] += constrain(sigma, sigma, inter[k][i[k]]);
 
-                // g(x) = s^2 + a1*s + a2
-                g = inter[k][i[k] - 1] + Hash::alpha.first * sigma + Hash::alpha.second;
-                // h(x) = s^2 + b*s
-                sigma = inter[k][i[k] - 1] + Hash::beta1 * sigma;
+                // g_k(x) = s^2 + a_k1*s + a_k2
+                g = inter[k][i[k] - 1] + Hash::alpha[j * (BRANCH_N - 1) + k].first * sigma +
+                    Hash::alpha[j * (BRANCH_N - 1) + k].second;
+                // h_k(x) = s^2 + b_k*s
+                sigma = inter[k][i[k] - 1] + Hash::beta[j * (BRANCH_N - 1) + k] * sigma;
                 // y = x^d * g(x) + h(x) <==> y - h(x) = x^d * g(x)
                 i[k] += constrain(inter[k][i[k] - 2], g, inter[k][i[k]] - sigma);
             }
@@ -197,10 +198,11 @@ public:
 
                 val(inter[k][i[k]]) = sigma * sigma;
                 ++i[k];
-                // g(x) = s^2 + a1*s + a2
-                g = val(inter[k][i[k] - 1]) + Hash::alpha.first * sigma + Hash::alpha.second;
-                // h(x) = s^2 + b*s
-                sigma = val(inter[k][i[k] - 1]) + Hash::beta1 * sigma;
+                // g_k(x) = s^2 + a_k1*s + a_k2
+                g = val(inter[k][i[k] - 1]) + Hash::alpha[j * (BRANCH_N - 1) + k].first * sigma +
+                    Hash::alpha[j * (BRANCH_N - 1) + k].second;
+                // h_k(x) = s^2 + b_k*s
+                sigma = val(inter[k][i[k] - 1]) + Hash::beta[j * (BRANCH_N - 1) + k] * sigma;
                 // y = x^d * g(x) + h(x)
                 val(inter[k][i[k]]) = val(inter[k][i[k] - 2]) * g + sigma;
                 ++i[k];
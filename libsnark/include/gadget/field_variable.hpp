@@ -1,9 +1,9 @@
 #pragma once
 
 #include "gadget/gadget_pp.hpp"
+#include "util/algebra.hpp"
 #include "util/ranges.hpp"
 #include "util/string_utils.hpp"
-#include <gmpxx.h>
 
 template<typename FieldT>
 class FieldVariable : public GadgetPP<FieldT>
@@ -45,16 +45,14 @@ public:
 
             static constexpr size_t IT_SIZE = sizeof(decltype(*it));
 
-            mpz_class tmp;
             uint8_t buff[FIELD_SIZE];
 
             for (size_t i = 0; i < vars.size() && it != end; ++i)
             {
                 for (size_t j = 0; j < FIELD_SIZE; j += IT_SIZE, ++it)
                     memcpy(buff + j, &*it, IT_SIZE);
-                mpz_import(tmp.get_mpz_t(), FIELD_SIZE, 1, 1, 0, 0, buff);
 
-                val(vars[i]) = FieldT{tmp.get_mpz_t()};
+                val(vars[i]) = field_from_bytes<FieldT>(buff, FIELD_SIZE);
             }
         }
     }
@@ -62,14 +60,9 @@ public:
     void generate_r1cs_witness(const void *data, size_t sz)
     {
         const char *d = (const char *)data;
-        mpz_class tmp;
 
         for (size_t i = 0, n = std::min(sz / FIELD_SIZE, vars.size()); i < n; ++i)
-        {
-            mpz_import(tmp.get_mpz_t(), FIELD_SIZE, 1, 1, 0, 0, d + FIELD_SIZE * i);
-
-            val(vars[i]) = FieldT{tmp.get_mpz_t()};
-        }
+            val(vars[i]) = field_from_bytes<FieldT>(d + FIELD_SIZE * i, FIELD_SIZE);
     }
 
     const auto &operator[](size_t i) const { return vars[i]; }
@@ -4,6 +4,7 @@
 #include "gadget/field_variable.hpp"
 #include "gadget/pb_variable_pp.hpp"
 #include "util/array_utils.hpp"
+#include "util/const_math.hpp"
 #include <iostream>
 #include <string>
 #include <type_traits>
@@ -23,6 +24,7 @@ public:
     static constexpr size_t DIGEST_VARS = GadHash::DIGEST_VARS;
     static constexpr size_t DIGEST_SIZE = GadHash::DIGEST_SIZE;
     static constexpr size_t ARITY = GadHash::BLOCK_SIZE / GadHash::DIGEST_SIZE;
+    static constexpr size_t LEAVES_N = pow(ARITY, HEIGHT - 1);
     static constexpr bool HASH_ISBOOLEAN = DIGEST_SIZE < DIGEST_VARS;
 
     using LC = libsnark::linear_combination<Field>;
@@ -43,18 +45,30 @@ private:
     std::vector<Level> children;
     std::vector<GadHash> hash;
     std::vector<BoolLevel> active;
+    // Leaves of the tree, the index is checked to be below it when the tree is not complete
+    size_t leaves_n;
+    // tight[i] = 1 while the choices above level i equal the digits of leaves_n - 1
+    std::vector<PbVar> tight;
 
 public:
     const DigVar out;
 
     MTreeGadget(Protoboard &pb, const DigVar &out, const DigVar &trans,
-                const std::vector<Level> &other, const PbVar &idx, const std::string &ap) :
-        super{pb, ap}, //
-        trans{trans},  //
-        other{other},  //
-        idx{idx},      //
-        out{out}       //
+                const std::vector<Level> &other, const PbVar &idx, const std::string &ap,
+                size_t leaves_n = LEAVES_N) :
+        super{pb, ap},      //
+        trans{trans},       //
+        other{other},       //
+        idx{idx},           //
+        leaves_n{leaves_n}, //
+        out{out}            //
     {
+        if (leaves_n == 0 || leaves_n > LEAVES_N)
+        {
+            std::cerr << "MTreeGadget: Bad number of leaves\n";
+            this->leaves_n = LEAVES_N;
+        }
+
         for (size_t i = 0; i < HEIGHT1; ++i)
         {
             // inputs for the hash gadget
@@ -71,8 +85,15 @@ public:
             else
                 hash.emplace_back(pb, children[i], inter[i], FMT(""));
         }
+
+        if (this->leaves_n < LEAVES_N)
+            for (size_t i = 0; i + 1 < HEIGHT1; ++i)
+                tight.emplace_back(pb, FMT(""));
     }
 
+    // Choice bits of every level from the leaves, one set per level
+    const std::vector<BoolLevel> &choices() const { return active; }
+
     void generate_r1cs_constraints()
     {
         LC sigma{0};
@@ -82,16 +103,43 @@ public:
         for (size_t i = 0; i < HEIGHT1; ++i, coeff *= ARITY)
         {
             LC sigma_l{0};
-            Field coeff_l{1};
+            Field coeff_l{0};
+            LC ones{0};
 
             // active = 0/1, multiplied by its position k gives the level index (0/k)
             for (size_t j = 0; j < ARITY; ++j, ++coeff_l)
+            {
+                constrain(active[i][j], 1 - active[i][j], 0);
                 sigma_l = sigma_l + active[i][j] * coeff_l;
+                ones = ones + active[i][j];
+            }
+            // exactly one child is on the path
+            constrain(ones, 1, 1);
             // multiplied by the level coefficient gives the polynomial component (k * ARITY^i)
-            sigma = sigma * coeff;
+            sigma = sigma + sigma_l * coeff;
         }
         constrain(sigma, 1, idx);
 
+        /*
+        idx < leaves_n, compared digit by digit from the root with the last leaf leaves_n - 1.
+        While the choices above a level equal its digits, the choice of the level must not exceed
+        its digit, so the index cannot point into the zero padding of a non-full tree.
+        */
+        if (leaves_n < LEAVES_N)
+            for (size_t i = HEIGHT1, last = leaves_n - 1; i-- > 0;)
+            {
+                const size_t digit = last / pow(ARITY, i) % ARITY;
+                const LC in = i + 1 == HEIGHT1 ? LC{1} : LC{tight[i]};
+                LC above{0};
+
+                for (size_t j = digit + 1; j < ARITY; ++j)
+                    above = above + active[i][j];
+
+                constrain(in, above, 0);
+                if (i > 0)
+                    constrain(in, active[i][digit], tight[i - 1]);
+            }
+
         // Constraints for layers
         for (size_t i = 0; i < HEIGHT1; ++i)
         {
@@ -147,5 +195,12 @@ public:
             }
             hash[i].generate_r1cs_witness();
         }
+
+        for (size_t i = HEIGHT1 - 1, last = leaves_n - 1; i-- > 0 && !tight.empty();)
+        {
+            const Field in = i + 2 == HEIGHT1 ? Field{1} : val(tight[i + 1]);
+
+            val(tight[i]) = in * val(active[i + 1][last / pow(ARITY, i + 1) % ARITY]);
+        }
     }
 };
@@ -38,8 +38,14 @@ private:
     static constexpr size_t INTER0_N = 3 * ROUNDS_N;
     static constexpr size_t INTERk_N = 3 * ROUNDS_F;
 
-    static constexpr auto &rc = Hash::round_c;
+    static constexpr size_t SPARSE_N = Hash::SPARSE_N;
+
+    // Optimized form of the rounds, see Poseidon5::Optimized
+    static constexpr auto &fc = Hash::opt.full_c;
+    static constexpr auto &pc = Hash::opt.partial_c;
+    static constexpr auto &sparse = Hash::opt.sparse_mat;
     static constexpr auto &mds = Hash::mds_mat;
+    static constexpr auto &pre = Hash::opt.pre_mat;
 
     std::vector<PbVariablePP<Field>> inter[BRANCH_N];
 
@@ -59,7 +65,7 @@ public:
 
     void generate_r1cs_constraints()
     {
-        LC s[BRANCH_N];
+        LC s;
         LC t[BRANCH_N]{};
         size_t i[BRANCH_N]{};
         size_t ri = 0;
@@ -73,39 +79,39 @@ public:
             // (x+c)^5
             for (size_t k = 0; k < BRANCH_N; ++k)
             {
-                t[k] = t[k] + rc[ri++];
+                t[k] = t[k] + fc[ri++];
                 i[k] += constrain(t[k], t[k], inter[k][i[k]]);
                 i[k] += constrain(inter[k][i[k] - 1], inter[k][i[k] - 1], inter[k][i[k]]);
                 i[k] += constrain(t[k], inter[k][i[k] - 1], inter[k][i[k]]);
             }
-            // MDS multiplication
+            // MDS multiplication, the last one also applies D_1 of the first partial round
+            const auto &mat = j + 1 < ROUNDS_f ? mds : pre;
+
             for (size_t k = 0; k < BRANCH_N; ++k)
             {
-                t[k] = mds[k * BRANCH_N] * inter[0][i[0] - 1];
+                t[k] = mat[k * BRANCH_N] * inter[0][i[0] - 1];
                 for (size_t l = 1; l < BRANCH_N; ++l)
-                    t[k] = t[k] + mds[k * BRANCH_N + l] * inter[l][i[l] - 1];
+                    t[k] = t[k] + mat[k * BRANCH_N + l] * inter[l][i[l] - 1];
             }
         }
         // PARTIAL SBOX
         for (size_t j = 0; j < ROUNDS_P; ++j)
         {
-            // (x+c)^5 for first element
-            t[0] = t[0] + rc[ri++];
+            // (x+c)^5 for first element, the only one with a constant
+            t[0] = t[0] + pc[j];
             i[0] += constrain(t[0], t[0], inter[0][i[0]]);
             i[0] += constrain(inter[0][i[0] - 1], inter[0][i[0] - 1], inter[0][i[0]]);
             i[0] += constrain(inter[0][i[0] - 1], t[0], inter[0][i[0]]);
 
-            // MDS multiplication, other elements get only addition
-            for (size_t k = 0; k < BRANCH_N; ++k)
-            {
-                s[k] = mds[k * BRANCH_N] * inter[0][i[0] - 1];
-                for (size_t l = 1; l < BRANCH_N; ++l)
-                    s[k] = s[k] + mds[k * BRANCH_N + l] * (t[l] + rc[ri + l - 1]);
-            }
-            for (size_t k = 0; k < BRANCH_N; ++k)
-                t[k] = s[k];
+            // Sparse matrix, dense first row and other elements get a multiple of the first
+            const Field *sp = &sparse[j * SPARSE_N];
 
-            ri += BRANCH_N - 1;
+            s = sp[0] * inter[0][i[0] - 1];
+            for (size_t l = 1; l < BRANCH_N; ++l)
+                s = s + sp[l] * t[l];
+            for (size_t k = 1; k < BRANCH_N; ++k)
+                t[k] = t[k] + sp[BRANCH_N + k - 1] * inter[0][i[0] - 1];
+            t[0] = s;
         }
 
         // FINAL FULL SBOX
@@ -114,7 +120,7 @@ public:
             // (x+c)^5
             for (size_t k = 0; k < BRANCH_N; ++k)
             {
-                t[k] = t[k] + rc[ri++];
+                t[k] = t[k] + fc[ri++];
                 i[k] += constrain(t[k], t[k], inter[k][i[k]]);
                 i[k] += constrain(inter[k][i[k] - 1], inter[k][i[k] - 1], inter[k][i[k]]);
                 i[k] += constrain(t[k], inter[k][i[k] - 1], inter[k][i[k]]);
@@ -132,7 +138,7 @@ public:
 
     void generate_r1cs_witness()
     {
-        Field s[BRANCH_N];
+        Field s;
         Field t[BRANCH_N]{};
         size_t i[BRANCH_N]{};
         size_t ri = 0;
@@ -146,7 +152,7 @@ public:
             // (x+c)^5
             for (size_t k = 0; k < BRANCH_N; ++k)
             {
-                t[k] += rc[ri++];
+                t[k] += fc[ri++];
                 val(inter[k][i[k]]) = t[k] * t[k];
                 ++i[k];
                 val(inter[k][i[k]]) = val(inter[k][i[k] - 1]) * val(inter[k][i[k] - 1]);
@@ -154,12 +160,14 @@ public:
                 val(inter[k][i[k]]) = t[k] * val(inter[k][i[k] - 1]);
                 ++i[k];
             }
-            // MDS multiplication
+            // MDS multiplication, the last one also applies D_1 of the first partial round
+            const auto &mat = j + 1 < ROUNDS_f ? mds : pre;
+
             for (size_t k = 0; k < BRANCH_N; ++k)
             {
-                t[k] = mds[k * BRANCH_N] * val(inter[0][i[0] - 1]);
+                t[k] = mat[k * BRANCH_N] * val(inter[0][i[0] - 1]);
                 for (size_t l = 1; l < BRANCH_N; ++l)
-                    t[k] += mds[k * BRANCH_N + l] * val(inter[l][i[l] - 1]);
+                    t[k] += mat[k * BRANCH_N + l] * val(inter[l][i[l] - 1]);
             }
         }
 
@@ -167,7 +175,7 @@ public:
         for (size_t j = 0; j < ROUNDS_P; ++j)
         {
             // (x+c)^5 only for first element
-            t[0] += rc[ri++];
+            t[0] += pc[j];
             val(inter[0][i[0]]) = t[0] * t[0];
             ++i[0];
             val(inter[0][i[0]]) = val(inter[0][i[0] - 1]) * val(inter[0][i[0] - 1]);
@@ -175,17 +183,15 @@ public:
             val(inter[0][i[0]]) = t[0] * val(inter[0][i[0] - 1]);
             ++i[0];
 
-            // MDS multiplication
-            for (size_t k = 0; k < BRANCH_N; ++k)
-            {
-                s[k] = mds[k * BRANCH_N] * val(inter[0][i[0] - 1]);
-                for (size_t l = 1; l < BRANCH_N; ++l)
-                    s[k] += mds[k * BRANCH_N + l] * (t[l] + rc[ri + l - 1]);
-            }
-            for (size_t k = 0; k < BRANCH_N; ++k)
-                t[k] = s[k];
+            // Sparse matrix
+            const Field *sp = &sparse[j * SPARSE_N];
 
-            ri += BRANCH_N - 1;
+            s = sp[0] * val(inter[0][i[0] - 1]);
+            for (size_t l = 1; l < BRANCH_N; ++l)
+                s += sp[l] * t[l];
+            for (size_t k = 1; k < BRANCH_N; ++k)
+                t[k] += sp[BRANCH_N + k - 1] * val(inter[0][i[0] - 1]);
+            t[0] = s;
         }
 
         // FINAL FULL SBOX
@@ -194,7 +200,7 @@ public:
             // (x+c)^5
             for (size_t k = 0; k < BRANCH_N; ++k)
             {
-                t[k] += rc[ri++];
+                t[k] += fc[ri++];
                 val(inter[k][i[k]]) = t[k] * t[k];
                 ++i[k];
                 val(inter[k][i[k]]) = val(inter[k][i[k] - 1]) * val(inter[k][i[k] - 1]);
@@ -1,6 +1,10 @@
 #pragma once
 
+#include "util/addition_chain.hpp"
 #include "util/algebra.hpp"
+#include "util/constants.hpp"
+#include "util/field_lanes.hpp"
+#include "util/lazy_field.hpp"
 
 template<typename FieldT = libff::Fq<libff::default_ec_pp>, size_t rate = 2, size_t capacity = 1,
          size_t rounds = 9>
@@ -15,6 +19,8 @@ public:
     static constexpr size_t DIGEST_SIZE = field_size<Field>();
     static constexpr size_t BLOCK_SIZE = DIGEST_SIZE * RATE;
     static constexpr size_t BRANCH_N = RATE + CAPACITY;
+    // Number of independent permutations interleaved by hash_oneblock_many
+    static constexpr size_t LANES_N = 4;
 
     using Sponge = std::array<Field, BRANCH_N>;
 
@@ -26,11 +32,37 @@ public:
     static inline const Field d{5};
     static inline const Field e{inverse(FieldT{257}, Field{-1})};
 
-    static inline const std::pair<Field, Field> alpha{get_irreducible_pair<Field>(~0ULL)};
-    static inline const Field beta1{Field::random_element()};
+    // Constants of g_i and h_i, one per round and per branch but the last
+    static constexpr size_t GH_N = ROUNDS_N * (BRANCH_N - 1);
 
+    using Limbs = typename ConstantStream<Field::num_limbs>::Limbs;
+
+    struct Constants
+    {
+        std::array<std::array<Limbs, 2>, GH_N> g;
+        std::array<Limbs, GH_N> h;
+        std::array<Limbs, ROUNDS_N * BRANCH_N> aff;
+    };
+
+    static constexpr Constants derive_constants(const Limbs &p)
+    {
+        // Same order as SageMath/ArionHash.sage: g_i pairs, h_i, then affine constants
+        ConstantStream<Field::num_limbs> s{p, "ArionV2", {RATE, CAPACITY, ROUNDS_N}};
+        Constants c{};
+
+        c.g = s.template irreducible_pairs<GH_N>();
+        c.h = s.template elements<GH_N>();
+        c.aff = s.template elements<ROUNDS_N * BRANCH_N>();
+
+        return c;
+    }
+
+    static inline const std::array<std::pair<Field, Field>, GH_N> alpha{
+        field_pairs_from_mont<Field>(hash_constants<ArionV2>().g)};
+    static inline const std::array<Field, GH_N> beta{
+        fields_from_mont<Field>(hash_constants<ArionV2>().h)};
     static inline const std::array<Field, ROUNDS_N * BRANCH_N> round_c{
-        random_array<Field, ROUNDS_N * BRANCH_N>()};
+        fields_from_mont<Field>(hash_constants<ArionV2>().aff)};
 
     static Sponge iota()
     {
@@ -44,28 +76,39 @@ public:
     static inline const Sponge circ_mat{iota()};
 
 
-    static void fifth(Field &x)
+    template<typename T>
+    static void fifth(T &x)
     {
-        Field t{x};
+        T t{x};
 
         x *= x;
         x *= x;
         x *= t;
     }
 
-    static void pow_e(Field &x)
+    template<typename T>
+    static void pow_e(T &x)
     {
-        static const auto eb{e.as_bigint()};
+        if constexpr (FieldModulus<Field>::known)
+        {
+            // Straight-line chain for x^(1/257), derived from the modulus at compile time
+            AdditionChain<InverseExponent<Field, 257>>::pow(x);
+        }
+        else
+        {
+            static const auto eb{e.as_bigint()};
 
-        x ^= eb;
+            x ^= eb;
+        }
     }
 
-    static void circular(Sponge &x)
+    template<typename T>
+    static void circular(std::array<T, BRANCH_N> &x)
     {
         if constexpr (BRANCH_N == 3)
         {
             // Explicit optimized steps for 3x3 circular matrix (it's 2.5x faster)
-            Sponge s;
+            std::array<T, BRANCH_N> s;
 
             s[0] = x[0];
             s[0] += x[1];
@@ -83,31 +126,42 @@ public:
         }
         else
         {
-            Field sigma{x[0]};
-            Field old{x[0]};
+            // circ_mat[i] = i + 1, so every product is a small multiple and each output is
+            // accumulated unreduced and reduced once
+            FieldSum<T> s{x[0]};
+            FieldSum<T> y{x[0]};
 
             for (size_t i = 1; i < BRANCH_N; ++i)
-                sigma += x[i];
+            {
+                s += x[i];
+                y.add_mul(i + 1, x[i]);
+            }
 
-            x[0] = sigma;
-            for (size_t i = 1; i < BRANCH_N; ++i)
-                x[0] += circ_mat[i - 1] * x[i];
+            T sigma{s.reduce()};
+            T old{x[0]};
 
+            x[0] = y.reduce();
             for (size_t i = 1; i < BRANCH_N; ++i)
             {
-                std::swap(x[i], old);
-                x[i] *= circ_mat[BRANCH_N - 1];
-                x[i] += x[i - 1];
-                x[i] -= sigma;
+                FieldSum<T> z{x[i - 1]};
+
+                z.add_mul(BRANCH_N, old);
+                z -= sigma;
+                old = x[i];
+                x[i] = z.reduce();
             }
         }
     }
 
-    static void gtds(Sponge &x)
+    template<typename T>
+    static void gtds(std::array<T, BRANCH_N> &x, size_t round)
     {
-        Sponge f;
-        Field t;
-        Field sigma;
+        const auto *a = &alpha[round * (BRANCH_N - 1)];
+        const auto *b = &beta[round * (BRANCH_N - 1)];
+        std::array<T, BRANCH_N> f;
+        FieldSum<T> s;
+        T t;
+        T sigma;
 
         // Base case, f(x) = x[n]^e = x[n]^(1/d)
         f[BRANCH_N - 1] = x[BRANCH_N - 1];
@@ -119,21 +173,21 @@ public:
             // f(x[i]) = x[i]^d
             f[i] = x[i];
             fifth(f[i]);
-            // sigma = sum_{j=i+1}^{BRANCH_N}{x[j] + f[j]}
-            sigma = x[i + 1] + f[i + 1];
-            for (size_t j = i + 2; j < BRANCH_N; ++j)
-                sigma += x[j] + f[j];
+            // sigma = sum_{j=i+1}^{BRANCH_N}{x[j] + f[j]}, kept unreduced across branches
+            s += x[i + 1];
+            s += f[i + 1];
+            sigma = s.reduce();
 
-            // t = g(x) = sigma^2 + alpha1*sigma + alpha2
+            // t = g_i(x) = sigma^2 + alpha_i1*sigma + alpha_i2
             t = sigma;
-            t += alpha.first;
+            t += a[i].first;
             t *= sigma;
-            t += alpha.second;
+            t += a[i].second;
             f[i] *= t;
 
-            // t = h(x) = sigma^2 + beta1*sigma
+            // t = h_i(x) = sigma^2 + beta_i*sigma
             t = sigma;
-            t += beta1;
+            t += b[i];
             t *= sigma;
             f[i] += t;
         }
@@ -141,55 +195,79 @@ public:
         x = f;
     }
 
-    static void hash_field(Sponge &h)
+    template<typename T>
+    static void hash_field(std::array<T, BRANCH_N> &h)
     {
         // Round 0, we assume key = 0, so no key addition is ever needed
         circular(h);
 
         for (size_t i = 0; i < ROUNDS_N; ++i)
         {
-            gtds(h);
+            gtds(h, i);
             circular(h);
             for (size_t j = 0; j < BRANCH_N; ++j)
                 h[j] += round_c[i * BRANCH_N + j];
         }
     }
 
+    template<size_t lanes>
+    static void hash_field_n(std::array<Sponge, lanes> &h)
+    {
+        // Transpose to structure-of-arrays and run all the permutations in lockstep
+        std::array<FieldLanes<Field, lanes>, BRANCH_N> s;
+
+        for (size_t i = 0; i < BRANCH_N; ++i)
+            for (size_t j = 0; j < lanes; ++j)
+                s[i][j] = h[j][i];
+
+        hash_field(s);
+
+        for (size_t i = 0; i < BRANCH_N; ++i)
+            for (size_t j = 0; j < lanes; ++j)
+                h[j][i] = s[i][j];
+    }
+
     static void hash_oneblock(uint8_t *digest, const void *message)
     {
         Sponge h{};
-        mpz_class tmp;
 
         for (size_t i = 0; i < RATE; ++i)
-        {
-            mpz_import(tmp.get_mpz_t(), DIGEST_SIZE, 1, 1, 0, 0,
-                       (const char *)message + DIGEST_SIZE * i);
-
-            h[i] = Field{tmp.get_mpz_t()};
-        }
+            h[i] = field_from_bytes<Field>((const char *)message + DIGEST_SIZE * i);
 
         hash_field(h);
-        h[0].as_bigint().to_mpz(tmp.get_mpz_t());
-
-        memset(digest, 0, DIGEST_SIZE);
-        mpz_export(digest, NULL, 1, 1, 0, 0, tmp.get_mpz_t());
+        field_to_bytes(digest, h[0]);
     }
 
-    static void hash_add(void *x, const void *y)
+    static void hash_oneblock_many(uint8_t *digests, const void *messages, size_t count)
     {
-        mpz_class tmp;
+        const char *msg = (const char *)messages;
+        size_t i = 0;
+
+        for (; i + LANES_N <= count; i += LANES_N)
+        {
+            std::array<Sponge, LANES_N> h{};
 
-        mpz_import(tmp.get_mpz_t(), DIGEST_SIZE, 1, 1, 0, 0, x);
-        Field xf{tmp.get_mpz_t()};
+            for (size_t j = 0; j < LANES_N; ++j)
+                for (size_t k = 0; k < RATE; ++k)
+                    h[j][k] = field_from_bytes<Field>(msg + BLOCK_SIZE * (i + j) + DIGEST_SIZE * k);
 
-        mpz_import(tmp.get_mpz_t(), DIGEST_SIZE, 1, 1, 0, 0, y);
-        Field yf{tmp.get_mpz_t()};
+            hash_field_n(h);
+
+            for (size_t j = 0; j < LANES_N; ++j)
+                field_to_bytes(digests + DIGEST_SIZE * (i + j), h[j][0]);
+        }
 
-        xf += yf;
+        // Remaining blocks do not fill a whole batch
+        for (; i < count; ++i)
+            hash_oneblock(digests + DIGEST_SIZE * i, msg + BLOCK_SIZE * i);
+    }
+
+    static void hash_add(void *x, const void *y)
+    {
+        Field xf{field_from_bytes<Field>(x)};
 
-        xf.as_bigint().to_mpz(tmp.get_mpz_t());
-        memset(x, 0, DIGEST_SIZE);
-        mpz_export(x, NULL, 1, 1, 0, 0, tmp.get_mpz_t());
+        xf += field_from_bytes<Field>(y);
+        field_to_bytes(x, xf);
     }
 
    ArionV2() = delete;
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Number of independent blocks a hash processes at once (1 if it has no batched kernel)
+template<typename Hash, typename = void>
+struct HashLanes : std::integral_constant<size_t, 1>
+{};
+
+template<typename Hash>
+struct HashLanes<Hash, std::void_t<decltype(Hash::LANES_N)>>
+    : std::integral_constant<size_t, Hash::LANES_N>
+{};
+
+template<typename Hash>
+static inline constexpr size_t hash_lanes_v = HashLanes<Hash>::value;
+
+// Hash count contiguous blocks into count contiguous digests, batching them when possible
+template<typename Hash>
+void hash_oneblock_many(uint8_t *digests, const void *messages, size_t count)
+{
+    if constexpr (hash_lanes_v<Hash> > 1)
+        Hash::hash_oneblock_many(digests, messages, count);
+    else
+        for (size_t i = 0; i < count; ++i)
+            Hash::hash_oneblock(digests + i * Hash::DIGEST_SIZE,
+                                (const uint8_t *)messages + i * Hash::BLOCK_SIZE);
+}
+
+// First bytes of the digest of a zero block, file headers store them to tell hashes with the same
+// sizes apart
+template<typename Hash>
+std::array<uint8_t, 8> hash_id()
+{
+    uint8_t zero[Hash::BLOCK_SIZE]{};
+    uint8_t digest[Hash::DIGEST_SIZE];
+    std::array<uint8_t, 8> id;
+
+    Hash::hash_oneblock(digest, zero);
+    memcpy(id.data(), digest, id.size());
+
+    return id;
+}
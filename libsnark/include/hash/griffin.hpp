@@ -1,6 +1,10 @@
 #pragma once
 
+#include "util/addition_chain.hpp"
 #include "util/algebra.hpp"
+#include "util/constants.hpp"
+#include "util/field_lanes.hpp"
+#include "util/lazy_field.hpp"
 
 template<typename FieldT = libff::Fq<libff::default_ec_pp>, size_t rate = 2, size_t capacity = 1, size_t rounds = 12>
 class Griffin
@@ -15,6 +19,8 @@ public:
     static constexpr size_t BLOCK_SIZE = DIGEST_SIZE * RATE;
     static constexpr size_t BRANCH_N = RATE + CAPACITY;
     static constexpr size_t CIRC_N = std::min(BRANCH_N, (size_t)8);
+    // Number of independent permutations interleaved by hash_oneblock_many
+    static constexpr size_t LANES_N = 4;
 
     using Sponge = std::array<Field, BRANCH_N>;
     using CircMat = std::array<Field, CIRC_N>;
@@ -24,96 +30,97 @@ public:
         Init() { libff::default_ec_pp::init_public_params(); }
     } init;
 
-    static inline CircMat circular_matrix()
+    // Entries of the circulant matrix, small integers also used unreduced by circular()
+    static constexpr std::array<uint64_t, CIRC_N> circular_entries()
     {
         if constexpr (BRANCH_N == 3)
-            return CircMat{2, 1, 1};
+            return {2, 1, 1};
         else if constexpr (BRANCH_N == 4)
-            return CircMat{3, 2, 1, 1};
+            return {3, 2, 1, 1};
         else
         {
             static_assert(BRANCH_N % 4 == 0, "Invalid branch size");
 
-            return CircMat{6, 4, 2, 2, 3, 2, 1, 1};
+            return {6, 4, 2, 2, 3, 2, 1, 1};
         }
     }
 
+    static constexpr std::array<uint64_t, CIRC_N> CIRC_C{circular_entries()};
+
+    static inline CircMat circular_matrix()
+    {
+        CircMat m;
+
+        for (size_t i = 0; i < CIRC_N; ++i)
+            m[i] = Field(CIRC_C[i]);
+
+        return m;
+    }
+
     static inline const Field d{5};
     static inline const Field e{inverse(d, Field{-1})};
-    static inline const std::pair<Field, Field> alpha{get_irreducible_pair<Field>(~0ULL)};
-    static inline const Field gamma{Field::random_element()};
+
+    using Limbs = typename ConstantStream<Field::num_limbs>::Limbs;
+
+    struct Constants
+    {
+        std::array<Limbs, 2> alpha;
+        Limbs gamma;
+        std::array<Limbs, ROUNDS_N * BRANCH_N> round_c;
+    };
+
+    static constexpr Constants derive_constants(const Limbs &p)
+    {
+        ConstantStream<Field::num_limbs> s{p, "Griffin", {RATE, CAPACITY, ROUNDS_N}};
+        Constants c{};
+
+        c.alpha = s.irreducible_pair();
+        c.gamma = s.element();
+        c.round_c = s.template elements<ROUNDS_N * BRANCH_N>();
+
+        return c;
+    }
+
+    static inline const std::pair<Field, Field> alpha{
+        field_from_mont<Field>(hash_constants<Griffin>().alpha[0]),
+        field_from_mont<Field>(hash_constants<Griffin>().alpha[1])};
+    static inline const Field gamma{field_from_mont<Field>(hash_constants<Griffin>().gamma)};
     static inline const std::array<Field, ROUNDS_N * BRANCH_N> round_c{
-        random_array<Field, ROUNDS_N * BRANCH_N>()};
+        fields_from_mont<Field>(hash_constants<Griffin>().round_c)};
     static inline const CircMat circ_mat{circular_matrix()};
 
-    static void fifth(Field &x)
+    template<typename T>
+    static void fifth(T &x)
     {
-        Field t{x};
+        T t{x};
 
         x *= x;
         x *= x;
         x *= t;
     }
 
-#ifdef CURVE_ALT_BN128
-    static void fifth_inv(Field &x)
+    template<typename T>
+    static void fifth_inv(T &x)
     {
-        // Explicit steps for 1/5 exponentiation in BN128, it is 1.4x faster than x ^= e
-        Field t{x};
-
-        t *= t, t *= t, x *= t, t *= t, x *= t, t *= t, t *= t, t *= t, x *= t, t *= t;
-        x *= t, t *= t, t *= t, t *= t, x *= t, t *= t, x *= t, t *= t, t *= t, t *= t;
-        x *= t, t *= t, x *= t, t *= t, t *= t, t *= t, x *= t, t *= t, x *= t, t *= t;
-        t *= t, t *= t, x *= t, t *= t, x *= t, t *= t, t *= t, t *= t, x *= t, t *= t;
-        x *= t, t *= t, t *= t, t *= t, t *= t, x *= t, t *= t, x *= t, t *= t, t *= t;
-        t *= t, x *= t, t *= t, t *= t, x *= t, t *= t, t *= t, x *= t, t *= t, x *= t;
-        t *= t, x *= t, t *= t, x *= t, t *= t, t *= t, x *= t, t *= t, x *= t, t *= t;
-        x *= t, t *= t, x *= t, t *= t, x *= t, t *= t, x *= t, t *= t, x *= t, t *= t;
-        t *= t, t *= t, x *= t, t *= t, x *= t, t *= t, x *= t, t *= t, x *= t, t *= t;
-        x *= t, t *= t, x *= t, t *= t, x *= t, t *= t, t *= t, t *= t, x *= t, t *= t;
-        x *= t, t *= t, x *= t, t *= t, t *= t, x *= t, t *= t, x *= t, t *= t, t *= t;
-        t *= t, t *= t, t *= t, t *= t, x *= t, t *= t, t *= t, x *= t, t *= t, x *= t;
-        t *= t, t *= t, x *= t, t *= t, t *= t, t *= t, t *= t, x *= t, t *= t, t *= t;
-        x *= t, t *= t, t *= t, t *= t, x *= t, t *= t, t *= t, t *= t, x *= t, t *= t;
-        t *= t, x *= t, t *= t, t *= t, t *= t, x *= t, t *= t, x *= t, t *= t, x *= t;
-        t *= t, t *= t, t *= t, x *= t, t *= t, t *= t, x *= t, t *= t, x *= t, t *= t;
-        x *= t, t *= t, t *= t, t *= t, x *= t, t *= t, x *= t, t *= t, x *= t, t *= t;
-        t *= t, x *= t, t *= t, t *= t, t *= t, x *= t, t *= t, x *= t, t *= t, x *= t;
-        t *= t, t *= t, x *= t, t *= t, t *= t, x *= t, t *= t, x *= t, t *= t, t *= t;
-        t *= t, x *= t, t *= t, t *= t, x *= t, t *= t, t *= t, x *= t, t *= t, x *= t;
-        t *= t, x *= t, t *= t, t *= t, x *= t, t *= t, t *= t, t *= t, t *= t, x *= t;
-        t *= t, t *= t, x *= t, t *= t, x *= t, t *= t, t *= t, x *= t, t *= t, t *= t;
-        x *= t, t *= t, t *= t, x *= t, t *= t, t *= t, x *= t, t *= t, x *= t, t *= t;
-        t *= t, t *= t, x *= t, t *= t, x *= t, t *= t, x *= t, t *= t, x *= t, t *= t;
-        t *= t, t *= t, x *= t, t *= t, x *= t, t *= t, t *= t, t *= t, t *= t, t *= t;
-        x *= t, t *= t, x *= t, t *= t, x *= t, t *= t, x *= t, t *= t, x *= t, t *= t;
-        t *= t, x *= t, t *= t, t *= t, x *= t, t *= t, t *= t, x *= t, t *= t, x *= t;
-        t *= t, t *= t, x *= t, t *= t, x *= t, t *= t, t *= t, t *= t, x *= t, t *= t;
-        x *= t, t *= t, x *= t, t *= t, t *= t, x *= t, t *= t, x *= t, t *= t, t *= t;
-        t *= t, x *= t, t *= t, t *= t, t *= t, x *= t, t *= t, t *= t, t *= t, x *= t;
-        t *= t, t *= t, x *= t, t *= t, t *= t, x *= t, t *= t, t *= t, x *= t, t *= t;
-        x *= t, t *= t, t *= t, t *= t, x *= t, t *= t, x *= t, t *= t, t *= t, x *= t;
-        t *= t, x *= t, t *= t, x *= t, t *= t, x *= t, t *= t, t *= t, t *= t, x *= t;
-        t *= t, t *= t, t *= t, t *= t, t *= t, x *= t, t *= t, t *= t, x *= t, t *= t;
-        x *= t, t *= t, t *= t, x *= t, t *= t, t *= t, t *= t, t *= t, x *= t, t *= t;
-        t *= t, x *= t, t *= t, t *= t, t *= t, x *= t, t *= t, t *= t, x *= t, t *= t;
-        t *= t, t *= t, x *= t, t *= t, t *= t, x *= t, t *= t, t *= t, x *= t, t *= t;
-        x *= t, t *= t, t *= t, x *= t, t *= t, x *= t, t *= t, t *= t, x *= t, t *= t;
-        t *= t, x *= t, t *= t, x *= t, t *= t, t *= t, t *= t, x *= t;
-    }
-#else
-    static void fifth_inv(Field &x)
-    {
-        static const auto eb = e.as_bigint();
-        x ^= eb;
+        if constexpr (FieldModulus<Field>::known)
+        {
+            // Straight-line chain for x^(1/5), derived from the modulus at compile time
+            AdditionChain<InverseExponent<Field, 5>>::pow(x);
+        }
+        else
+        {
+            static const auto eb{e.as_bigint()};
+
+            x ^= eb;
+        }
     }
-#endif
 
-    static void circular(Sponge &x)
+    template<typename T>
+    static void circular(std::array<T, BRANCH_N> &x)
     {
         if constexpr (BRANCH_N == 3)
         {
-            Field old{x[0]};
+            T old{x[0]};
 
             x[0] += x[1];
             x[0] += x[2];
@@ -123,7 +130,7 @@ public:
         }
         else if constexpr (BRANCH_N == 4)
         {
-            Field old[2]{x[0], x[1]};
+            T old[2]{x[0], x[1]};
 
             x[0] += x[1];
             x[0] += x[2];
@@ -148,19 +155,22 @@ public:
         {
             static constexpr size_t BRANCH_N4 = BRANCH_N / 4;
 
-            Sponge sum{};
+            // the products by the entries of circ_mat are accumulated unreduced
+            std::array<FieldSum<T>, BRANCH_N> sum{};
 
             for (size_t i = 0; i < BRANCH_N4; ++i)
                 for (size_t j = 0; j < BRANCH_N4; ++j)
                     for (size_t k = 0, off = 4 * (i != j); k < 4; ++k)
                         for (size_t l = 0; l < 4; ++l)
-                            sum[4 * i + k] += circ_mat[off + l] * x[4 * j + l];
+                            sum[4 * i + k].add_mul(CIRC_C[off + l], x[4 * j + l]);
 
-            x = sum;
+            for (size_t i = 0; i < BRANCH_N; ++i)
+                x[i] = sum[i].reduce();
         }
     }
 
-    static void sbox(Sponge &x)
+    template<typename T>
+    static void sbox(std::array<T, BRANCH_N> &x)
     {
         // Base case, y[0] = x[0]^e = x[0]^(1/d)
         fifth_inv(x[0]);
@@ -171,8 +181,8 @@ public:
         // Recursive case y[i] = x[i] * (L(y0,y1,old)^2 + a1*L(y0,y1,old) + a2)
         // <==> y[i] = x[i] * (L(y0,y1,old) * (L(y0,y1,old) + a1) + a2)
         // L(y1, y2, old) = gamma*y1 + y2 + old
-        Field l;
-        Field old{}; // old = 0 at the beginning
+        T l;
+        T old{}; // old = 0 at the beginning
 
         for (size_t i = 2; i < BRANCH_N; ++i)
         {
@@ -189,7 +199,8 @@ public:
         }
     }
 
-    static void hash_field(Sponge &h)
+    template<typename T>
+    static void hash_field(std::array<T, BRANCH_N> &h)
     {
         // Round 0, we assume key = 0, so no key addition is ever needed
         circular(h);
@@ -202,45 +213,71 @@ public:
         }
     }
 
+    template<size_t lanes>
+    static void hash_field_n(std::array<Sponge, lanes> &h)
+    {
+        // Transpose to structure-of-arrays and run all the permutations in lockstep
+        std::array<FieldLanes<Field, lanes>, BRANCH_N> s;
+
+        for (size_t i = 0; i < BRANCH_N; ++i)
+            for (size_t j = 0; j < lanes; ++j)
+                s[i][j] = h[j][i];
+
+        hash_field(s);
+
+        for (size_t i = 0; i < BRANCH_N; ++i)
+            for (size_t j = 0; j < lanes; ++j)
+                h[j][i] = s[i][j];
+    }
+
     static void hash_oneblock(uint8_t *digest, const void *message)
     {
         Sponge h{};
-        mpz_class tmp;
 
         for (size_t i = 0; i < RATE; ++i)
-        {
-            mpz_import(tmp.get_mpz_t(), DIGEST_SIZE, 1, 1, 0, 0,
-                       (const char *)message + DIGEST_SIZE * i);
-
-            h[i] = Field{tmp.get_mpz_t()};
-        }
+            h[i] = field_from_bytes<Field>((const char *)message + DIGEST_SIZE * i);
 
         hash_field(h);
-        h[0].as_bigint().to_mpz(tmp.get_mpz_t());
-
-        memset(digest, 0, DIGEST_SIZE);
-        mpz_export(digest, NULL, 1, 1, 0, 0, tmp.get_mpz_t());
+        field_to_bytes(digest, h[0]);
     }
 
-    static void hash_add(void *x, const void *y)
+    static void hash_oneblock_many(uint8_t *digests, const void *messages, size_t count)
     {
-        mpz_class tmp;
+        const char *msg = (const char *)messages;
+        size_t i = 0;
+
+        for (; i + LANES_N <= count; i += LANES_N)
+        {
+            std::array<Sponge, LANES_N> h{};
 
-        mpz_import(tmp.get_mpz_t(), DIGEST_SIZE, 1, 1, 0, 0, x);
-        Field xf{tmp.get_mpz_t()};
+            for (size_t j = 0; j < LANES_N; ++j)
+                for (size_t k = 0; k < RATE; ++k)
+                    h[j][k] = field_from_bytes<Field>(msg + BLOCK_SIZE * (i + j) + DIGEST_SIZE * k);
 
-        mpz_import(tmp.get_mpz_t(), DIGEST_SIZE, 1, 1, 0, 0, y);
-        Field yf{tmp.get_mpz_t()};
+            hash_field_n(h);
 
-        xf += yf;
+            for (size_t j = 0; j < LANES_N; ++j)
+                field_to_bytes(digests + DIGEST_SIZE * (i + j), h[j][0]);
+        }
 
-        xf.as_bigint().to_mpz(tmp.get_mpz_t());
-        memset(x, 0, DIGEST_SIZE);
-        mpz_export(x, NULL, 1, 1, 0, 0, tmp.get_mpz_t());
+        // Remaining blocks do not fill a whole batch
+        for (; i < count; ++i)
+            hash_oneblock(digests + DIGEST_SIZE * i, msg + BLOCK_SIZE * i);
+    }
+
+    static void hash_add(void *x, const void *y)
+    {
+        Field xf{field_from_bytes<Field>(x)};
+
+        xf += field_from_bytes<Field>(y);
+        field_to_bytes(x, xf);
     }
 
     Griffin() = delete;
 };
 
 // Valid realizations of a template class must be initialized before main()!
+// x^5 is not invertible on the base fields of MNT4 and EDWARDS, Griffin<> does not exist there
+#if !defined(CURVE_MNT4) && !defined(CURVE_EDWARDS)
 template class Griffin<>;
+#endif
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "util/algebra.hpp"
+#include "util/constants.hpp"
 
 template<typename FieldT>
 class Mimc256
@@ -178,8 +179,17 @@ public:
         {(0x14123B3718243DBB298BD66F5531F2402999855214C0D6DB90E057E532AB4232_mpz).get_mpz_t()},
     };
 #else
+    using Limbs = typename ConstantStream<FieldT::num_limbs>::Limbs;
+
+    static constexpr std::array<Limbs, ROUNDS_N - 1> derive_constants(const Limbs &p)
+    {
+        ConstantStream<FieldT::num_limbs> s{p, "Mimc256", {ROUNDS_N}};
+
+        return s.template elements<ROUNDS_N - 1>();
+    }
+
     static inline const std::array<FieldT, ROUNDS_N - 1> round_c{
-        random_array<FieldT, ROUNDS_N - 1>()};
+        fields_from_mont<FieldT>(hash_constants<Mimc256, FieldT>())};
 #endif
 
     static void cube(FieldT &x)
@@ -220,36 +230,19 @@ public:
 
     static void hash_oneblock(uint8_t *digest, const void *message)
     {
-        mpz_class tmp;
-
-        mpz_import(tmp.get_mpz_t(), DIGEST_SIZE, 1, 1, 0, 0, message);
-        FieldT x{tmp.get_mpz_t()};
-
-        mpz_import(tmp.get_mpz_t(), DIGEST_SIZE, 1, 1, 0, 0, (const char *)message + DIGEST_SIZE);
-        FieldT y{tmp.get_mpz_t()};
+        FieldT x{field_from_bytes<FieldT>(message, DIGEST_SIZE)};
+        FieldT y{field_from_bytes<FieldT>((const char *)message + DIGEST_SIZE, DIGEST_SIZE)};
 
         x = hash_field(x, y);
-        x.as_bigint().to_mpz(tmp.get_mpz_t());
-
-        memset(digest, 0, DIGEST_SIZE);
-        mpz_export(digest, NULL, 1, 1, 0, 0, tmp.get_mpz_t());
+        field_to_bytes(digest, x, DIGEST_SIZE);
     }
 
     static void hash_add(void *x, const void *y)
     {
-        mpz_class tmp;
-
-        mpz_import(tmp.get_mpz_t(), DIGEST_SIZE, 1, 1, 0, 0, x);
-        FieldT xf{tmp.get_mpz_t()};
-
-        mpz_import(tmp.get_mpz_t(), DIGEST_SIZE, 1, 1, 0, 0, y);
-        FieldT yf{tmp.get_mpz_t()};
-
-        xf += yf;
+        FieldT xf{field_from_bytes<FieldT>(x, DIGEST_SIZE)};
 
-        xf.as_bigint().to_mpz(tmp.get_mpz_t());
-        memset(x, 0, DIGEST_SIZE);
-        mpz_export(x, NULL, 1, 1, 0, 0, tmp.get_mpz_t());
+        xf += field_from_bytes<FieldT>(y, DIGEST_SIZE);
+        field_to_bytes(x, xf, DIGEST_SIZE);
     }
 
     Mimc256() = delete;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "util/algebra.hpp"
+#include "util/constants.hpp"
 
 template<typename FieldT>
 class Mimc512F
@@ -341,8 +342,17 @@ public:
         {(0x9A36CF734F811E77733B3A1D5603C7D0ABD15EDAD99CF27227863D79DF0A9C87_mpz).get_mpz_t()},
     };
 #else
+    using Limbs = typename ConstantStream<FieldT::num_limbs>::Limbs;
+
+    static constexpr std::array<Limbs, ROUNDS_N - 1> derive_constants(const Limbs &p)
+    {
+        ConstantStream<FieldT::num_limbs> s{p, "Mimc512F", {ROUNDS_N}};
+
+        return s.template elements<ROUNDS_N - 1>();
+    }
+
     static inline const std::array<FieldT, ROUNDS_N - 1> round_c{
-        random_array<FieldT, ROUNDS_N - 1>()};
+        fields_from_mont<FieldT>(hash_constants<Mimc512F, FieldT>())};
 #endif
     static void cube(FieldT &x)
     {
@@ -402,43 +412,25 @@ public:
 
     static void hash_oneblock(uint8_t *digest, const void *message)
     {
-        mpz_class tmp;
         std::array<FieldT, 4> x;
 
         for (size_t i = 0; i < 4; ++i)
-        {
-            mpz_import(tmp.get_mpz_t(), FIELD_SIZE, 1, 1, 0, 0, (char *)message + FIELD_SIZE * i);
-            x[i] = FieldT{tmp.get_mpz_t()};
-        }
+            x[i] = field_from_bytes<FieldT>((const char *)message + FIELD_SIZE * i, FIELD_SIZE);
 
         FieldTP h = hash_field(x);
 
-        // mpz_export does not guarantee to fill all the bytes
-        memset(digest, 0, DIGEST_SIZE);
-
-        h.first.as_bigint().to_mpz(tmp.get_mpz_t());
-        mpz_export(digest, NULL, 1, 1, 0, 0, tmp.get_mpz_t());
-
-        h.second.as_bigint().to_mpz(tmp.get_mpz_t());
-        mpz_export(digest + FIELD_SIZE, NULL, 1, 1, 0, 0, tmp.get_mpz_t());
+        field_to_bytes(digest, h.first, FIELD_SIZE);
+        field_to_bytes(digest + FIELD_SIZE, h.second, FIELD_SIZE);
     }
 
     static void hash_add(void *x, const void *y)
     {
-        mpz_class tmp;
-
         for (size_t i = 0; i < 2; ++i)
         {
-            mpz_import(tmp.get_mpz_t(), FIELD_SIZE, 1, 1, 0, 0, (char *)x + FIELD_SIZE * i);
-            FieldT t1{tmp.get_mpz_t()};
-            mpz_import(tmp.get_mpz_t(), FIELD_SIZE, 1, 1, 0, 0, (char *)y + FIELD_SIZE * i);
-            FieldT t2{tmp.get_mpz_t()};
-
-            t1 += t2;
+            FieldT t{field_from_bytes<FieldT>((const char *)x + FIELD_SIZE * i, FIELD_SIZE)};
 
-            memset((char *)x + FIELD_SIZE * i, 0, FIELD_SIZE);
-            t1.as_bigint().to_mpz(tmp.get_mpz_t());
-            mpz_export((char *)x + FIELD_SIZE * i, NULL, 1, 1, 0, 0, tmp.get_mpz_t());
+            t += field_from_bytes<FieldT>((const char *)y + FIELD_SIZE * i, FIELD_SIZE);
+            field_to_bytes((char *)x + FIELD_SIZE * i, t, FIELD_SIZE);
         }
     }
 
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "util/algebra.hpp"
+#include "util/constants.hpp"
+#include "util/field_lanes.hpp"
+#include "util/lazy_field.hpp"
 
 template<typename FieldT = libff::Fq<libff::default_ec_pp>, size_t rate = 2, size_t capacity = 1,
          size_t rounds_f = 4, size_t rounds_p = 57>
@@ -19,6 +22,8 @@ public:
     static constexpr size_t ROUNDS_F_N = 2 * ROUNDS_f_N;
     static constexpr size_t ROUNDS_N = ROUNDS_F_N + ROUNDS_P_N;
     static constexpr size_t CONST_N = BRANCH_N * ROUNDS_N;
+    // Number of independent permutations interleaved by hash_oneblock_many
+    static constexpr size_t LANES_N = 4;
 
     using Sponge = std::array<Field, BRANCH_N>;
 
@@ -28,112 +33,341 @@ public:
         Init() { libff::default_ec_pp::init_public_params(); }
     } init;
 
-    // Not an actual MDS, only use for benchmarks!
-    static inline std::array<Field, BRANCH_N * BRANCH_N> mds_matrix()
+    using Limbs = typename ConstantStream<Field::num_limbs>::Limbs;
+
+    struct Constants
+    {
+        std::array<Limbs, CONST_N> round_c;
+    };
+
+    static constexpr Constants derive_constants(const Limbs &p)
+    {
+        ConstantStream<Field::num_limbs> s{p, "Poseidon5",
+                                           {RATE, CAPACITY, ROUNDS_F_N, ROUNDS_P_N}};
+        Constants c{};
+
+        c.round_c = s.template elements<CONST_N>();
+
+        return c;
+    }
+
+    using Matrix = std::array<Field, BRANCH_N * BRANCH_N>;
+
+    static Matrix cauchy()
     {
-        return random_array<Field, BRANCH_N * BRANCH_N>();
+        /*
+        M[i][j] = 1 / (x_i + y_j) with x_i = i and y_j = BRANCH_N + j. A Cauchy matrix is MDS when
+        the x_i are distinct, the y_j are distinct and no x_i + y_j is 0: here the sums lie in
+        [BRANCH_N, 3 * BRANCH_N - 2], far below the modulus.
+        */
+        Matrix m;
+
+        // Needs the modulus, and static members of a template have no initialization order
+        libff::default_ec_pp::init_public_params();
+
+        for (size_t i = 0; i < BRANCH_N; ++i)
+            for (size_t j = 0; j < BRANCH_N; ++j)
+                m[i * BRANCH_N + j] = Field(i + j + BRANCH_N).inverse();
+
+        return m;
+    }
+
+    static inline const std::array<Field, CONST_N> round_c{
+        fields_from_mont<Field>(hash_constants<Poseidon5>().round_c)};
+    static inline const Matrix mds_mat{cauchy()};
+
+    /*
+    Equivalent form of the partial rounds, see Appendix B of the Poseidon paper.
+    Round constants of the branches without an S-box go through the linear layer and are carried
+    into the next round, so each partial round adds a single constant to the first branch.
+    The matrix of each partial round is split as M_k = S_k * D_k, where D_k = diag(1, H_k), H_k is
+    M_k without its first row and column. D_k leaves the first branch alone, so it is moved into
+    the round before. S_k is sparse, only its first row and first column are stored:
+    [m00, row * H_k^-1, column].
+    */
+    static constexpr size_t SPARSE_N = 2 * BRANCH_N - 1;
+
+    struct Optimized
+    {
+        std::array<Field, ROUNDS_F_N * BRANCH_N> full_c;
+        std::array<Field, ROUNDS_P_N> partial_c;
+        // Matrix of the last full round before the partial rounds, D_1 * M
+        Matrix pre_mat;
+        std::array<Field, ROUNDS_P_N * SPARSE_N> sparse_mat;
+    };
+
+    static_assert(ROUNDS_f_N > 0, "D_1 is folded into a full round");
+
+    template<size_t m>
+    static std::array<Field, m * m> invert(std::array<Field, m * m> a)
+    {
+        // Gauss-Jordan, submatrices of an MDS matrix are never singular
+        std::array<Field, m * m> r;
+
+        for (size_t i = 0; i < m; ++i)
+            for (size_t j = 0; j < m; ++j)
+                r[i * m + j] = i == j ? Field::one() : Field::zero();
+
+        for (size_t i = 0; i < m; ++i)
+        {
+            size_t p = i;
+
+            while (a[p * m + i].is_zero())
+                ++p;
+
+            for (size_t j = 0; j < m; ++j)
+            {
+                std::swap(a[i * m + j], a[p * m + j]);
+                std::swap(r[i * m + j], r[p * m + j]);
+            }
+
+            Field pinv{a[i * m + i].inverse()};
+
+            for (size_t j = 0; j < m; ++j)
+            {
+                a[i * m + j] *= pinv;
+                r[i * m + j] *= pinv;
+            }
+
+            for (size_t k = 0; k < m; ++k)
+            {
+                if (k == i || a[k * m + i].is_zero())
+                    continue;
+
+                Field f{a[k * m + i]};
+
+                for (size_t j = 0; j < m; ++j)
+                {
+                    a[k * m + j] -= f * a[i * m + j];
+                    r[k * m + j] -= f * r[i * m + j];
+                }
+            }
+        }
+
+        return r;
+    }
+
+    static Optimized optimize()
+    {
+        static constexpr size_t t = BRANCH_N;
+        static constexpr size_t m = BRANCH_N - 1;
+        static constexpr size_t HALF_N = ROUNDS_f_N * BRANCH_N;
+
+        // Derived again, the round_c and mds_mat members may not be initialized yet
+        const auto rc{fields_from_mont<Field>(hash_constants<Poseidon5>().round_c)};
+        const Matrix mds{cauchy()};
+
+        Optimized o;
+        Sponge carry{};
+
+        // Constants, carried forward through the partial rounds
+        for (size_t i = 0; i < HALF_N; ++i)
+            o.full_c[i] = rc[i];
+
+        for (size_t k = 0; k < ROUNDS_P_N; ++k)
+        {
+            Sponge c;
+
+            for (size_t j = 0; j < t; ++j)
+                carry[j] += rc[HALF_N + k * t + j];
+
+            o.partial_c[k] = carry[0];
+            carry[0] = Field::zero();
+
+            for (size_t i = 0; i < t; ++i)
+            {
+                c[i] = Field::zero();
+                for (size_t j = 1; j < t; ++j)
+                    c[i] += mds[i * t + j] * carry[j];
+            }
+            carry = c;
+        }
+
+        for (size_t i = 0; i < HALF_N; ++i)
+            o.full_c[HALF_N + i] = rc[HALF_N + ROUNDS_P_N * t + i];
+        for (size_t i = 0; i < t; ++i)
+            o.full_c[HALF_N + i] += carry[i];
+
+        // Matrices, factored from the last partial round backwards
+        Matrix a{mds};
+
+        for (size_t k = ROUNDS_P_N; k-- > 0;)
+        {
+            std::array<Field, m * m> hat;
+            Field *s = &o.sparse_mat[k * SPARSE_N];
+
+            for (size_t i = 0; i < m; ++i)
+                for (size_t j = 0; j < m; ++j)
+                    hat[i * m + j] = a[(i + 1) * t + j + 1];
+
+            std::array<Field, m * m> hat_inv{invert<m>(hat)};
+
+            s[0] = a[0];
+            for (size_t j = 0; j < m; ++j)
+            {
+                s[1 + j] = Field::zero();
+                for (size_t l = 0; l < m; ++l)
+                    s[1 + j] += a[1 + l] * hat_inv[l * m + j];
+                s[t + j] = a[(j + 1) * t];
+            }
+
+            // The previous round is followed by D_k * M
+            for (size_t j = 0; j < t; ++j)
+                a[j] = mds[j];
+            for (size_t i = 0; i < m; ++i)
+                for (size_t j = 0; j < t; ++j)
+                {
+                    a[(i + 1) * t + j] = Field::zero();
+                    for (size_t l = 0; l < m; ++l)
+                        a[(i + 1) * t + j] += hat[i * m + l] * mds[(l + 1) * t + j];
+                }
+        }
+        o.pre_mat = a;
+
+        return o;
     }
 
-    static inline const std::array<Field, CONST_N> round_c{random_array<Field, CONST_N>()};
-    static inline const std::array<Field, BRANCH_N * BRANCH_N> mds_mat{mds_matrix()};
+    static inline const Optimized opt{optimize()};
 
-    static void fifth(Field &x)
+    template<typename T>
+    static void fifth(T &x)
     {
-        Field t{x};
+        T t{x};
 
         x *= x;
         x *= x;
         x *= t;
     }
 
-    static void matmul(Sponge &arr)
+    template<typename T>
+    static void matmul(std::array<T, BRANCH_N> &arr, const Matrix &mat)
     {
-        Sponge sum;
+        std::array<T, BRANCH_N> sum;
 
+        // Each row is a double-width dot product with a single Montgomery reduction
         for (size_t i = 0; i < BRANCH_N; ++i)
         {
-            sum[i] = mds_mat[i * BRANCH_N] * arr[0];
-            for (size_t j = 1; j < BRANCH_N; ++j)
-                sum[i] += mds_mat[i * BRANCH_N + j] * arr[j];
+            FieldDot<T> dot;
+
+            for (size_t j = 0; j < BRANCH_N; ++j)
+                dot.add_mul(mat[i * BRANCH_N + j], arr[j]);
+            sum[i] = dot.reduce();
         }
 
         arr = sum;
     }
 
+    template<typename T>
+    static void sparse_matmul(std::array<T, BRANCH_N> &arr, const Field *s)
+    {
+        FieldDot<T> dot;
+
+        // Dense first row, the rest is the identity plus the first column
+        for (size_t j = 0; j < BRANCH_N; ++j)
+            dot.add_mul(s[j], arr[j]);
 
-    static Field hash_field(Sponge &h)
+        for (size_t j = 1; j < BRANCH_N; ++j)
+            arr[j] += s[BRANCH_N + j - 1] * arr[0];
+
+        arr[0] = dot.reduce();
+    }
+
+
+    template<typename T>
+    static T hash_field(std::array<T, BRANCH_N> &h)
     {
         size_t c = 0;
 
         for (size_t i = 0; i < ROUNDS_f_N; ++i)
         {
             for (size_t j = 0; j < BRANCH_N; ++j)
-                h[j] += round_c[c++];
+                h[j] += opt.full_c[c++];
 
             for (size_t j = 0; j < BRANCH_N; ++j)
                 fifth(h[j]);
 
-            matmul(h);
+            matmul(h, i + 1 < ROUNDS_f_N ? mds_mat : opt.pre_mat);
         }
 
         for (size_t i = 0; i < ROUNDS_P_N; ++i)
         {
-            for (size_t j = 0; j < BRANCH_N; ++j)
-                h[j] += round_c[c++];
-
+            h[0] += opt.partial_c[i];
             fifth(h[0]);
-            matmul(h);
+            sparse_matmul(h, &opt.sparse_mat[i * SPARSE_N]);
         }
 
         for (size_t i = 0; i < ROUNDS_f_N; ++i)
         {
             for (size_t j = 0; j < BRANCH_N; ++j)
-                h[j] += round_c[c++];
+                h[j] += opt.full_c[c++];
 
             for (size_t j = 0; j < BRANCH_N; ++j)
                 fifth(h[j]);
 
-            matmul(h);
+            matmul(h, mds_mat);
         }
 
         return h[0];
     }
 
+    template<size_t lanes>
+    static void hash_field_n(std::array<Sponge, lanes> &h)
+    {
+        // Transpose to structure-of-arrays and run all the permutations in lockstep
+        std::array<FieldLanes<Field, lanes>, BRANCH_N> s;
+
+        for (size_t i = 0; i < BRANCH_N; ++i)
+            for (size_t j = 0; j < lanes; ++j)
+                s[i][j] = h[j][i];
+
+        hash_field(s);
+
+        for (size_t i = 0; i < BRANCH_N; ++i)
+            for (size_t j = 0; j < lanes; ++j)
+                h[j][i] = s[i][j];
+    }
+
     static void hash_oneblock(uint8_t *digest, const void *message)
     {
         Sponge h{};
-        mpz_class tmp;
 
         for (size_t i = 0; i < RATE; ++i)
-        {
-            mpz_import(tmp.get_mpz_t(), DIGEST_SIZE, 1, 1, 0, 0,
-                       (const char *)message + DIGEST_SIZE * i);
-
-            h[i] = Field{tmp.get_mpz_t()};
-        }
+            h[i] = field_from_bytes<Field>((const char *)message + DIGEST_SIZE * i);
 
         hash_field(h);
-        h[0].as_bigint().to_mpz(tmp.get_mpz_t());
-
-        memset(digest, 0, DIGEST_SIZE);
-        mpz_export(digest, NULL, 1, 1, 0, 0, tmp.get_mpz_t());
+        field_to_bytes(digest, h[0]);
     }
 
-    static void hash_add(void *x, const void *y)
+    static void hash_oneblock_many(uint8_t *digests, const void *messages, size_t count)
     {
-        mpz_class tmp;
+        const char *msg = (const char *)messages;
+        size_t i = 0;
+
+        for (; i + LANES_N <= count; i += LANES_N)
+        {
+            std::array<Sponge, LANES_N> h{};
 
-        mpz_import(tmp.get_mpz_t(), DIGEST_SIZE, 1, 1, 0, 0, x);
-        Field xf{tmp.get_mpz_t()};
+            for (size_t j = 0; j < LANES_N; ++j)
+                for (size_t k = 0; k < RATE; ++k)
+                    h[j][k] = field_from_bytes<Field>(msg + BLOCK_SIZE * (i + j) + DIGEST_SIZE * k);
 
-        mpz_import(tmp.get_mpz_t(), DIGEST_SIZE, 1, 1, 0, 0, y);
-        Field yf{tmp.get_mpz_t()};
+            hash_field_n(h);
+
+            for (size_t j = 0; j < LANES_N; ++j)
+                field_to_bytes(digests + DIGEST_SIZE * (i + j), h[j][0]);
+        }
 
-        xf += yf;
+        // Remaining blocks do not fill a whole batch
+        for (; i < count; ++i)
+            hash_oneblock(digests + DIGEST_SIZE * i, msg + BLOCK_SIZE * i);
+    }
+
+    static void hash_add(void *x, const void *y)
+    {
+        Field xf{field_from_bytes<Field>(x)};
 
-        xf.as_bigint().to_mpz(tmp.get_mpz_t());
-        memset(x, 0, DIGEST_SIZE);
-        mpz_export(x, NULL, 1, 1, 0, 0, tmp.get_mpz_t());
+        xf += field_from_bytes<Field>(y);
+        field_to_bytes(x, xf);
     }
 
     Poseidon5() = delete;
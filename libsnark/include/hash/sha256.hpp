@@ -1,5 +1,8 @@
 #pragma once
 
+#include "util/cpu_features.hpp"
+#include "util/simd_lanes.hpp"
+
 #ifdef _WIN32
     #include <intrin.h>
 #else
@@ -12,28 +15,38 @@ class Sha256
 public:
     static constexpr size_t BLOCK_SIZE = 64;
     static constexpr size_t DIGEST_SIZE = 32;
+    // Most blocks hash_oneblock_many processes at once, the widest multi-buffer kernel
+    static constexpr size_t LANES_N = 16;
 
     Sha256() = delete;
 
-    static void hash_oneblock(uint8_t *digest, const void *message)
-    {
-        static constexpr uint32_t k[BLOCK_SIZE] = {
-            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4,
-            0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe,
-            0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f,
-            0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
-            0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
-            0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
-            0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116,
-            0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7,
-            0xc67178f2,
-        };
+private:
+    static constexpr uint32_t k[BLOCK_SIZE] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4,
+        0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe,
+        0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f,
+        0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+        0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+        0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+        0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116,
+        0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7,
+        0xc67178f2,
+    };
+
+    static constexpr uint32_t iv[DIGEST_SIZE / sizeof(uint32_t)] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
 
+public:
+    static void hash_oneblock_generic(uint8_t *digest, const void *message)
+    {
         uint32_t w[64];
-        uint32_t wv[DIGEST_SIZE / sizeof(uint32_t)] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
-                                                       0xa54ff53a, 0x510e527f, 0x9b05688c,
-                                                       0x1f83d9ab, 0x5be0cd19};
+        uint32_t wv[DIGEST_SIZE / sizeof(uint32_t)];
+
+        for (uint32_t i = 0; i < 8; ++i)
+            wv[i] = iv[i];
 
         for (uint32_t i = 0; i < 16; ++i)
             w[i] = _bswap(((const uint32_t *)message)[i]);
@@ -60,17 +73,148 @@ public:
             wv[0] = t1 + t2;
         }
 
-        wv[0] += 0x6a09e667;
-        wv[1] += 0xbb67ae85;
-        wv[2] += 0x3c6ef372;
-        wv[3] += 0xa54ff53a;
-        wv[4] += 0x510e527f;
-        wv[5] += 0x9b05688c;
-        wv[6] += 0x1f83d9ab;
-        wv[7] += 0x5be0cd19;
-
         for (uint32_t i = 0; i < 8; i++)
-            ((uint32_t *)digest)[i] = _bswap(wv[i]);
+            ((uint32_t *)digest)[i] = _bswap(wv[i] + iv[i]);
+    }
+
+    TARGET_SHA static void hash_oneblock_ni(uint8_t *digest, const void *message)
+    {
+        const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0b, 0x0405060700010203);
+        const __m128i *in = (const __m128i *)message;
+
+        // The rounds instructions keep the state as (a, b, e, f) and (c, d, g, h)
+        __m128i t = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)iv), 0xb1);
+        __m128i s1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(iv + 4)), 0x1b);
+        __m128i s0 = _mm_alignr_epi8(t, s1, 8);
+        __m128i msg[4];
+
+        s1 = _mm_blend_epi16(s1, t, 0xf0);
+
+        const __m128i abef = s0;
+        const __m128i cdgh = s1;
+
+        for (size_t i = 0; i < 16; ++i)
+        {
+            // Four schedule words at a time, msg holds the last sixteen
+            if (i < 4)
+                msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(in + i), bswap);
+            else
+                msg[i % 4] = _mm_sha256msg2_epu32(
+                    _mm_add_epi32(_mm_sha256msg1_epu32(msg[i % 4], msg[(i + 1) % 4]),
+                                  _mm_alignr_epi8(msg[(i + 3) % 4], msg[(i + 2) % 4], 4)),
+                    msg[(i + 3) % 4]);
+
+            __m128i wk = _mm_add_epi32(msg[i % 4], _mm_loadu_si128((const __m128i *)(k + 4 * i)));
+
+            s1 = _mm_sha256rnds2_epu32(s1, s0, wk);
+            s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(wk, 0x0e));
+        }
+
+        s0 = _mm_shuffle_epi32(_mm_add_epi32(s0, abef), 0x1b);
+        s1 = _mm_shuffle_epi32(_mm_add_epi32(s1, cdgh), 0xb1);
+
+        _mm_storeu_si128((__m128i *)digest, _mm_shuffle_epi8(_mm_blend_epi16(s0, s1, 0xf0), bswap));
+        _mm_storeu_si128((__m128i *)(digest + 16),
+                         _mm_shuffle_epi8(_mm_alignr_epi8(s1, s0, 8), bswap));
+    }
+
+    // LANES_N independent blocks of messages into digests, one block per vector lane
+    // Always inlined into the target wrappers below, so the vector ABI of its own copy is unused
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+    template<typename Lanes>
+    static KERNEL_INLINE void hash_lanes(uint8_t *digests, const uint8_t *messages)
+    {
+        using L = Lanes;
+        using V = typename L::V;
+
+        V w[16];
+        V wv[8];
+
+        for (size_t i = 0; i < 16; ++i)
+            w[i] = L::load(messages, i, BLOCK_SIZE);
+
+        for (size_t i = 0; i < 8; ++i)
+            wv[i] = L::set1(iv[i]);
+
+        for (size_t i = 0; i < 64; ++i)
+        {
+            // The schedule only keeps the last sixteen words
+            if (i >= 16)
+            {
+                V w2 = w[(i - 2) % 16];
+                V w15 = w[(i - 15) % 16];
+
+                w[i % 16] = L::add(
+                    L::add(w[i % 16], w[(i - 7) % 16]),
+                    L::add(L::xor3(L::ror(w2, 17), L::ror(w2, 19), L::shr(w2, 10)),
+                           L::xor3(L::ror(w15, 7), L::ror(w15, 18), L::shr(w15, 3))));
+            }
+
+            V t1 = L::add(L::add(wv[7], L::xor3(L::ror(wv[4], 6), L::ror(wv[4], 11),
+                                                L::ror(wv[4], 25))),
+                          L::add(L::ch(wv[4], wv[5], wv[6]), L::add(L::set1(k[i]), w[i % 16])));
+            V t2 = L::add(L::xor3(L::ror(wv[0], 2), L::ror(wv[0], 13), L::ror(wv[0], 22)),
+                          L::maj(wv[0], wv[1], wv[2]));
+
+            wv[7] = wv[6];
+            wv[6] = wv[5];
+            wv[5] = wv[4];
+            wv[4] = L::add(wv[3], t1);
+            wv[3] = wv[2];
+            wv[2] = wv[1];
+            wv[1] = wv[0];
+            wv[0] = L::add(t1, t2);
+        }
+
+        uint32_t out[8][L::LANES_N];
+
+        for (size_t i = 0; i < 8; ++i)
+            L::store(out[i], L::add(wv[i], L::set1(iv[i])));
+
+        for (size_t j = 0; j < L::LANES_N; ++j)
+            for (size_t i = 0; i < 8; ++i)
+                ((uint32_t *)(digests + j * DIGEST_SIZE))[i] = _bswap(out[i][j]);
+    }
+
+#pragma GCC diagnostic pop
+
+    TARGET_AVX2 static void hash_lanes_avx2(uint8_t *digests, const uint8_t *messages)
+    {
+        hash_lanes<U32x8>(digests, messages);
+    }
+
+    TARGET_AVX512 static void hash_lanes_avx512(uint8_t *digests, const uint8_t *messages)
+    {
+        hash_lanes<U32x16>(digests, messages);
+    }
+
+    static void hash_oneblock(uint8_t *digest, const void *message)
+    {
+        // SHA-NI has the lowest latency for a single block
+        if (cpu_features().sha)
+            hash_oneblock_ni(digest, message);
+        else
+            hash_oneblock_generic(digest, message);
+    }
+
+    static void hash_oneblock_many(uint8_t *digests, const void *messages, size_t count)
+    {
+        const CpuFeatures &cpu = cpu_features();
+        const uint8_t *msg = (const uint8_t *)messages;
+        size_t i = 0;
+
+        if (cpu.avx512f)
+            for (; i + U32x16::LANES_N <= count; i += U32x16::LANES_N)
+                hash_lanes_avx512(digests + DIGEST_SIZE * i, msg + BLOCK_SIZE * i);
+
+        if (cpu.avx2)
+            for (; i + U32x8::LANES_N <= count; i += U32x8::LANES_N)
+                hash_lanes_avx2(digests + DIGEST_SIZE * i, msg + BLOCK_SIZE * i);
+
+        // Blocks that do not fill the lanes
+        for (; i < count; ++i)
+            hash_oneblock(digests + DIGEST_SIZE * i, msg + BLOCK_SIZE * i);
     }
 
     static void hash_add(void *x, const void *y)
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "tree/subtree_build.hpp"
+#include "tree/tree_cursor.hpp"
+#include "util/algebra.hpp"
+#include "util/const_math.hpp"
+#include "util/string_utils.hpp"
+
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <omp.h>
+#include <vector>
+
+#if __cplusplus >= 202002L
+    #include <ranges>
+#endif
+
+/*
+Field-native Merkle trees for algebraic sponge hashes (Arion, ArionV2, Griffin, Poseidon5).
+Digests are kept as Hash::Field in Montgomery form from the leaves to the root, and children
+are fed straight into Hash::hash_field_n. Bytes only appear at the API boundary: when the
+input blocks are read and when a digest is requested.
+*/
+template<size_t height, typename Hash>
+class FieldMTree
+{
+public:
+    using Node = TreeCursor<FieldMTree>;
+    using Field = typename Hash::Field;
+    using Sponge = typename Hash::Sponge;
+
+    static constexpr size_t ARITY = Hash::RATE;
+    static constexpr size_t LEAVES_N = pow(ARITY, height - 1);
+    static constexpr size_t NODES_N = pow_sum(ARITY, (size_t)0, height);
+    static constexpr size_t INPUT_N = LEAVES_N * ARITY;
+    static constexpr size_t INPUT_SIZE = LEAVES_N * Hash::BLOCK_SIZE;
+    static constexpr size_t LANES_N = Hash::LANES_N;
+
+private:
+    // Same implicit layout as MTree, one field element per node
+    static constexpr std::array<size_t, height + 1> LEVEL_OFFSET = []() {
+        std::array<size_t, height + 1> offset{};
+
+        for (size_t l = 0; l <= height; ++l)
+            offset[l] = pow_sum(ARITY, height - l, height);
+
+        return offset;
+    }();
+
+    std::vector<Field> nodes{};
+
+    friend Node;
+
+public:
+    FieldMTree() = default;
+#if __cplusplus >= 202002L
+    template<std::ranges::range Range>
+    FieldMTree(const Range &range) :
+        FieldMTree(std::ranges::cdata(range),
+                   std::ranges::size(range) * sizeof(*std::ranges::cdata(range)))
+    {}
+#endif
+
+    template<typename Iter>
+    FieldMTree(const Iter begin, const Iter end) :
+        FieldMTree(&*begin, std::distance(begin, end) * sizeof(*begin))
+    {}
+
+    FieldMTree(const void *vdata, size_t sz) : nodes(NODES_N)
+    {
+        if (sz != INPUT_SIZE)
+        {
+            std::cerr << "FieldMTree: Bad size of input data\n";
+            return;
+        }
+
+        const uint8_t *data = (const uint8_t *)vdata;
+
+        // input bytes are converted exactly once
+        build([data](size_t i)
+              { return field_from_bytes<Field>(data + i * Hash::DIGEST_SIZE); });
+    }
+
+    FieldMTree(const std::vector<Field> &leaves) : nodes(NODES_N)
+    {
+        if (leaves.size() != INPUT_N)
+        {
+            std::cerr << "FieldMTree: Bad number of input elements\n";
+            return;
+        }
+
+        build([&leaves](size_t i) { return leaves[i]; });
+    }
+
+    std::array<uint8_t, Hash::DIGEST_SIZE> digest() const
+    {
+        return digest_of(NODES_N - 1);
+    }
+
+    const Field &digest_field() const
+    {
+        return nodes.back();
+    }
+
+    Node get_node(size_t i) const
+    {
+        return {this, i};
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const FieldMTree &tree)
+    {
+        if (tree.nodes.empty())
+            return os << "*:";
+
+        return os << tree.get_node(NODES_N - 1);
+    }
+
+private:
+    static size_t level_of(size_t i)
+    {
+        size_t l = 0;
+
+        while (i >= LEVEL_OFFSET[l + 1])
+            ++l;
+
+        return l;
+    }
+
+    std::array<uint8_t, Hash::DIGEST_SIZE> digest_of(size_t i) const
+    {
+        std::array<uint8_t, Hash::DIGEST_SIZE> bytes;
+
+        field_to_bytes(bytes.data(), nodes[i]);
+
+        return bytes;
+    }
+
+    const Field &field_of(size_t i) const { return nodes[i]; }
+
+    static size_t parent_of(size_t i)
+    {
+        size_t l = level_of(i);
+
+        if (l + 1 == height)
+            return Node::NONE;
+
+        return LEVEL_OFFSET[l + 1] + (i - LEVEL_OFFSET[l]) / ARITY;
+    }
+
+    static size_t child_of(size_t i, size_t k)
+    {
+        size_t l = level_of(i);
+
+        if (l == 0)
+            return Node::NONE;
+
+        return LEVEL_OFFSET[l - 1] + (i - LEVEL_OFFSET[l]) * ARITY + k;
+    }
+
+    void print(std::ostream &os, size_t i) const
+    {
+        size_t l = level_of(i);
+
+        for (size_t d = l + 1; d < height; ++d)
+            os << "    ";
+
+        os << "*: " << hexdump(digest_of(i), false, 64) << '\n';
+
+        for (size_t k = 0; l > 0 && k < ARITY; ++k)
+            print(os, child_of(i, k));
+    }
+
+    template<typename Input>
+    void build(const Input &input)
+    {
+        // children are never converted back to bytes
+        build_subtrees<ARITY>(
+            height,
+            [this, &input](size_t first, size_t n)
+            {
+                hash_level(&this->nodes[first], n,
+                           [&input, first](size_t i) { return input(first * ARITY + i); });
+            },
+            [this](size_t l, size_t first, size_t n)
+            {
+                const Field *children = &this->nodes[LEVEL_OFFSET[l - 1] + first * ARITY];
+
+                hash_level(&this->nodes[LEVEL_OFFSET[l] + first], n,
+                           [children](size_t i) { return children[i]; });
+            });
+    }
+
+    // n nodes from n * ARITY consecutive children, LANES_N nodes at a time
+    template<typename Children>
+    static void hash_level(Field *out, size_t n, const Children &children)
+    {
+        for (size_t j = 0; j < n; j += LANES_N)
+        {
+            std::array<Sponge, LANES_N> h{};
+            size_t m = std::min(LANES_N, n - j);
+
+            for (size_t i = 0; i < m; ++i)
+                for (size_t k = 0; k < ARITY; ++k)
+                    h[i][k] = children((j + i) * ARITY + k);
+
+            Hash::hash_field_n(h);
+
+            for (size_t i = 0; i < m; ++i)
+                out[j + i] = h[i][0];
+        }
+    }
+};
@@ -1,15 +1,93 @@
 #pragma once
 
+#include "hash/batch.hpp"
+#include "tree/subtree_build.hpp"
+#include "tree/tree_cursor.hpp"
 #include "util/string_utils.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cstring>
 #include <iostream>
+#include <type_traits>
 #include <vector>
 
 #if __cplusplus >= 202002L
     #include <ranges>
 #endif
 
+/*
+ABR parents of n nodes: H(left + middle, right + middle) + right, where + is Hash::hash_add.
+pairs holds the n (left, right) digest pairs one after the other. The blocks of up to LANES_N
+parents are hashed at once.
+*/
+template<typename Hash, typename = void>
+struct AbrParents
+{
+    static void hash(uint8_t *digests, const uint8_t *pairs, const uint8_t *middles, size_t n)
+    {
+        static constexpr size_t LANES_N = hash_lanes_v<Hash>;
+
+        for (size_t j = 0; j < n; j += LANES_N)
+        {
+            uint8_t blocks[LANES_N * Hash::BLOCK_SIZE]{};
+            size_t m = std::min(LANES_N, n - j);
+
+            for (size_t i = 0; i < m; ++i)
+            {
+                uint8_t *block = blocks + i * Hash::BLOCK_SIZE;
+                const uint8_t *middle = middles + (j + i) * Hash::DIGEST_SIZE;
+
+                memcpy(block, pairs + 2 * (j + i) * Hash::DIGEST_SIZE, 2 * Hash::DIGEST_SIZE);
+                Hash::hash_add(block, middle);
+                Hash::hash_add(block + Hash::DIGEST_SIZE, middle);
+            }
+
+            hash_oneblock_many<Hash>(digests + j * Hash::DIGEST_SIZE, blocks, m);
+
+            for (size_t i = 0; i < m; ++i)
+                Hash::hash_add(digests + (j + i) * Hash::DIGEST_SIZE,
+                               pairs + (2 * (j + i) + 1) * Hash::DIGEST_SIZE);
+        }
+    }
+};
+
+#ifdef USE_LIBFF
+// Sponge hashes add on field elements, every digest is converted once and the sums never are
+template<typename Hash>
+struct AbrParents<Hash, std::void_t<typename Hash::Sponge>>
+{
+    static void hash(uint8_t *digests, const uint8_t *pairs, const uint8_t *middles, size_t n)
+    {
+        using Field = typename Hash::Field;
+
+        auto field = [](const uint8_t *digest, size_t i)
+        { return field_from_bytes<Field>(digest + i * Hash::DIGEST_SIZE); };
+
+        for (size_t j = 0; j < n; j += Hash::LANES_N)
+        {
+            std::array<typename Hash::Sponge, Hash::LANES_N> h{};
+            std::array<Field, Hash::LANES_N> right;
+            size_t m = std::min(Hash::LANES_N, n - j);
+
+            for (size_t i = 0; i < m; ++i)
+            {
+                Field middle = field(middles, j + i);
+
+                right[i] = field(pairs, 2 * (j + i) + 1);
+                h[i][0] = field(pairs, 2 * (j + i)) + middle;
+                h[i][1] = right[i] + middle;
+            }
+
+            Hash::hash_field_n(h);
+
+            for (size_t i = 0; i < m; ++i)
+                field_to_bytes(digests + (j + i) * Hash::DIGEST_SIZE, h[i][0] + right[i]);
+        }
+    }
+};
+#endif
+
 template<typename Hash>
 class FixedAbrNode
 {
@@ -21,9 +99,6 @@ private:
     FixedAbrNode *r = nullptr;
     size_t depth = 0;
 
-    template<size_t, typename>
-    friend class FixedAbr;
-
     template<size_t, typename>
     friend class FixedAbrPath;
 
@@ -48,15 +123,12 @@ public:
     FixedAbrNode(const uint8_t *left, const uint8_t *right, const uint8_t *middle, size_t depth) :
         depth{depth}
     {
-        uint8_t block[Hash::BLOCK_SIZE];
+        uint8_t pair[2 * Hash::DIGEST_SIZE];
 
-        memcpy(block, left, Hash::DIGEST_SIZE);
-        memcpy(block + Hash::DIGEST_SIZE, right, Hash::DIGEST_SIZE);
+        memcpy(pair, left, Hash::DIGEST_SIZE);
+        memcpy(pair + Hash::DIGEST_SIZE, right, Hash::DIGEST_SIZE);
 
-        Hash::hash_add(block, middle);
-        Hash::hash_add(block + Hash::DIGEST_SIZE, middle);
-        Hash::hash_oneblock(this->digest, block);
-        Hash::hash_add(this->digest, right);
+        AbrParents<Hash>::hash(this->digest, pair, middle, 1);
     }
 
     const uint8_t *get_digest() const { return digest; }
@@ -95,16 +167,23 @@ template<size_t height, typename Hash>
 class FixedAbr
 {
 private:
-    using Node = FixedAbrNode<Hash>;
+    using Node = TreeCursor<FixedAbr>;
+    using Digest = std::array<uint8_t, Hash::DIGEST_SIZE>;
+
+    static_assert(sizeof(Digest) == Hash::DIGEST_SIZE);
 
     /*
     Nodes layout is as follows:
     - The first LEAVES_N nodes contain the leaves
     - The next INTERNAL_N nodes contain the "internal leaves" (aka middle nodes)
-    - The remaining nodes are the internal nodes of the tree
+    - The remaining nodes are the internal nodes of the tree, level by level
+    Only digests are stored. Counting internal nodes from INPUT_N, the first FIRST_N ones are
+    the parents of leaves 2p and 2p + 1, node FIRST_N + q is the parent of internal nodes 2q
+    and 2q + 1 and of middle node LEAVES_N + q. Children are numbered l, r, then the middle one.
     */
-    std::vector<Node> nodes{};
-    Node *root = nullptr;
+    std::vector<Digest> nodes{};
+
+    friend Node;
 
 public:
     static constexpr size_t INTERNAL_N = (1ULL << (height - 2)) - 1;
@@ -112,6 +191,11 @@ public:
     static constexpr size_t INPUT_N = LEAVES_N + INTERNAL_N;
     static constexpr size_t INPUT_SIZE = INPUT_N * Hash::BLOCK_SIZE;
 
+private:
+    static constexpr size_t FIRST_N = LEAVES_N / 2;
+    static constexpr size_t NODES_N = (1ULL << height) - 1 + INTERNAL_N;
+
+public:
     FixedAbr() = default;
 
 #if __cplusplus >= 202002L
@@ -127,8 +211,7 @@ public:
         FixedAbr(&*begin, std::distance(begin, end) * sizeof(*begin))
     {}
 
-    FixedAbr(const void *vdata, size_t sz) :
-        nodes((1ULL << height) - 1 + INTERNAL_N), root{&nodes.back()}
+    FixedAbr(const void *vdata, size_t sz) : nodes(NODES_N)
     {
         if (sz != INPUT_SIZE)
         {
@@ -137,123 +220,140 @@ public:
         }
 
         const uint8_t *data = (const uint8_t *)vdata;
-        size_t depth = height - 1;
-        size_t last = 0;
 
-#if 0 // serial code                                                                               
-
-      // add leaves and middle nodes
-            for (size_t i = 0; i < INPUT_N; ++i)
-                this->nodes[last++] = Node{data + Hash::BLOCK_SIZE * i, depth};
-
-
-            // build first internal layer (only hash, no addition)
-            --depth;
-            for (size_t i = 0; i < LEAVES_N; i += 2)
+        // Level l > 0 is internal layer l - 1, middle nodes are hashed along with their parent
+        build_subtrees<2>(
+            height,
+            [this, data](size_t first, size_t n)
             {
-                this->nodes[last] = Node{this->nodes[i].digest, this->nodes[i + 1].digest, depth};
-
-                this->nodes[last].l = &this->nodes[i];
-                this->nodes[last].r = &this->nodes[i + 1];
-                this->nodes[i].f = &this->nodes[last];
-                this->nodes[i + 1].f = &this->nodes[last];
-                ++last;
-            }
-
-            for (size_t i = INPUT_N, len = i + LEAVES_N / 2, e = LEAVES_N; depth > 0;
-                 len += 1ULL << depth)
+                hash_oneblock_many<Hash>(this->nodes[first].data(),
+                                         data + Hash::BLOCK_SIZE * first, n);
+            },
+            [this, data](size_t l, size_t first, size_t n)
             {
-                --depth;
-                while (i < len)
+                size_t begin = INPUT_N + internal_offset(l - 1) + first;
+
+                // first internal layer (only hash, no addition), the leaf pairs are blocks
+                if (l == 1)
                 {
-                    this->nodes[last] = Node{this->nodes[i].digest, this->nodes[i + 1].digest,
-                                             this->nodes[e].digest, depth};
+                    if constexpr (Hash::BLOCK_SIZE == 2 * Hash::DIGEST_SIZE)
+                        hash_oneblock_many<Hash>(this->nodes[begin].data(),
+                                                 this->nodes[2 * first].data(), n);
+                    else
+                        for (size_t j = 0; j < n; ++j)
+                            hash_children(this->nodes[begin + j].data(),
+                                          this->nodes[2 * (first + j)].data(),
+                                          this->nodes[2 * (first + j) + 1].data());
+                    return;
+                }
 
-                    this->nodes[last].l = &this->nodes[i];
-                    this->nodes[last].e = &this->nodes[e];
-                    this->nodes[last].r = &this->nodes[i + 1];
+                size_t q = begin - INPUT_N - FIRST_N;
 
-                    this->nodes[last].e->depth = depth + 1;
+                hash_oneblock_many<Hash>(this->nodes[LEAVES_N + q].data(),
+                                         data + Hash::BLOCK_SIZE * (LEAVES_N + q), n);
 
-                    this->nodes[i].f = &this->nodes[last];
-                    this->nodes[e].f = &this->nodes[last];
-                    this->nodes[i + 1].f = &this->nodes[last];
+                AbrParents<Hash>::hash(this->nodes[begin].data(),
+                                       this->nodes[INPUT_N + 2 * q].data(),
+                                       this->nodes[LEAVES_N + q].data(), n);
+            });
+    }
 
-                    i += 2;
-                    ++last;
-                    ++e;
-                }
-            }
-#else // parallel code
+    const uint8_t *digest() const
+    {
+        return nodes.back().data();
+    }
 
-        // add leaves and middle nodes
-    #pragma omp parallel for
-        for (size_t i = 0; i < INPUT_N; ++i)
-            this->nodes[i] = Node{data + Hash::BLOCK_SIZE * i, depth};
-        last = INPUT_N;
+    Node get_node(size_t i) const
+    {
+        return {this, i};
+    }
 
+    friend std::ostream &operator<<(std::ostream &os, const FixedAbr &tree)
+    {
+        if (tree.nodes.empty())
+            return os;
 
-        // build first internal layer (only hash, no addition)
-        --depth;
-        for (size_t i = 0; i < LEAVES_N; i += 2)
-        {
-            this->nodes[last] = Node{this->nodes[i].digest, this->nodes[i + 1].digest, depth};
+        return os << tree.get_node(NODES_N - 1);
+    }
 
-            this->nodes[last].l = &this->nodes[i];
-            this->nodes[last].r = &this->nodes[i + 1];
-            this->nodes[i].f = &this->nodes[last];
-            this->nodes[i + 1].f = &this->nodes[last];
-            ++last;
-        }
+private:
+    static void hash_children(uint8_t *digest, const uint8_t *left, const uint8_t *right)
+    {
+        uint8_t block[Hash::BLOCK_SIZE]{};
 
-        for (size_t i = INPUT_N, len = i + LEAVES_N / 2, e = LEAVES_N; depth > 0;
-             len += 1ULL << depth)
-        {
-            --depth;
-            size_t iters = (len - i) >> 1;
-    #pragma omp parallel for
-            for (size_t j = 0; j < iters; ++j)
-            {
-                size_t k = i + j * 2;
-                size_t l = last + j;
-                size_t f = e + j;
+        memcpy(block, left, Hash::DIGEST_SIZE);
+        memcpy(block + Hash::DIGEST_SIZE, right, Hash::DIGEST_SIZE);
 
-                this->nodes[l] = Node{this->nodes[k].digest, this->nodes[k + 1].digest,
-                                      this->nodes[f].digest, depth};
+        Hash::hash_oneblock(digest, block);
+    }
 
-                this->nodes[l].l = &this->nodes[k];
-                this->nodes[l].e = &this->nodes[f];
-                this->nodes[l].r = &this->nodes[k + 1];
+    // First internal node of layer t, counted from INPUT_N
+    static constexpr size_t internal_offset(size_t t)
+    {
+        return LEAVES_N - (LEAVES_N >> t);
+    }
 
-                this->nodes[l].e->depth = depth + 1;
+    const uint8_t *digest_of(size_t i) const { return nodes[i].data(); }
 
-                this->nodes[k].f = &this->nodes[l];
-                this->nodes[f].f = &this->nodes[l];
-                this->nodes[k + 1].f = &this->nodes[l];
-            }
-            i += iters * 2;
-            last += iters;
-            e += iters;
-        }
-#endif
+    static size_t parent_of(size_t i)
+    {
+        if (i < LEAVES_N)
+            return INPUT_N + i / 2;
+        if (i < INPUT_N)
+            return INPUT_N + FIRST_N + (i - LEAVES_N);
+        if (i + 1 == NODES_N)
+            return Node::NONE;
+
+        return INPUT_N + FIRST_N + (i - INPUT_N) / 2;
     }
 
-    const uint8_t *digest() const
+    static size_t child_of(size_t i, size_t k)
     {
-        return root->digest;
+        if (i < INPUT_N)
+            return Node::NONE;
+        if (i < INPUT_N + FIRST_N)
+            return k < 2 ? 2 * (i - INPUT_N) + k : Node::NONE;
+
+        size_t q = i - INPUT_N - FIRST_N;
+
+        return k < 2 ? INPUT_N + 2 * q + k : LEAVES_N + q;
     }
 
-    const Node *get_node(size_t i) const
+    static size_t depth_of(size_t i)
     {
-        return &nodes[i];
+        if (i < LEAVES_N)
+            return height - 1;
+        if (i < INPUT_N)
+            return depth_of(parent_of(i)) + 1;
+
+        size_t t = 0;
+
+        while (i - INPUT_N >= internal_offset(t + 1))
+            ++t;
+
+        return height - 2 - t;
     }
 
-    friend std::ostream &operator<<(std::ostream &os, const FixedAbr &tree)
+    void print(std::ostream &os, size_t i) const
     {
-        if (!tree.root)
-            return os;
+        for (size_t d = 0; d < depth_of(i); ++d)
+            os << "    ";
 
-        return os << *tree.root;
+        if (i + 1 == NODES_N)
+            os << '*';
+        else if (i >= LEAVES_N && i < INPUT_N)
+            os << 'M';
+        else
+            os << ((i < LEAVES_N ? i : i - INPUT_N) % 2 ? 'R' : 'L');
+
+        os << ": " << hexdump(nodes[i].data(), Hash::DIGEST_SIZE) << '\n';
+        if (i >= INPUT_N)
+        {
+            print(os, child_of(i, 0));
+            if (child_of(i, 2) != Node::NONE)
+                print(os, child_of(i, 2));
+            print(os, child_of(i, 1));
+        }
     }
 };
 
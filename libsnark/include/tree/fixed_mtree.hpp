@@ -1,79 +1,71 @@
 #pragma once
 
+#include "hash/batch.hpp"
+#include "tree/path_update.hpp"
+#include "tree/path_verify.hpp"
+#include "tree/subtree_build.hpp"
+#include "tree/tree_cursor.hpp"
 #include "util/string_utils.hpp"
 
+#include <array>
 #include <cstring>
 #include <iostream>
 #include <omp.h>
+#include <utility>
 #include <vector>
 
 #if __cplusplus >= 202002L
     #include <ranges>
 #endif
 
+// Hashes n pairs of consecutive digests, each pair is zero padded to a block
 template<typename Hash>
-class FixedMTreeNode
+void fixed_mtree_hash_pairs(uint8_t *digests, const uint8_t *pairs, size_t n)
 {
-private:
-    std::array<uint8_t, Hash::DIGEST_SIZE> digest;
-    FixedMTreeNode *f = nullptr;
-    FixedMTreeNode *l = nullptr;
-    FixedMTreeNode *r = nullptr;
-    size_t depth = 0;
-
-    template<size_t sz, typename>
-    friend class FixedMTree;
-
-    template<size_t, typename>
-    friend class FixedMTreePath;
-
-public:
-    FixedMTreeNode() = default;
-
-    FixedMTreeNode(const uint8_t *digest, size_t depth) : depth{depth}
-    {
-        memcpy(this->digest.data(), digest, Hash::DIGEST_SIZE);
-    }
-
-    FixedMTreeNode(const uint8_t *left, const uint8_t *right, size_t depth) : depth{depth}
-    {
-        uint8_t block[Hash::BLOCK_SIZE]{};
-
-        memcpy(block, left, Hash::DIGEST_SIZE);
-        memcpy(block + Hash::DIGEST_SIZE, right, Hash::DIGEST_SIZE);
-
-        Hash::hash_oneblock(this->digest.data(), block);
-    }
-
-    const auto &get_digest() const { return digest; }
+    static constexpr size_t LANES_N = hash_lanes_v<Hash>;
 
-    friend std::ostream &operator<<(std::ostream &os, const FixedMTreeNode &node)
-    {
-        for (size_t i = 0; i < node.depth; ++i)
-            os << "    ";
-
-        os << "*: " << hexdump(node.get_digest(), false, 64) << '\n';
+    if constexpr (Hash::BLOCK_SIZE == 2 * Hash::DIGEST_SIZE)
+        hash_oneblock_many<Hash>(digests, pairs, n);
+    else
+        for (size_t i = 0; i < n; i += LANES_N)
+        {
+            uint8_t blocks[LANES_N * Hash::BLOCK_SIZE]{};
+            size_t m = std::min(LANES_N, n - i);
 
-        if (node.l)
-            os << *node.l;
-        if (node.r)
-            os << *node.r;
+            for (size_t j = 0; j < m; ++j)
+                memcpy(blocks + Hash::BLOCK_SIZE * j, pairs + 2 * Hash::DIGEST_SIZE * (i + j),
+                       2 * Hash::DIGEST_SIZE);
 
-        return os;
-    }
-};
+            hash_oneblock_many<Hash>(digests + Hash::DIGEST_SIZE * i, blocks, m);
+        }
+}
 
 
 template<size_t height, typename Hash>
 class FixedMTree
 {
+public:
+    using Digest = std::array<uint8_t, Hash::DIGEST_SIZE>;
+    // New digest of the leaf at the given index
+    using LeafUpdate = std::pair<size_t, Digest>;
+
 private:
-    using Node = FixedMTreeNode<Hash>;
+    using Node = TreeCursor<FixedMTree>;
 
     static constexpr size_t LEAVES_N = 1ULL << (height - 1);
+    static constexpr size_t NODES_N = (1ULL << height) - 1;
+    static constexpr size_t LANES_N = hash_lanes_v<Hash>;
+
+    static_assert(sizeof(Digest) == Hash::DIGEST_SIZE);
+
+    /*
+    Only digests are stored, level by level from the leaves to the root at NODES_N - 1.
+    Level l starts at level_offset(l), the children of node p of level l are nodes 2p and
+    2p + 1 of level l - 1.
+    */
+    std::vector<Digest> nodes{};
 
-    std::vector<Node> nodes{};
-    Node *root = nullptr;
+    friend Node;
 
 public:
     static constexpr size_t INPUT_SIZE = LEAVES_N * Hash::BLOCK_SIZE;
@@ -92,7 +84,7 @@ public:
         FixedMTree(&*begin, std::distance(begin, end) * sizeof(*begin))
     {}
 
-    FixedMTree(const void *vdata, size_t sz) : nodes((1ULL << height) - 1), root{&nodes.back()}
+    FixedMTree(const void *vdata, size_t sz) : nodes(NODES_N)
     {
         if (sz != INPUT_SIZE)
         {
@@ -101,91 +93,185 @@ public:
         }
 
         const uint8_t *data = (const uint8_t *)vdata;
-        size_t depth = height - 1;
 
-// serial code
-#if 0
-        // add leaves
-            for (size_t i = 0; i < LEAVES_N; ++i)
-                this->nodes[i] = {data + Hash::BLOCK_SIZE * i,
-                                  data + Hash::BLOCK_SIZE * i + Hash::DIGEST_SIZE, depth};
-
-            // build tree bottom-up
-            for (size_t i = 0, last = LEAVES_N, len = LEAVES_N; depth > 0; len += 1ULL << depth)
+        build_subtrees<2>(
+            height,
+            [this, data](size_t first, size_t n)
             {
-                --depth;
-                while (i < len)
+                // add leaves, LANES_N sibling blocks at a time
+                for (size_t i = first; i < first + n; i += LANES_N)
                 {
-                    this->nodes[last] = {this->nodes[i].get_digest().data(), this->nodes[i + 1].get_digest().data(), depth};
-
-                    this->nodes[last].l = &this->nodes[i];
-                    this->nodes[last].r = &this->nodes[i + 1];
-                    this->nodes[i].f = &this->nodes[last];
-                    this->nodes[i + 1].f = &this->nodes[last];
-                    i += 2;
-                    ++last;
+                    uint8_t blocks[LANES_N * Hash::BLOCK_SIZE]{};
+                    size_t m = std::min(LANES_N, first + n - i);
+
+                    // only the first two digests of each block are used
+                    for (size_t j = 0; j < m; ++j)
+                        memcpy(blocks + Hash::BLOCK_SIZE * j, data + Hash::BLOCK_SIZE * (i + j),
+                               2 * Hash::DIGEST_SIZE);
+
+                    hash_oneblock_many<Hash>(this->nodes[i].data(), blocks, m);
                 }
-            }
-#else // parallel code
-    #pragma omp parallel for
-        // add leaves
-        for (size_t i = 0; i < LEAVES_N; ++i)
-            this->nodes[i] = {data + Hash::BLOCK_SIZE * i,
-                              data + Hash::BLOCK_SIZE * i + Hash::DIGEST_SIZE, depth};
+            },
+            [this](size_t l, size_t first, size_t n)
+            {
+                // siblings are contiguous
+                fixed_mtree_hash_pairs<Hash>(this->nodes[level_offset(l) + first].data(),
+                                             this->nodes[level_offset(l - 1) + 2 * first].data(),
+                                             n);
+            });
+    }
 
-        // build tree bottom-up
-        for (size_t i = 0, last = LEAVES_N, len = LEAVES_N; depth > 0; len += 1ULL << depth)
-        {
-            size_t iters = (len - i) >> 1;
-            --depth;
-    #pragma omp parallel for
-            for (size_t j = 0; j < iters; ++j)
+#if __cplusplus >= 202002L
+    template<std::ranges::range Range>
+    void update_leaves(const Range &range)
+    {
+        update_leaves(std::ranges::cdata(range), std::ranges::size(range));
+    }
+#endif
+
+    template<typename Iter>
+    void update_leaves(const Iter begin, const Iter end)
+    {
+        update_leaves(&*begin, std::distance(begin, end));
+    }
+
+    // Sets leaf digests and recomputes their ancestors, the last update of a leaf wins
+    void update_leaves(const LeafUpdate *updates, size_t n)
+    {
+        std::vector<size_t> dirty(n);
+
+        for (size_t i = 0; i < n; ++i)
+            if (updates[i].first >= LEAVES_N)
             {
-                size_t k = i + j * 2;
-                size_t l = last + j;
-                this->nodes[l] = {this->nodes[k].get_digest().data(),
-                                  this->nodes[k + 1].get_digest().data(), depth};
-
-                this->nodes[l].l = &this->nodes[k];
-                this->nodes[l].r = &this->nodes[k + 1];
-                this->nodes[k].f = &this->nodes[l];
-                this->nodes[k + 1].f = &this->nodes[l];
+                std::cerr << "FixedMTree: Bad leaf index\n";
+                return;
             }
-            last += iters;
-            i += iters * 2;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            this->nodes[updates[i].first] = updates[i].second;
+            dirty[i] = updates[i].first;
         }
-#endif
+
+        update_paths<2>(
+            height, std::move(dirty),
+            [this](size_t l, const size_t *pos, size_t count)
+            {
+                // gather the children of LANES_N dirty parents at a time
+                for (size_t j = 0; j < count; j += LANES_N)
+                {
+                    uint8_t pairs[LANES_N * 2 * Hash::DIGEST_SIZE];
+                    uint8_t digests[LANES_N * Hash::DIGEST_SIZE];
+                    size_t m = std::min(LANES_N, count - j);
+
+                    for (size_t k = 0; k < m; ++k)
+                        memcpy(pairs + 2 * Hash::DIGEST_SIZE * k,
+                               this->nodes[level_offset(l - 1) + 2 * pos[j + k]].data(),
+                               2 * Hash::DIGEST_SIZE);
+
+                    fixed_mtree_hash_pairs<Hash>(digests, pairs, m);
+
+                    for (size_t k = 0; k < m; ++k)
+                        memcpy(this->nodes[level_offset(l) + pos[j + k]].data(),
+                               digests + Hash::DIGEST_SIZE * k, Hash::DIGEST_SIZE);
+                }
+            });
     }
 
     const auto &digest() const
     {
-        return root->get_digest();
+        return nodes.back();
     }
 
-    const Node *get_node(size_t i) const
+    Node get_node(size_t i) const
     {
-        return &nodes[i];
+        return {this, i};
     }
 
     friend std::ostream &operator<<(std::ostream &os, const FixedMTree &tree)
     {
-        if (!tree.root)
+        if (tree.nodes.empty())
             return os;
 
-        return os << *tree.root;
+        return os << tree.get_node(NODES_N - 1);
+    }
+
+private:
+    static constexpr size_t level_offset(size_t l)
+    {
+        return (1ULL << height) - (1ULL << (height - l));
+    }
+
+    static size_t level_of(size_t i)
+    {
+        size_t l = 0;
+
+        while (i >= level_offset(l + 1))
+            ++l;
+
+        return l;
+    }
+
+    const Digest &digest_of(size_t i) const { return nodes[i]; }
+
+    static size_t parent_of(size_t i)
+    {
+        size_t l = level_of(i);
+
+        if (l + 1 == height)
+            return Node::NONE;
+
+        return level_offset(l + 1) + ((i - level_offset(l)) >> 1);
+    }
+
+    static size_t child_of(size_t i, size_t k)
+    {
+        size_t l = level_of(i);
+
+        if (l == 0)
+            return Node::NONE;
+
+        return level_offset(l - 1) + ((i - level_offset(l)) << 1) + k;
+    }
+
+    void print(std::ostream &os, size_t i) const
+    {
+        size_t l = level_of(i);
+
+        for (size_t d = l + 1; d < height; ++d)
+            os << "    ";
+
+        os << "*: " << hexdump(nodes[i], false, 64) << '\n';
+
+        if (l > 0)
+        {
+            print(os, child_of(i, 0));
+            print(os, child_of(i, 1));
+        }
     }
 };
 
 template<size_t height, typename Hash>
 class FixedMTreePath
 {
+public:
+    using Digest = std::array<uint8_t, Hash::DIGEST_SIZE>;
+
 private:
-    using Node = FixedMTreeNode<Hash>;
+    using Node = TreeCursor<FixedMTreePath>;
 
     static constexpr size_t NODES_N = 2 * height - 1;
+    static constexpr size_t LANES_N = hash_lanes_v<Hash>;
+
+    static_assert(sizeof(Digest) == Hash::DIGEST_SIZE);
+
+    /*
+    Level l takes nodes 2l and 2l + 1, the first one is on the path and is the parent of the
+    level below. The root is alone on the last level.
+    */
+    std::vector<Digest> nodes{};
 
-    std::vector<Node> nodes{};
-    Node *root = nullptr;
+    friend Node;
 
 public:
     static constexpr size_t INPUT_SIZE = height * Hash::DIGEST_SIZE;
@@ -204,7 +290,7 @@ public:
         FixedMTreePath(&*begin, std::distance(begin, end) * sizeof(*begin))
     {}
 
-    FixedMTreePath(const void *vdata, size_t sz) : nodes(NODES_N), root{&nodes.back()}
+    FixedMTreePath(const void *vdata, size_t sz) : nodes(NODES_N)
     {
         if (sz != INPUT_SIZE)
         {
@@ -213,43 +299,86 @@ public:
         }
 
         const uint8_t *data = (const uint8_t *)vdata;
-        size_t depth = height - 1;
 
         // bootstrap first ndoe
-        this->nodes[0] = {data, depth};
+        memcpy(this->nodes[0].data(), data, Hash::DIGEST_SIZE);
 
         // build tree bottom-up
         for (size_t i = 2; i < NODES_N; i += 2)
         {
             // add other children
-            this->nodes[i - 1] = {data += Hash::DIGEST_SIZE, depth};
+            memcpy(this->nodes[i - 1].data(), data += Hash::DIGEST_SIZE, Hash::DIGEST_SIZE);
 
             // build parent
-            --depth;
-            this->nodes[i] = {this->nodes[i - 2].get_digest().data(),
-                              this->nodes[i - 1].get_digest().data(), depth};
-            this->nodes[i].l = &this->nodes[i - 2];
-            this->nodes[i].r = &this->nodes[i - 1];
-            this->nodes[i - 2].f = &this->nodes[i];
-            this->nodes[i - 1].f = &this->nodes[i];
+            fixed_mtree_hash_pairs<Hash>(this->nodes[i].data(), this->nodes[i - 2].data(), 1);
         }
     }
 
+    // Checks the path of the leaf at idx against a root, one sibling per level from the leaves
+    static bool verify_path(const uint8_t *root, const Digest &leaf, size_t idx,
+                            const Digest *siblings)
+    {
+        bool valid;
+
+        verify_paths_lanes<2, Hash::DIGEST_SIZE, 1>(&valid, height - 1, root, leaf.data(), &idx,
+                                                    (const uint8_t *)siblings, 1,
+                                                    fixed_mtree_hash_pairs<Hash>);
+
+        return valid;
+    }
+
+    // Checks n paths against the same root, height - 1 siblings each, valid[i] for path i
+    static void verify_paths(bool *valid, const uint8_t *root, const Digest *leaves,
+                             const size_t *indices, const Digest *siblings, size_t n)
+    {
+        verify_paths_many<2, Hash::DIGEST_SIZE, LANES_N>(
+            valid, height - 1, root, (const uint8_t *)leaves, indices, (const uint8_t *)siblings,
+            n, fixed_mtree_hash_pairs<Hash>);
+    }
+
     const auto &digest() const
     {
-        return root->get_digest();
+        return nodes.back();
     }
 
-    const Node *get_node(size_t i) const
+    Node get_node(size_t i) const
     {
-        return &nodes[i];
+        return {this, i};
     }
 
     friend std::ostream &operator<<(std::ostream &os, const FixedMTreePath &tree)
     {
-        if (!tree.root)
+        if (tree.nodes.empty())
             return os;
 
-        return os << *tree.root;
+        return os << tree.get_node(NODES_N - 1);
+    }
+
+private:
+    const Digest &digest_of(size_t i) const { return nodes[i]; }
+
+    static size_t parent_of(size_t i)
+    {
+        return i + 1 < NODES_N ? (i | 1) + 1 : Node::NONE;
+    }
+
+    static size_t child_of(size_t i, size_t k)
+    {
+        // only the nodes on the path have children
+        return i % 2 == 0 && i > 0 ? i - 2 + k : Node::NONE;
+    }
+
+    void print(std::ostream &os, size_t i) const
+    {
+        for (size_t d = i / 2 + 1; d < height; ++d)
+            os << "    ";
+
+        os << "*: " << hexdump(nodes[i], false, 64) << '\n';
+
+        if (child_of(i, 0) != Node::NONE)
+        {
+            print(os, child_of(i, 0));
+            print(os, child_of(i, 1));
+        }
     }
 };
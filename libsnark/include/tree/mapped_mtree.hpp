@@ -0,0 +1,529 @@
+#pragma once
+
+#include "hash/batch.hpp"
+#include "tree/subtree_build.hpp"
+#include "tree/tree_cursor.hpp"
+#include "util/const_math.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+MTree kept in a memory-mapped file, for trees that do not fit in memory.
+The file holds a header page followed by the digests. Leaves are streamed from a mapped input
+file one chunk (a subtree of chunk_height levels) at a time, every chunk is synced to disk before
+the header records it, and the levels above the chunks are checkpointed level by level. An
+interrupted build resumes from the last recorded chunk, opening a complete tree is a plain mmap
+with no hashing.
+
+Digests are laid out in one of two ways, recorded in the header:
+- Layout::LEVELS, the implicit layout of MTree, level by level from the leaves. Building and
+  scanning a level are sequential, but a path touches one page per level.
+- Layout::BLOCKS, the block_height levels below a node stored whole in a page, without the node.
+  Levels under the root are grouped from the leaves, the top group may be shorter, and a block
+  keeps its nodes level by level from the children of its node. The root comes first in a block
+  of its own, then the groups from the root down and the blocks of a group from left to right.
+  Siblings always share a block, so a path touches ceil((height - 1) / block_height) pages, 4
+  instead of 14 for a binary SHA-256 tree of height 20, which is what a cold path query on a
+  read-only tree pays for.
+*/
+template<size_t height, typename Hash>
+class MappedMTree
+{
+public:
+    using Node = TreeCursor<MappedMTree>;
+    using Digest = std::array<uint8_t, Hash::DIGEST_SIZE>;
+
+    enum class Layout
+    {
+        LEVELS,
+        BLOCKS
+    };
+
+    static constexpr size_t ARITY = Hash::BLOCK_SIZE / Hash::DIGEST_SIZE;
+    static constexpr size_t LEAVES_N = pow(ARITY, height - 1);
+    static constexpr size_t NODES_N = pow_sum(ARITY, (size_t)0, height);
+    static constexpr size_t INPUT_SIZE = LEAVES_N * Hash::BLOCK_SIZE;
+    static constexpr size_t PATH_N = (ARITY - 1) * (height - 1);
+    // Default number of leaves hashed between two checkpoints
+    static constexpr size_t CHUNK_LEAVES = 1ULL << 16;
+    // Bytes of a block of Layout::BLOCKS, a page on common systems
+    static constexpr size_t PAGE_BYTES = 4096;
+
+    static_assert(ARITY * Hash::DIGEST_SIZE == Hash::BLOCK_SIZE,
+                  "MappedMTree: the children of a node must fill a block");
+
+private:
+    static constexpr size_t HEADER_SIZE = 4096;
+    static constexpr char MAGIC[8] = {'M', 'T', 'R', 'E', 'E', 'M', 'A', 'P'};
+
+    struct Header
+    {
+        char magic[8];
+        uint64_t tree_height;
+        uint64_t arity;
+        uint64_t digest_size;
+        // hash_id<Hash>()
+        uint8_t hash_id[8];
+        uint64_t chunk_height;
+        // Number of final nodes at the start of each level
+        uint64_t done[height];
+        // 0 for Layout::LEVELS, files written before the layouts were added read as such
+        uint64_t block_height;
+    };
+
+    static_assert(sizeof(Header) <= HEADER_SIZE);
+
+    static constexpr std::array<size_t, height + 1> LEVEL_OFFSET = []() {
+        std::array<size_t, height + 1> offset{};
+
+        for (size_t l = 0; l <= height; ++l)
+            offset[l] = pow_sum(ARITY, height - l, height);
+
+        return offset;
+    }();
+
+    /*
+    Node p of level l is at slot base[l] + p / span[l] * stride + above[l] + p % span[l]:
+    span[l] nodes of level l share a block, above[l] of its slots hold the levels above them.
+    Layout::LEVELS is the case of a single block as wide as every level.
+    */
+    size_t block_height = 0;
+    size_t stride = 0;
+    std::array<size_t, height> base{};
+    std::array<size_t, height> span{};
+    std::array<size_t, height> above{};
+    size_t file_size = 0;
+
+    int fd = -1;
+    uint8_t *map = nullptr;
+    Header *header = nullptr;
+    uint8_t *nodes = nullptr;
+
+    friend Node;
+
+public:
+    /*
+    Maps the tree file, creating an empty one with the given layout if it does not exist. An
+    existing file keeps the layout and chunk height it was created with.
+    */
+    explicit MappedMTree(const std::string &path, size_t chunk_leaves = CHUNK_LEAVES,
+                         Layout layout = Layout::LEVELS)
+    {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+        {
+            std::cerr << "MappedMTree: Cannot open " << path << '\n';
+            return;
+        }
+
+        struct stat st;
+        bool fresh = ::fstat(fd, &st) == 0 && st.st_size == 0;
+        uint64_t stored = 0;
+
+        if (!fresh && ((size_t)st.st_size < HEADER_SIZE ||
+                       ::pread(fd, &stored, sizeof(stored), offsetof(Header, block_height)) !=
+                           sizeof(stored)))
+        {
+            std::cerr << "MappedMTree: Bad size of " << path << '\n';
+            close();
+            return;
+        }
+        if (stored > height)
+        {
+            std::cerr << "MappedMTree: " << path << " holds a different tree\n";
+            close();
+            return;
+        }
+
+        set_layout(!fresh ? stored : layout == Layout::BLOCKS ? page_block_height() : 0);
+
+        if (fresh && ::ftruncate(fd, file_size) != 0)
+        {
+            std::cerr << "MappedMTree: Cannot resize " << path << '\n';
+            close();
+            return;
+        }
+        if (!fresh && (size_t)st.st_size != file_size)
+        {
+            std::cerr << "MappedMTree: Bad size of " << path << '\n';
+            close();
+            return;
+        }
+
+        void *p = ::mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            std::cerr << "MappedMTree: Cannot map " << path << '\n';
+            close();
+            return;
+        }
+
+        map = (uint8_t *)p;
+        header = (Header *)map;
+        nodes = map + HEADER_SIZE;
+
+        Header expected{};
+
+        memcpy(expected.magic, MAGIC, sizeof(MAGIC));
+        expected.tree_height = height;
+        expected.arity = ARITY;
+        expected.digest_size = Hash::DIGEST_SIZE;
+        expected.chunk_height = 0;
+        while (expected.chunk_height + 1 < height &&
+               pow(ARITY, expected.chunk_height + 1) <= chunk_leaves)
+            ++expected.chunk_height;
+        expected.block_height = block_height;
+
+        memcpy(expected.hash_id, hash_id<Hash>().data(), sizeof(expected.hash_id));
+
+        if (fresh)
+        {
+            *header = expected;
+            sync(header, HEADER_SIZE);
+        }
+        else if (memcmp(header, &expected, offsetof(Header, chunk_height)) != 0)
+        {
+            std::cerr << "MappedMTree: " << path << " holds a different tree\n";
+            close();
+            return;
+        }
+    }
+
+    MappedMTree(const MappedMTree &) = delete;
+    MappedMTree &operator=(const MappedMTree &) = delete;
+
+    ~MappedMTree() { close(); }
+
+    bool is_open() const { return map != nullptr; }
+    bool is_complete() const { return map && header->done[height - 1] == 1; }
+
+    Layout layout() const { return block_height == 0 ? Layout::LEVELS : Layout::BLOCKS; }
+
+    /*
+    Hashes the input file into the tree, starting from the last checkpoint.
+    Stops after max_chunks chunks, returns whether the tree is complete.
+    */
+    bool build(const std::string &input_path, size_t max_chunks = SIZE_MAX)
+    {
+        if (!map)
+            return false;
+        if (is_complete())
+            return true;
+
+        int in = ::open(input_path.c_str(), O_RDONLY);
+        struct stat st;
+
+        if (in < 0 || ::fstat(in, &st) != 0 || (size_t)st.st_size != INPUT_SIZE)
+        {
+            std::cerr << "MappedMTree: Bad input file " << input_path << '\n';
+            if (in >= 0)
+                ::close(in);
+            return false;
+        }
+
+        void *p = ::mmap(nullptr, INPUT_SIZE, PROT_READ, MAP_SHARED, in, 0);
+        ::close(in);
+        if (p == MAP_FAILED)
+        {
+            std::cerr << "MappedMTree: Cannot map " << input_path << '\n';
+            return false;
+        }
+        ::madvise(p, INPUT_SIZE, MADV_SEQUENTIAL);
+
+        const uint8_t *data = (const uint8_t *)p;
+        const size_t s = header->chunk_height;
+        const size_t chunks = pow(ARITY, height - 1 - s);
+
+        // subtrees of s + 1 levels, chunk c owns positions c * ARITY^(s - l) of level l
+        for (size_t c = header->done[s]; c < chunks && max_chunks > 0; ++c, --max_chunks)
+        {
+            build_subtrees<ARITY>(
+                s + 1,
+                [this, data, c, s](size_t first, size_t n)
+                {
+                    first += c * pow(ARITY, s);
+                    for_runs(0, first, n,
+                             [this, data](size_t pos, size_t m)
+                             {
+                                 hash_oneblock_many<Hash>(node(0, pos),
+                                                          data + pos * Hash::BLOCK_SIZE, m);
+                             });
+                },
+                [this, c, s](size_t l, size_t first, size_t n)
+                { hash_parents(l, first + c * pow(ARITY, s - l), n); });
+
+            for (size_t l = 0; l <= s; ++l)
+                sync_nodes(l, c * pow(ARITY, s - l), pow(ARITY, s - l));
+
+            for (size_t l = 0; l <= s; ++l)
+                header->done[l] = (c + 1) * pow(ARITY, s - l);
+            sync(header, HEADER_SIZE);
+        }
+
+        // the levels above the chunks are small, one checkpoint per level
+        for (size_t l = s + 1; l < height && header->done[s] == chunks; ++l)
+        {
+            size_t width = LEVEL_OFFSET[l + 1] - LEVEL_OFFSET[l];
+
+            if (header->done[l] == width)
+                continue;
+
+            hash_parents(l, 0, width);
+            sync_nodes(l, 0, width);
+
+            header->done[l] = width;
+            sync(header, HEADER_SIZE);
+        }
+
+        ::munmap(p, INPUT_SIZE);
+
+        return is_complete();
+    }
+
+    const uint8_t *digest() const
+    {
+        return node(height - 1, 0);
+    }
+
+    template<typename Iter>
+    std::vector<Digest> paths(const Iter begin, const Iter end) const
+    {
+        return paths(&*begin, std::distance(begin, end));
+    }
+
+    // Paths of the leaves at the given indices of a complete tree, laid out like MTree::paths
+    std::vector<Digest> paths(const size_t *indices, size_t n) const
+    {
+        if (!is_complete())
+        {
+            std::cerr << "MappedMTree: The tree is not complete\n";
+            return {};
+        }
+
+        for (size_t i = 0; i < n; ++i)
+            if (indices[i] >= LEAVES_N)
+            {
+                std::cerr << "MappedMTree: Bad leaf index\n";
+                return {};
+            }
+
+        std::vector<Digest> out(n * PATH_N);
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            Digest *dst = out.data() + i * PATH_N;
+
+            for (size_t l = 0, p = indices[i]; l + 1 < height; ++l, p /= ARITY)
+                for (size_t c = p / ARITY * ARITY; c < p / ARITY * ARITY + ARITY; ++c)
+                    if (c != p)
+                        memcpy((dst++)->data(), node(l, c), Hash::DIGEST_SIZE);
+        }
+
+        return out;
+    }
+
+    Node get_node(size_t i) const
+    {
+        return {this, i};
+    }
+
+private:
+    // Most levels below a node whose block fits in a page
+    static size_t page_block_height()
+    {
+        size_t b = 1;
+
+        while (b + 1 < height && block_slots(b + 1) * Hash::DIGEST_SIZE <= PAGE_BYTES)
+            ++b;
+
+        return b;
+    }
+
+    // Slots of a block of b levels, rounded up to a power of two so that a block never
+    // straddles a page when digests are a power of two bytes
+    static size_t block_slots(size_t b)
+    {
+        size_t slots = 1;
+
+        while (slots < pow_sum(ARITY, (size_t)1, b + 1))
+            slots *= 2;
+
+        return slots;
+    }
+
+    void set_layout(size_t b)
+    {
+        block_height = b;
+
+        if (b == 0)
+        {
+            for (size_t l = 0; l < height; ++l)
+            {
+                base[l] = LEVEL_OFFSET[l];
+                span[l] = SIZE_MAX;
+                above[l] = 0;
+            }
+
+            stride = 0;
+            file_size = HEADER_SIZE + NODES_N * Hash::DIGEST_SIZE;
+            return;
+        }
+
+        stride = block_slots(b);
+
+        base[height - 1] = 0;
+        span[height - 1] = SIZE_MAX;
+        above[height - 1] = 0;
+
+        // groups from the root down, a block for every node of the level above a group
+        size_t slots = stride;
+
+        for (size_t k = (height - 2) / b + 1; k-- > 0;)
+        {
+            const size_t top = std::min((k + 1) * b, height - 1) - 1;
+
+            for (size_t l = k * b; l <= top; ++l)
+            {
+                base[l] = slots;
+                span[l] = pow(ARITY, top + 1 - l);
+                above[l] = pow_sum(ARITY, (size_t)1, top + 1 - l);
+            }
+
+            slots += pow(ARITY, height - 2 - top) * stride;
+        }
+
+        file_size = HEADER_SIZE + slots * Hash::DIGEST_SIZE;
+    }
+
+    uint8_t *node(size_t level, size_t pos) const
+    {
+        return nodes + (base[level] + pos / span[level] * stride + above[level] +
+                        pos % span[level]) *
+                           Hash::DIGEST_SIZE;
+    }
+
+    // Calls f(pos, m) on the runs of nodes [pos, pos + m) of level l stored one after the other
+    template<typename F>
+    void for_runs(size_t l, size_t pos, size_t n, const F &f) const
+    {
+        for (size_t end = pos + n; pos < end;)
+        {
+            const size_t m = std::min(end - pos, span[l] - pos % span[l]);
+
+            f(pos, m);
+            pos += m;
+        }
+    }
+
+    /*
+    Nodes [pos, pos + n) of level l. Their children are contiguous, but at the top of a group of
+    Layout::BLOCKS where the children of every parent are in a block of their own, and are
+    gathered there so that the lanes of Hash stay busy.
+    */
+    void hash_parents(size_t l, size_t pos, size_t n)
+    {
+        if (span[l - 1] != ARITY)
+        {
+            for_runs(l, pos, n,
+                     [this, l](size_t p, size_t m)
+                     { hash_oneblock_many<Hash>(node(l, p), node(l - 1, p * ARITY), m); });
+            return;
+        }
+
+        static constexpr size_t BATCH = 64;
+        std::array<uint8_t, BATCH * Hash::BLOCK_SIZE> blocks;
+        std::array<uint8_t, BATCH * Hash::DIGEST_SIZE> digests;
+
+        for (size_t i = 0; i < n; i += BATCH)
+        {
+            const size_t m = std::min(BATCH, n - i);
+
+            for (size_t j = 0; j < m; ++j)
+                memcpy(blocks.data() + j * Hash::BLOCK_SIZE, node(l - 1, (pos + i + j) * ARITY),
+                       Hash::BLOCK_SIZE);
+
+            hash_oneblock_many<Hash>(digests.data(), blocks.data(), m);
+
+            for (size_t j = 0; j < m; ++j)
+                memcpy(node(l, pos + i + j), digests.data() + j * Hash::DIGEST_SIZE,
+                       Hash::DIGEST_SIZE);
+        }
+    }
+
+    // Syncs the slots from the first to the last of nodes [pos, pos + n) of level l
+    void sync_nodes(size_t l, size_t pos, size_t n) const
+    {
+        sync(node(l, pos), node(l, pos + n - 1) - node(l, pos) + Hash::DIGEST_SIZE);
+    }
+
+    static void sync(const void *p, size_t n)
+    {
+        static const uintptr_t page = (uintptr_t)::sysconf(_SC_PAGESIZE);
+
+        uintptr_t begin = (uintptr_t)p & ~(page - 1);
+
+        ::msync((void *)begin, (uintptr_t)p + n - begin, MS_SYNC);
+    }
+
+    void close()
+    {
+        if (map)
+            ::munmap(map, file_size);
+        if (fd >= 0)
+            ::close(fd);
+
+        fd = -1;
+        map = nullptr;
+        header = nullptr;
+        nodes = nullptr;
+    }
+
+    static size_t level_of(size_t i)
+    {
+        size_t l = 0;
+
+        while (i >= LEVEL_OFFSET[l + 1])
+            ++l;
+
+        return l;
+    }
+
+    // Nodes are numbered as in MTree whatever the layout
+    const Digest &digest_of(size_t i) const
+    {
+        size_t l = level_of(i);
+
+        return *(const Digest *)node(l, i - LEVEL_OFFSET[l]);
+    }
+
+    static size_t parent_of(size_t i)
+    {
+        size_t l = level_of(i);
+
+        if (l + 1 == height)
+            return Node::NONE;
+
+        return LEVEL_OFFSET[l + 1] + (i - LEVEL_OFFSET[l]) / ARITY;
+    }
+
+    static size_t child_of(size_t i, size_t k)
+    {
+        size_t l = level_of(i);
+
+        if (l == 0)
+            return Node::NONE;
+
+        return LEVEL_OFFSET[l - 1] + (i - LEVEL_OFFSET[l]) * ARITY + k;
+    }
+};
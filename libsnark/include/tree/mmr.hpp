@@ -0,0 +1,542 @@
+#pragma once
+
+#include "hash/batch.hpp"
+#include "tree/fixed_mtree.hpp"
+#include "util/const_math.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+Merkle Mountain Range, an append-only accumulator over any Hash an MTree accepts.
+The leaves form a list of perfect ARITY-ary subtrees (peaks) of decreasing height, one per non
+zero digit of the leaf count in base ARITY, at most ARITY - 1 of each height. Appending a leaf
+merges the last ARITY peaks while they have the same height, O(log n) hashes. The root bags the
+peaks from right to left, a peak and the running digest zero padded to a block like the parents
+of FixedMTree.
+
+Nodes are appended in post-order, never rewritten, either to memory or to a file that holds a
+small header and the digests. With a file only the peaks and the last unwritten nodes are kept in
+memory, proofs read the nodes they need. Any prefix of the file left by a crash is a valid MMR.
+*/
+template<typename Hash>
+class MMR
+{
+public:
+    using Digest = std::array<uint8_t, Hash::DIGEST_SIZE>;
+
+    static constexpr size_t ARITY = Hash::BLOCK_SIZE / Hash::DIGEST_SIZE;
+
+    static_assert(ARITY >= 2 && ARITY * Hash::DIGEST_SIZE == Hash::BLOCK_SIZE,
+                  "MMR: the children of a node must fill a block");
+    static_assert(sizeof(Digest) == Hash::DIGEST_SIZE);
+
+    /*
+    Inclusion of the leaf at index in the MMR of leaves_n leaves.
+    Siblings go from the leaf up to its peak, ARITY - 1 per level in child order like
+    MTree::paths, peaks are the other peaks from left to right.
+    */
+    struct InclusionProof
+    {
+        size_t index;
+        size_t leaves_n;
+        std::vector<Digest> siblings;
+        std::vector<Digest> peaks;
+    };
+
+    /*
+    The MMR of old_leaves_n leaves is a prefix of the one of new_leaves_n leaves.
+    Holds the old peaks and the largest aligned subtrees covering the new leaves, left to right,
+    so the new peaks are rebuilt from the old ones.
+    */
+    struct ConsistencyProof
+    {
+        size_t old_leaves_n;
+        size_t new_leaves_n;
+        std::vector<Digest> old_peaks;
+        std::vector<Digest> nodes;
+    };
+
+private:
+    static constexpr size_t HEADER_SIZE = 32;
+    // Nodes buffered before one write to the node file
+    static constexpr size_t WRITE_BATCH = 4096;
+    static constexpr char MAGIC[8] = {'M', 'M', 'R', 'N', 'O', 'D', 'E', 'S'};
+
+    struct Header
+    {
+        char magic[8];
+        // hash_id<Hash>()
+        uint8_t hash_id[8];
+        uint64_t arity;
+        uint64_t digest_size;
+    };
+
+    static_assert(sizeof(Header) == HEADER_SIZE);
+
+    struct Peak
+    {
+        Digest digest;
+        size_t height;
+    };
+
+    // First leaf and height of a perfect subtree
+    using Range = std::pair<size_t, size_t>;
+
+    std::vector<Peak> peaks{};
+    size_t leaves_n = 0;
+    size_t nodes_n = 0;
+    size_t flushed_n = 0;
+
+    // Every node in memory, or the ones not written yet to the node file
+    std::vector<Digest> nodes{};
+    int fd = -1;
+    bool good = true;
+
+public:
+    MMR() = default;
+
+    // Opens the node file, creating it if it does not exist
+    explicit MMR(const std::string &path)
+    {
+        Header expected{};
+
+        memcpy(expected.magic, MAGIC, sizeof(MAGIC));
+        expected.arity = ARITY;
+        expected.digest_size = Hash::DIGEST_SIZE;
+
+        memcpy(expected.hash_id, hash_id<Hash>().data(), sizeof(expected.hash_id));
+
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        if (fd < 0)
+        {
+            std::cerr << "MMR: Cannot open " << path << '\n';
+            good = false;
+            return;
+        }
+
+        struct stat st;
+        Header header;
+
+        if (::fstat(fd, &st) != 0)
+        {
+            std::cerr << "MMR: Cannot open " << path << '\n';
+            close();
+            return;
+        }
+
+        if (st.st_size == 0)
+        {
+            if (::write(fd, &expected, HEADER_SIZE) != (ssize_t)HEADER_SIZE)
+            {
+                std::cerr << "MMR: Cannot write " << path << '\n';
+                close();
+            }
+            return;
+        }
+
+        if ((size_t)st.st_size < HEADER_SIZE ||
+            ::pread(fd, &header, HEADER_SIZE, 0) != (ssize_t)HEADER_SIZE ||
+            memcmp(&header, &expected, HEADER_SIZE) != 0)
+        {
+            std::cerr << "MMR: " << path << " holds a different MMR\n";
+            close();
+            return;
+        }
+
+        // drop a digest cut short by a crash
+        nodes_n = (st.st_size - HEADER_SIZE) / Hash::DIGEST_SIZE;
+        if (::ftruncate(fd, HEADER_SIZE + nodes_n * Hash::DIGEST_SIZE) != 0)
+        {
+            std::cerr << "MMR: Cannot resize " << path << '\n';
+            close();
+            return;
+        }
+
+        flushed_n = nodes_n;
+        load_peaks();
+    }
+
+    MMR(const MMR &) = delete;
+    MMR &operator=(const MMR &) = delete;
+
+    ~MMR() { close(); }
+
+    bool is_open() const { return good; }
+
+    size_t size() const { return leaves_n; }
+
+    void append(const Digest &leaf)
+    {
+        if (!good)
+            return;
+
+        write_node(leaf);
+        peaks.push_back({leaf, 0});
+        ++leaves_n;
+
+        merge_peaks();
+    }
+
+    void append(const Digest *leaves, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+            append(leaves[i]);
+    }
+
+    // Writes the buffered nodes and flushes the node file to disk
+    void sync()
+    {
+        if (fd >= 0 && flush())
+            ::fsync(fd);
+    }
+
+    Digest digest() const
+    {
+        std::vector<Digest> digests;
+
+        for (const Peak &p : peaks)
+            digests.push_back(p.digest);
+
+        return bag(digests);
+    }
+
+    InclusionProof prove_inclusion(size_t index) const
+    {
+        if (index >= leaves_n)
+        {
+            std::cerr << "MMR: Bad leaf index\n";
+            return {};
+        }
+
+        InclusionProof proof{index, leaves_n, {}, {}};
+
+        for (auto [first, h] : peak_ranges(leaves_n))
+        {
+            if (index < first || index >= first + pow(ARITY, h))
+            {
+                proof.peaks.push_back(read_node(node_pos(first, h)));
+                continue;
+            }
+
+            for (size_t l = 0; l < h; ++l)
+            {
+                size_t width = pow(ARITY, l);
+                size_t group = index / (width * ARITY) * (width * ARITY);
+
+                for (size_t s = group; s < group + width * ARITY; s += width)
+                    if (s != index / width * width)
+                        proof.siblings.push_back(read_node(node_pos(s, l)));
+            }
+        }
+
+        return proof;
+    }
+
+    static bool verify_inclusion(const Digest &root, const Digest &leaf,
+                                 const InclusionProof &proof)
+    {
+        if (proof.index >= proof.leaves_n)
+            return false;
+
+        std::vector<Range> ranges = peak_ranges(proof.leaves_n);
+        std::vector<Digest> digests;
+        auto other = proof.peaks.begin();
+
+        if (proof.peaks.size() + 1 != ranges.size())
+            return false;
+
+        for (auto [first, h] : ranges)
+        {
+            if (proof.index < first || proof.index >= first + pow(ARITY, h))
+            {
+                digests.push_back(*other++);
+                continue;
+            }
+
+            if (proof.siblings.size() != h * (ARITY - 1))
+                return false;
+
+            Digest digest = leaf;
+            const Digest *s = proof.siblings.data();
+
+            // put the path node between its siblings, level by level
+            for (size_t l = 0, pos = proof.index; l < h; ++l, pos /= ARITY, s += ARITY - 1)
+            {
+                uint8_t block[Hash::BLOCK_SIZE];
+                size_t k = pos % ARITY;
+
+                memcpy(block, s, k * Hash::DIGEST_SIZE);
+                memcpy(block + k * Hash::DIGEST_SIZE, digest.data(), Hash::DIGEST_SIZE);
+                memcpy(block + (k + 1) * Hash::DIGEST_SIZE, s + k,
+                       (ARITY - 1 - k) * Hash::DIGEST_SIZE);
+
+                Hash::hash_oneblock(digest.data(), block);
+            }
+
+            digests.push_back(digest);
+        }
+
+        return bag(digests) == root;
+    }
+
+    ConsistencyProof prove_consistency(size_t old_leaves_n) const
+    {
+        if (old_leaves_n > leaves_n)
+        {
+            std::cerr << "MMR: Bad size of old MMR\n";
+            return {};
+        }
+
+        ConsistencyProof proof{old_leaves_n, leaves_n, {}, {}};
+
+        for (auto [first, h] : peak_ranges(old_leaves_n))
+            proof.old_peaks.push_back(read_node(node_pos(first, h)));
+
+        for (auto [first, h] : new_ranges(old_leaves_n, leaves_n))
+            proof.nodes.push_back(read_node(node_pos(first, h)));
+
+        return proof;
+    }
+
+    static bool verify_consistency(const Digest &old_root, const Digest &new_root,
+                                   const ConsistencyProof &proof)
+    {
+        if (proof.old_leaves_n > proof.new_leaves_n)
+            return false;
+
+        std::vector<Range> old_ranges = peak_ranges(proof.old_leaves_n);
+        std::vector<Range> ranges = new_ranges(proof.old_leaves_n, proof.new_leaves_n);
+
+        if (proof.old_peaks.size() != old_ranges.size() || proof.nodes.size() != ranges.size() ||
+            bag(proof.old_peaks) != old_root)
+            return false;
+
+        // replay the appends with whole subtrees instead of leaves
+        std::vector<Peak> stack;
+
+        for (size_t i = 0; i < old_ranges.size(); ++i)
+            stack.push_back({proof.old_peaks[i], old_ranges[i].second});
+
+        for (size_t i = 0; i < ranges.size(); ++i)
+        {
+            stack.push_back({proof.nodes[i], ranges[i].second});
+            merge(stack, [](const Digest &) {});
+        }
+
+        std::vector<Range> new_peaks = peak_ranges(proof.new_leaves_n);
+        std::vector<Digest> digests;
+
+        if (stack.size() != new_peaks.size())
+            return false;
+
+        for (size_t i = 0; i < stack.size(); ++i)
+        {
+            if (stack[i].height != new_peaks[i].second)
+                return false;
+
+            digests.push_back(stack[i].digest);
+        }
+
+        return bag(digests) == new_root;
+    }
+
+private:
+    // Nodes of a perfect subtree of height h
+    static size_t subtree_nodes(size_t h)
+    {
+        return pow_sum(ARITY, (size_t)0, h + 1);
+    }
+
+    // Nodes of the MMR of n leaves, position of the next leaf
+    static size_t nodes_before(size_t n)
+    {
+        size_t count = 0;
+
+        for (size_t h = 0; n > 0; ++h, n /= ARITY)
+            count += n % ARITY * subtree_nodes(h);
+
+        return count;
+    }
+
+    // Post-order position of the subtree of height h from leaf first, the merges of its last leaf
+    static size_t node_pos(size_t first, size_t h)
+    {
+        return nodes_before(first + pow(ARITY, h) - 1) + h;
+    }
+
+    static std::vector<Range> peak_ranges(size_t n)
+    {
+        std::vector<Range> ranges;
+        size_t h = 0;
+        size_t first = 0;
+
+        while (n / ARITY >= pow(ARITY, h))
+            ++h;
+
+        for (++h; h-- > 0;)
+            for (size_t d = n / pow(ARITY, h) % ARITY; d > 0; --d, first += pow(ARITY, h))
+                ranges.push_back({first, h});
+
+        return ranges;
+    }
+
+    // Largest aligned subtrees covering leaves [old_n, new_n) inside the peaks of new_n leaves
+    static std::vector<Range> new_ranges(size_t old_n, size_t new_n)
+    {
+        std::vector<Range> ranges;
+
+        for (auto [first, h] : peak_ranges(new_n))
+        {
+            size_t end = first + pow(ARITY, h);
+
+            for (size_t p = std::max(first, old_n); p < end;)
+            {
+                size_t s = 0;
+
+                while (p % pow(ARITY, s + 1) == 0 && p + pow(ARITY, s + 1) <= end)
+                    ++s;
+
+                ranges.push_back({p, s});
+                p += pow(ARITY, s);
+            }
+        }
+
+        return ranges;
+    }
+
+    static Digest bag(const std::vector<Digest> &digests)
+    {
+        Digest acc{};
+
+        if (digests.empty())
+            return acc;
+
+        acc = digests.back();
+        for (size_t i = digests.size() - 1; i-- > 0;)
+        {
+            uint8_t pair[2 * Hash::DIGEST_SIZE];
+
+            memcpy(pair, digests[i].data(), Hash::DIGEST_SIZE);
+            memcpy(pair + Hash::DIGEST_SIZE, acc.data(), Hash::DIGEST_SIZE);
+            fixed_mtree_hash_pairs<Hash>(acc.data(), pair, 1);
+        }
+
+        return acc;
+    }
+
+    // Merges the last ARITY peaks while they have the same height, out gets every new node
+    template<typename Out>
+    static void merge(std::vector<Peak> &stack, const Out &out)
+    {
+        while (stack.size() >= ARITY)
+        {
+            size_t base = stack.size() - ARITY;
+            uint8_t block[Hash::BLOCK_SIZE];
+            Peak parent{{}, stack.back().height + 1};
+
+            for (size_t k = 0; k < ARITY; ++k)
+            {
+                if (stack[base + k].height != stack.back().height)
+                    return;
+
+                memcpy(block + k * Hash::DIGEST_SIZE, stack[base + k].digest.data(),
+                       Hash::DIGEST_SIZE);
+            }
+
+            Hash::hash_oneblock(parent.digest.data(), block);
+            stack.resize(base);
+            stack.push_back(parent);
+            out(parent.digest);
+        }
+    }
+
+    void merge_peaks()
+    {
+        merge(peaks, [this](const Digest &d) { write_node(d); });
+    }
+
+    // Rebuilds the peaks from the node count, then finishes merges a crash interrupted
+    void load_peaks()
+    {
+        size_t h = 0;
+        size_t pos = 0;
+
+        while (subtree_nodes(h + 1) <= nodes_n)
+            ++h;
+
+        for (++h; h-- > 0;)
+            while (nodes_n - pos >= subtree_nodes(h))
+            {
+                pos += subtree_nodes(h);
+                peaks.push_back({read_node(pos - 1), h});
+                leaves_n += pow(ARITY, h);
+            }
+
+        merge_peaks();
+    }
+
+    void write_node(const Digest &d)
+    {
+        nodes.push_back(d);
+        ++nodes_n;
+
+        if (fd >= 0 && nodes.size() >= WRITE_BATCH)
+            flush();
+    }
+
+    bool flush()
+    {
+        ssize_t size = nodes.size() * Hash::DIGEST_SIZE;
+
+        if (fd < 0 || nodes.empty())
+            return true;
+
+        if (::write(fd, nodes.data(), size) != size)
+        {
+            std::cerr << "MMR: Cannot append nodes\n";
+            good = false;
+            return false;
+        }
+
+        flushed_n += nodes.size();
+        nodes.clear();
+
+        return true;
+    }
+
+    Digest read_node(size_t pos) const
+    {
+        Digest d{};
+
+        if (fd < 0)
+            d = nodes[pos];
+        else if (pos >= flushed_n)
+            d = nodes[pos - flushed_n];
+        else if (::pread(fd, d.data(), Hash::DIGEST_SIZE, HEADER_SIZE + pos * Hash::DIGEST_SIZE) !=
+                 (ssize_t)Hash::DIGEST_SIZE)
+            std::cerr << "MMR: Cannot read node\n";
+
+        return d;
+    }
+
+    void close()
+    {
+        if (fd >= 0 && good)
+            flush();
+        if (fd >= 0)
+            ::close(fd);
+
+        fd = -1;
+        good = false;
+    }
+};
@@ -1,168 +1,509 @@
 #pragma once
 
+#include "hash/batch.hpp"
+#include "tree/path_update.hpp"
+#include "tree/path_verify.hpp"
+#include "tree/subtree_build.hpp"
+#include "tree/tree_cursor.hpp"
 #include "util/const_math.hpp"
 #include "util/string_utils.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cstring>
 #include <iostream>
 #include <omp.h>
+#include <utility>
 #include <vector>
 
 #if __cplusplus >= 202002L
     #include <ranges>
 #endif
 
-template<typename Hash>
-class MTreeNode
+/*
+Merkle tree over 1 to LEAVES_N input blocks, one leaf per block.
+With fewer than LEAVES_N leaves level l keeps ceil(leaves_n / ARITY^l) nodes, and only the last
+node of a level may have fewer than ARITY children. Its missing children are hashed as zero
+digests, so a complete tree is unchanged and the circuit hashes every level the same way. The
+root does not bind the number of leaves, applications that need it commit to it separately.
+*/
+template<size_t height, typename Hash>
+class MTree
 {
 public:
+    using Node = TreeCursor<MTree>;
+    using Digest = std::array<uint8_t, Hash::DIGEST_SIZE>;
+    // New digest of the leaf at the given index
+    using LeafUpdate = std::pair<size_t, Digest>;
+    // Leaves [first, last)
+    using LeafRange = std::pair<size_t, size_t>;
+
     static constexpr size_t ARITY = Hash::BLOCK_SIZE / Hash::DIGEST_SIZE;
+    static constexpr size_t LEAVES_N = pow(ARITY, height - 1);
+    static constexpr size_t NODES_N = pow_sum(ARITY, (size_t)0, height);
+    static constexpr size_t INPUT_SIZE = LEAVES_N * Hash::BLOCK_SIZE;
+    static constexpr size_t LANES_N = hash_lanes_v<Hash>;
+    // Siblings on the path of one leaf, ARITY - 1 per level below the root
+    static constexpr size_t PATH_N = (ARITY - 1) * (height - 1);
+
+    /*
+    Proof for several leaves at once. Indices are sorted and unique. A sibling is stored only if
+    it cannot be computed from the proven leaves and exists in a tree of leaves_n leaves, level
+    by level from the leaves and in increasing position within a level.
+    */
+    struct MultiProof
+    {
+        size_t leaves_n;
+        std::vector<size_t> indices;
+        std::vector<Digest> siblings;
+    };
+
+    static_assert(ARITY * Hash::DIGEST_SIZE == Hash::BLOCK_SIZE,
+                  "MTree: the children of a node must fill a block");
+    static_assert(sizeof(Digest) == Hash::DIGEST_SIZE);
 
 private:
-    std::array<uint8_t, Hash::DIGEST_SIZE> digest;
-    MTreeNode *f;
-    std::array<MTreeNode *, ARITY> c;
-    size_t depth;
+    size_t leaves_n = 0;
 
-    template<size_t, typename>
-    friend class MTree;
+    /*
+    Only digests are stored, level by level from the leaves to the root.
+    Level l starts at level_offset[l], the children of node p of level l are the nodes from
+    p * ARITY of level l - 1. They are contiguous, so a level is hashed straight from the one
+    below it but for a last node with missing children.
+    */
+    std::array<size_t, height + 1> level_offset{};
+    std::vector<Digest> nodes{};
 
-    template<size_t, typename>
-    friend class MTreePath;
+    friend Node;
 
 public:
-    MTreeNode() = default;
+    MTree() = default;
+#if __cplusplus >= 202002L
+    template<std::ranges::range Range>
+    MTree(const Range &range) :
+        MTree(std::ranges::cdata(range),
+              std::ranges::size(range) * sizeof(*std::ranges::cdata(range)))
+    {}
+#endif
+
+    template<typename Iter>
+    MTree(const Iter begin, const Iter end) :
+        MTree(&*begin, std::distance(begin, end) * sizeof(*begin))
+    {}
 
-    MTreeNode(const void *digest, size_t depth) : f{nullptr}, c{}, depth{depth}
+    // sz is a multiple of the block size, up to INPUT_SIZE
+    MTree(const void *vdata, size_t sz)
     {
-        memcpy(this->digest.data(), digest, Hash::DIGEST_SIZE);
+        if (sz % Hash::BLOCK_SIZE != 0 || sz == 0 || sz > INPUT_SIZE)
+        {
+            std::cerr << "MTree: Bad size of input data\n";
+            resize(LEAVES_N);
+            return;
+        }
+
+        const uint8_t *data = (const uint8_t *)vdata;
+
+        resize(sz / Hash::BLOCK_SIZE);
+
+        // the children of n consecutive parents are n consecutive blocks
+        build_subtrees<ARITY>(
+            height,
+            [this, data](size_t first, size_t n)
+            {
+                hash_oneblock_many<Hash>(this->nodes[first].data(),
+                                         data + first * Hash::BLOCK_SIZE, n);
+            },
+            [this](size_t l, size_t first, size_t n) { hash_parents(l, first, n); },
+            SUBTREE_LEAVES_MAX, leaves_n);
     }
 
-    MTreeNode(const std::array<const void *, ARITY> &data, size_t depth) :
-        f{nullptr}, c{}, depth{depth}
+    // Number of leaves
+    size_t size() const
     {
-        std::array<uint8_t, Hash::BLOCK_SIZE> block;
-
-        for (size_t i = 0; i < ARITY; ++i)
-            memcpy(block.data() + i * Hash::DIGEST_SIZE, data[i], Hash::DIGEST_SIZE);
+        return leaves_n;
+    }
 
-        Hash::hash_oneblock(this->digest.data(), block.data());
+#if __cplusplus >= 202002L
+    template<std::ranges::range Range>
+    void update_leaves(const Range &range)
+    {
+        update_leaves(std::ranges::cdata(range), std::ranges::size(range));
     }
+#endif
 
-    const auto &get_digest() const { return digest; }
-    const MTreeNode *get_f() const { return f; }
-    const MTreeNode *get_c(size_t i) const { return c[i]; }
+    template<typename Iter>
+    void update_leaves(const Iter begin, const Iter end)
+    {
+        update_leaves(&*begin, std::distance(begin, end));
+    }
 
-    friend std::ostream &operator<<(std::ostream &os, const MTreeNode &node)
+    // Sets leaf digests and recomputes their ancestors, the last update of a leaf wins
+    void update_leaves(const LeafUpdate *updates, size_t n)
     {
-        for (size_t i = 0; i < node.depth; ++i)
-            os << "    ";
+        std::vector<size_t> dirty(n);
 
-        os << "*: " << hexdump(node.digest, false, 64) << '\n';
+        for (size_t i = 0; i < n; ++i)
+            if (updates[i].first >= leaves_n)
+            {
+                std::cerr << "MTree: Bad leaf index\n";
+                return;
+            }
 
-        for (size_t i = 0; i < ARITY; ++i)
-            if (node.c[i] != nullptr)
-                os << *node.c[i];
+        for (size_t i = 0; i < n; ++i)
+        {
+            this->nodes[updates[i].first] = updates[i].second;
+            dirty[i] = updates[i].first;
+        }
 
-        return os;
+        update_paths<ARITY>(
+            height, std::move(dirty),
+            [this](size_t l, const size_t *pos, size_t count)
+            {
+                // gather the children of LANES_N dirty parents at a time
+                for (size_t j = 0; j < count; j += LANES_N)
+                {
+                    std::array<uint8_t, LANES_N * Hash::BLOCK_SIZE> blocks{};
+                    std::array<uint8_t, LANES_N * Hash::DIGEST_SIZE> digests;
+                    size_t m = std::min(LANES_N, count - j);
+
+                    for (size_t k = 0; k < m; ++k)
+                    {
+                        size_t children = std::min(ARITY, width(l - 1) - pos[j + k] * ARITY);
+
+                        memcpy(blocks.data() + k * Hash::BLOCK_SIZE,
+                               this->nodes[level_offset[l - 1] + pos[j + k] * ARITY].data(),
+                               children * Hash::DIGEST_SIZE);
+                        memset(blocks.data() + k * Hash::BLOCK_SIZE + children * Hash::DIGEST_SIZE,
+                               0, (ARITY - children) * Hash::DIGEST_SIZE);
+                    }
+
+                    hash_oneblock_many<Hash>(digests.data(), blocks.data(), m);
+
+                    for (size_t k = 0; k < m; ++k)
+                        memcpy(this->nodes[level_offset[l] + pos[j + k]].data(),
+                               digests.data() + k * Hash::DIGEST_SIZE, Hash::DIGEST_SIZE);
+                }
+            });
     }
-};
 
-template<size_t height, typename Hash>
-class MTree
-{
-public:
-    using Node = MTreeNode<Hash>;
+#if __cplusplus >= 202002L
+    template<std::ranges::range Range>
+    std::vector<Digest> paths(const Range &range) const
+    {
+        return paths(std::ranges::cdata(range), std::ranges::size(range));
+    }
+#endif
 
-    static constexpr size_t ARITY = Hash::BLOCK_SIZE / Hash::DIGEST_SIZE;
-    static constexpr size_t LEAVES_N = pow(ARITY, height - 1);
-    static constexpr size_t NODES_N = pow_sum(ARITY, (size_t)0, height);
-    static constexpr size_t INPUT_SIZE = LEAVES_N * Hash::BLOCK_SIZE;
+    template<typename Iter>
+    std::vector<Digest> paths(const Iter begin, const Iter end) const
+    {
+        return paths(&*begin, std::distance(begin, end));
+    }
 
-private:
-    std::vector<Node> nodes{};
-    Node *root = nullptr;
+    /*
+    Paths of the leaves at the given indices, PATH_N digests per leaf one after the other.
+    A path goes from the leaf level up, with the siblings of a level in child order. Missing
+    children of the last node of a level are zero digests.
+    */
+    std::vector<Digest> paths(const size_t *indices, size_t n) const
+    {
+        for (size_t i = 0; i < n; ++i)
+            if (indices[i] >= leaves_n)
+            {
+                std::cerr << "MTree: Bad leaf index\n";
+                return {};
+            }
+
+        std::vector<Digest> out(n * PATH_N);
+
+        // the siblings of a level are contiguous, one copy on each side of the path node
+#pragma omp parallel for if (n >= 1024)
+        for (size_t i = 0; i < n; ++i)
+        {
+            Digest *dst = out.data() + i * PATH_N;
+
+            for (size_t l = 0, p = indices[i]; l + 1 < height; ++l, p /= ARITY)
+            {
+                const size_t first = p / ARITY * ARITY;
+                const size_t last = std::min(first + ARITY, width(l));
+                const Digest *group = this->nodes.data() + level_offset[l];
+
+                dst = std::copy(group + first, group + p, dst);
+                dst = std::copy(group + p + 1, group + last, dst);
+                dst += first + ARITY - last;
+            }
+        }
+
+        return out;
+    }
 
-public:
-    MTree() = default;
 #if __cplusplus >= 202002L
     template<std::ranges::range Range>
-    MTree(const Range &range) :
-        MTree(std::ranges::cdata(range),
-              std::ranges::size(range) * sizeof(*std::ranges::cdata(range)))
-    {}
+    MultiProof multiproof(const Range &range) const
+    {
+        return multiproof(std::ranges::cdata(range), std::ranges::size(range));
+    }
 #endif
 
     template<typename Iter>
-    MTree(const Iter begin, const Iter end) :
-        MTree(&*begin, std::distance(begin, end) * sizeof(*begin))
-    {}
+    MultiProof multiproof(const Iter begin, const Iter end) const
+    {
+        return multiproof(&*begin, std::distance(begin, end));
+    }
 
-    MTree(const void *vdata, size_t sz) : nodes(NODES_N), root{&nodes.back()}
+    // Proof of the leaves at the given indices, siblings shared by several paths are stored once
+    MultiProof multiproof(const size_t *indices, size_t n) const
     {
-        if (sz != INPUT_SIZE)
+        MultiProof proof{leaves_n, {indices, indices + n}, {}};
+
+        std::sort(proof.indices.begin(), proof.indices.end());
+        proof.indices.erase(std::unique(proof.indices.begin(), proof.indices.end()),
+                            proof.indices.end());
+
+        if (!proof.indices.empty() && proof.indices.back() >= leaves_n)
         {
-            std::cerr << "MTree: Bad size of input data\n";
-            return;
+            std::cerr << "MTree: Bad leaf index\n";
+            return {};
         }
 
-        const uint8_t *data = (const uint8_t *)vdata;
-        size_t depth = height - 1;
+        std::vector<size_t> known = proof.indices;
 
-#pragma omp parallel for
-        // add leaves
-        for (size_t i = 0; i < LEAVES_N; ++i)
+        for (size_t l = 0; l + 1 < height; ++l)
         {
-            std::array<const void *, ARITY> children;
+            size_t parents = 0;
+
+            for (size_t i = 0; i < known.size(); ++parents)
+            {
+                size_t first = known[i] / ARITY * ARITY;
+
+                for (size_t p = first; p < std::min(first + ARITY, width(l)); ++p)
+                {
+                    if (i < known.size() && known[i] == p)
+                        ++i;
+                    else
+                        proof.siblings.push_back(this->nodes[level_offset[l] + p]);
+                }
 
-            for (size_t j = 0; j < ARITY; ++j)
-                children[j] = data + i * Hash::BLOCK_SIZE + j * Hash::DIGEST_SIZE;
-            this->nodes[i] = Node{children, depth};
+                known[parents] = first / ARITY;
+            }
+
+            known.resize(parents);
         }
 
-        // build tree bottom-up
-        for (size_t i = 0, last = LEAVES_N, len = LEAVES_N; depth > 0; len += pow(ARITY, depth))
-        {
-            size_t iters = (len - i) / ARITY;
-            --depth;
-#pragma omp parallel for
-            for (size_t j = 0; j < iters; ++j)
-            {
-                std::array<const void *, ARITY> children;
+        return proof;
+    }
 
-                for (size_t k = 0; k < ARITY; ++k)
-                    children[k] = this->nodes[i + j * ARITY + k].digest.data();
+    /*
+    Checks a multiproof against a root digest, leaves[i] is the leaf at proof.indices[i].
+    The parents of a level are hashed together, every sibling of the proof must be used.
+    */
+    static bool verify_multiproof(const uint8_t *root, const MultiProof &proof,
+                                  const Digest *leaves)
+    {
+        const std::vector<size_t> &indices = proof.indices;
+
+        if (indices.empty() || proof.leaves_n == 0 || proof.leaves_n > LEAVES_N)
+            return false;
+
+        for (size_t i = 0; i < indices.size(); ++i)
+            if (indices[i] >= proof.leaves_n || (i > 0 && indices[i] <= indices[i - 1]))
+                return false;
+
+        std::vector<size_t> known = indices;
+        std::vector<Digest> digests(leaves, leaves + indices.size());
+        std::vector<uint8_t> blocks;
+        size_t s = 0;
 
-                this->nodes[last + j] = Node{children, depth};
+        for (size_t l = 0; l + 1 < height; ++l)
+        {
+            const size_t level_width = width(proof.leaves_n, l);
+            size_t parents = 0;
+
+            blocks.clear();
+            for (size_t i = 0; i < known.size(); ++parents)
+            {
+                size_t first = known[i] / ARITY * ARITY;
 
-                for (size_t k = 0; k < ARITY; ++k)
+                for (size_t p = first; p < first + ARITY; ++p)
                 {
-                    this->nodes[last + j].c[k] = &this->nodes[i + j * ARITY + k];
-                    this->nodes[i + j * ARITY + k].f = &this->nodes[last + j];
+                    const Digest zero{};
+                    const Digest *child;
+
+                    if (p >= level_width)
+                        child = &zero;
+                    else if (i < known.size() && known[i] == p)
+                        child = &digests[i++];
+                    else if (s < proof.siblings.size())
+                        child = &proof.siblings[s++];
+                    else
+                        return false;
+
+                    blocks.insert(blocks.end(), child->begin(), child->end());
                 }
+
+                known[parents] = first / ARITY;
             }
-            last += iters;
-            i += iters * ARITY;
+
+            known.resize(parents);
+            digests.resize(parents);
+            hash_oneblock_many<Hash>(digests[0].data(), blocks.data(), parents);
         }
+
+        return s == proof.siblings.size() &&
+               memcmp(digests[0].data(), root, Hash::DIGEST_SIZE) == 0;
     }
 
     const uint8_t *digest() const
     {
-        return root->digest.data();
+        return nodes.back().data();
     }
 
-    const Node *get_node(size_t i) const
+    // Digest of node p of level l, nullptr past the end of the level
+    const uint8_t *digest(size_t l, size_t p) const
     {
-        return &nodes[i];
+        if (l >= height || leaves_n == 0 || p >= width(l))
+            return nullptr;
+
+        return this->nodes[level_offset[l] + p].data();
+    }
+
+    /*
+    Leaf ranges where the two trees differ, sorted. Starts at the roots and only goes down into
+    the subtrees whose digests differ, O(k log n) comparisons for k changed leaves. Trees of
+    different sizes differ on every leaf.
+    */
+    std::vector<LeafRange> diff(const MTree &other) const
+    {
+        if (leaves_n != other.leaves_n)
+            return {{0, std::max(leaves_n, other.leaves_n)}};
+
+        std::vector<size_t> differ;
+        std::vector<LeafRange> ranges;
+
+        if (leaves_n > 0 && nodes.back() != other.nodes.back())
+            differ.push_back(0);
+
+        for (size_t l = height - 1; l-- > 0 && !differ.empty();)
+        {
+            std::vector<size_t> below;
+
+            for (size_t p : differ)
+                for (size_t c = p * ARITY; c < std::min(p * ARITY + ARITY, width(l)); ++c)
+                    if (this->nodes[level_offset[l] + c] != other.nodes[level_offset[l] + c])
+                        below.push_back(c);
+
+            differ = std::move(below);
+        }
+
+        for (size_t leaf : differ)
+            if (!ranges.empty() && ranges.back().second == leaf)
+                ++ranges.back().second;
+            else
+                ranges.emplace_back(leaf, leaf + 1);
+
+        return ranges;
+    }
+
+    Node get_node(size_t i) const
+    {
+        return {this, i};
     }
 
     friend std::ostream &operator<<(std::ostream &os, const MTree &tree)
     {
-        if (!tree.root)
+        if (tree.nodes.empty())
             return os << "*:";
 
-        return os << *tree.root;
+        return os << tree.get_node(tree.nodes.size() - 1);
+    }
+
+private:
+    // Nodes of level l in a tree of leaves_n leaves
+    static size_t width(size_t leaves_n, size_t l)
+    {
+        return (leaves_n - 1) / pow(ARITY, l) + 1;
+    }
+
+    size_t width(size_t l) const
+    {
+        return width(leaves_n, l);
+    }
+
+    void resize(size_t n)
+    {
+        leaves_n = n;
+
+        for (size_t l = 0; l < height; ++l)
+            level_offset[l + 1] = level_offset[l] + width(l);
+
+        nodes.assign(level_offset[height], Digest{});
+    }
+
+    // Nodes [first, first + n) of level l, only the last node of a level may miss children
+    void hash_parents(size_t l, size_t first, size_t n)
+    {
+        const size_t children = width(l - 1) - first * ARITY;
+        const size_t full = std::min(n, children / ARITY);
+        const Digest *below = this->nodes.data() + level_offset[l - 1] + first * ARITY;
+
+        hash_oneblock_many<Hash>(this->nodes[level_offset[l] + first].data(), below->data(),
+                                 full);
+
+        if (full < n)
+        {
+            std::array<Digest, ARITY> block{};
+
+            std::copy(below + full * ARITY, below + children, block.begin());
+            Hash::hash_oneblock(this->nodes[level_offset[l] + first + full].data(),
+                                block[0].data());
+        }
+    }
+
+    size_t level_of(size_t i) const
+    {
+        size_t l = 0;
+
+        while (i >= level_offset[l + 1])
+            ++l;
+
+        return l;
+    }
+
+    const Digest &digest_of(size_t i) const { return nodes[i]; }
+
+    size_t parent_of(size_t i) const
+    {
+        size_t l = level_of(i);
+
+        if (l + 1 == height)
+            return Node::NONE;
+
+        return level_offset[l + 1] + (i - level_offset[l]) / ARITY;
+    }
+
+    size_t child_of(size_t i, size_t k) const
+    {
+        size_t l = level_of(i);
+
+        if (l == 0)
+            return Node::NONE;
+
+        size_t p = (i - level_offset[l]) * ARITY + k;
+
+        return p < width(l - 1) ? level_offset[l - 1] + p : Node::NONE;
+    }
+
+    void print(std::ostream &os, size_t i) const
+    {
+        size_t l = level_of(i);
+
+        for (size_t d = l + 1; d < height; ++d)
+            os << "    ";
+
+        os << "*: " << hexdump(nodes[i], false, 64) << '\n';
+
+        for (size_t k = 0; l > 0 && k < ARITY && child_of(i, k) != Node::NONE; ++k)
+            print(os, child_of(i, k));
     }
 };
 
@@ -171,16 +512,27 @@ template<size_t height, typename Hash>
 class MTreePath
 {
 public:
-    using Node = MTreeNode<Hash>;
+    using Node = TreeCursor<MTreePath>;
+    using Digest = std::array<uint8_t, Hash::DIGEST_SIZE>;
 
     static constexpr size_t ARITY = Hash::BLOCK_SIZE / Hash::DIGEST_SIZE;
     static constexpr size_t NODES_N = ARITY * (height - 1) + 1;
     static constexpr size_t INPUT_N = NODES_N - (height - 1);
     static constexpr size_t INPUT_SIZE = INPUT_N * Hash::DIGEST_SIZE;
+    static constexpr size_t LANES_N = hash_lanes_v<Hash>;
+
+    static_assert(ARITY * Hash::DIGEST_SIZE == Hash::BLOCK_SIZE,
+                  "MTreePath: the children of a node must fill a block");
+    static_assert(sizeof(Digest) == Hash::DIGEST_SIZE);
 
 private:
-    std::vector<Node> nodes{};
-    Node *root = nullptr;
+    /*
+    Level l takes the ARITY nodes from l * ARITY, the first one is on the path and is the parent
+    of the whole level below. The root is alone on the last level.
+    */
+    std::vector<Digest> nodes{};
+
+    friend Node;
 
 public:
     MTreePath() = default;
@@ -197,7 +549,7 @@ public:
         MTreePath(&*begin, std::distance(begin, end) * sizeof(*begin))
     {}
 
-    MTreePath(const void *vdata, size_t sz) : nodes(NODES_N), root{&nodes.back()}
+    MTreePath(const void *vdata, size_t sz) : nodes(NODES_N)
     {
         if (sz != INPUT_SIZE)
         {
@@ -206,50 +558,108 @@ public:
         }
 
         const uint8_t *data = (const uint8_t *)vdata;
-        size_t depth = height - 1;
 
         // bootstrap first node of the path
-        this->nodes[0] = {data, depth};
+        memcpy(this->nodes[0].data(), data, Hash::DIGEST_SIZE);
 
         // build tree bottom-up
         for (size_t i = 1; i < height; ++i)
         {
-            std::array<const void *, ARITY> children;
-
             // insert remaining children
             for (size_t j = 1; j < ARITY; ++j)
-                this->nodes[(i - 1) * ARITY + j] = {data += Hash::DIGEST_SIZE, depth};
-
-            // collect children
-            for (size_t j = 0; j < ARITY; ++j)
-                children[j] = this->nodes[(i - 1) * ARITY + j].digest.data();
+                memcpy(this->nodes[(i - 1) * ARITY + j].data(), data += Hash::DIGEST_SIZE,
+                       Hash::DIGEST_SIZE);
 
-            --depth;
-            // create node and link children
-            this->nodes[i * ARITY] = {children, depth};
-            for (size_t j = 0; j < ARITY; ++j)
-            {
-                this->nodes[i * ARITY].c[j] = &this->nodes[(i - 1) * ARITY + j];
-                this->nodes[(i - 1) * ARITY + j].f = &this->nodes[i * ARITY];
-            }
+            // the children are already laid out as a block
+            Hash::hash_oneblock(this->nodes[i * ARITY].data(), this->nodes[(i - 1) * ARITY].data());
         }
     }
 
+    // Checks the path of the leaf at idx against a root, siblings laid out as in MTree::paths
+    static bool verify_path(const uint8_t *root, const Digest &leaf, size_t idx,
+                            const Digest *siblings)
+    {
+        bool valid;
+
+        verify_paths_lanes<ARITY, Hash::DIGEST_SIZE, 1>(&valid, height - 1, root, leaf.data(),
+                                                        &idx, (const uint8_t *)siblings, 1,
+                                                        hash_children);
+
+        return valid;
+    }
+
+    // Same for a tree of leaves_n leaves, the index must be one of its leaves
+    static bool verify_path(const uint8_t *root, const Digest &leaf, size_t idx,
+                            const Digest *siblings, size_t leaves_n)
+    {
+        return idx < leaves_n && leaves_n <= pow(ARITY, height - 1) &&
+               verify_path(root, leaf, idx, siblings);
+    }
+
+    // Checks n paths against the same root, INPUT_N - 1 siblings each, valid[i] for path i
+    static void verify_paths(bool *valid, const uint8_t *root, const Digest *leaves,
+                             const size_t *indices, const Digest *siblings, size_t n)
+    {
+        verify_paths_many<ARITY, Hash::DIGEST_SIZE, LANES_N>(
+            valid, height - 1, root, (const uint8_t *)leaves, indices, (const uint8_t *)siblings,
+            n, hash_children);
+    }
+
+    static void verify_paths(bool *valid, const uint8_t *root, const Digest *leaves,
+                             const size_t *indices, const Digest *siblings, size_t n,
+                             size_t leaves_n)
+    {
+        verify_paths(valid, root, leaves, indices, siblings, n);
+
+        for (size_t i = 0; i < n; ++i)
+            valid[i] &= indices[i] < leaves_n && leaves_n <= pow(ARITY, height - 1);
+    }
+
     const uint8_t *digest() const
     {
-        return root->digest.data();
+        return nodes.back().data();
     }
 
-    const Node *get_node(size_t i) const
+    Node get_node(size_t i) const
     {
-        return &nodes[i];
+        return {this, i};
     }
 
     friend std::ostream &operator<<(std::ostream &os, const MTreePath &tree)
     {
-        if (!tree.root)
+        if (tree.nodes.empty())
             return os;
 
-        return os << *tree.root;
+        return os << tree.get_node(NODES_N - 1);
+    }
+
+private:
+    static void hash_children(uint8_t *digests, const uint8_t *children, size_t n)
+    {
+        hash_oneblock_many<Hash>(digests, children, n);
+    }
+
+    const Digest &digest_of(size_t i) const { return nodes[i]; }
+
+    static size_t parent_of(size_t i)
+    {
+        return i / ARITY + 1 < height ? (i / ARITY + 1) * ARITY : Node::NONE;
+    }
+
+    static size_t child_of(size_t i, size_t k)
+    {
+        // only the nodes on the path have children
+        return i % ARITY == 0 && i > 0 ? i - ARITY + k : Node::NONE;
+    }
+
+    void print(std::ostream &os, size_t i) const
+    {
+        for (size_t d = i / ARITY + 1; d < height; ++d)
+            os << "    ";
+
+        os << "*: " << hexdump(nodes[i], false, 64) << '\n';
+
+        for (size_t k = 0; child_of(i, 0) != Node::NONE && k < ARITY; ++k)
+            print(os, child_of(i, k));
     }
 };
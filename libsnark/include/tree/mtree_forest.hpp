@@ -0,0 +1,231 @@
+#pragma once
+
+#include "hash/batch.hpp"
+#include "util/const_math.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <omp.h>
+#include <utility>
+#include <vector>
+
+#if __cplusplus >= 202002L
+    #include <ranges>
+#endif
+
+/*
+Many small MTrees built together. Trees are stored one after the other in a single arena, each
+with the layout of MTree for its number of leaves, and the arena keeps its capacity from one
+batch to the next. The forest is built level by level across all trees: an OpenMP team hands out
+trees dynamically, and the parents of a level that do not fill a whole batch of hash lanes are
+gathered across trees into a per-thread batch, so trees of a few dozen leaves still hash LANES_N
+blocks at a time. Roots and paths are the same as the ones of MTree<height, Hash>.
+
+A few large trees keep one thread each per level, they are better built one by one with MTree.
+*/
+template<size_t height, typename Hash>
+class MTreeForest
+{
+public:
+    using Digest = std::array<uint8_t, Hash::DIGEST_SIZE>;
+    // Input data of one tree and its size in bytes
+    using Input = std::pair<const void *, size_t>;
+
+    static constexpr size_t ARITY = Hash::BLOCK_SIZE / Hash::DIGEST_SIZE;
+    static constexpr size_t LEAVES_N = pow(ARITY, height - 1);
+    static constexpr size_t INPUT_SIZE = LEAVES_N * Hash::BLOCK_SIZE;
+    static constexpr size_t LANES_N = hash_lanes_v<Hash>;
+    static constexpr size_t PATH_N = (ARITY - 1) * (height - 1);
+
+    static_assert(ARITY * Hash::DIGEST_SIZE == Hash::BLOCK_SIZE,
+                  "MTreeForest: the children of a node must fill a block");
+    static_assert(sizeof(Digest) == Hash::DIGEST_SIZE);
+
+private:
+    // Blocks from several trees hashed together, each digest goes back to its own tree
+    class Batch
+    {
+        std::array<uint8_t, LANES_N * Hash::BLOCK_SIZE> blocks;
+        std::array<uint8_t, LANES_N * Hash::DIGEST_SIZE> digests;
+        std::array<uint8_t *, LANES_N> out;
+        size_t n = 0;
+
+    public:
+        // A block of size bytes, zero padded
+        void push(const uint8_t *block, size_t size, uint8_t *digest)
+        {
+            memcpy(blocks.data() + n * Hash::BLOCK_SIZE, block, size);
+            memset(blocks.data() + n * Hash::BLOCK_SIZE + size, 0, Hash::BLOCK_SIZE - size);
+            out[n++] = digest;
+
+            if (n == LANES_N)
+                flush();
+        }
+
+        void flush()
+        {
+            hash_oneblock_many<Hash>(digests.data(), blocks.data(), n);
+
+            for (size_t i = 0; i < n; ++i)
+                memcpy(out[i], digests.data() + i * Hash::DIGEST_SIZE, Hash::DIGEST_SIZE);
+
+            n = 0;
+        }
+    };
+
+    std::vector<size_t> leaves_n{};
+    // Start of level l of tree t at offsets[t * (height + 1) + l], its end at level height
+    std::vector<size_t> offsets{};
+    std::vector<Digest> nodes{};
+
+public:
+    MTreeForest() = default;
+
+#if __cplusplus >= 202002L
+    template<std::ranges::range Range>
+    void build_forest(const Range &inputs)
+    {
+        build_forest(std::ranges::cdata(inputs), std::ranges::size(inputs));
+    }
+#endif
+
+    /*
+    Replaces the forest with one tree per input, each a whole number of blocks up to INPUT_SIZE.
+    The forest is left empty if an input has a bad size.
+    */
+    void build_forest(const Input *inputs, size_t n)
+    {
+        leaves_n.clear();
+        offsets.clear();
+
+        for (size_t t = 0; t < n; ++t)
+            if (inputs[t].second % Hash::BLOCK_SIZE != 0 || inputs[t].second == 0 ||
+                inputs[t].second > INPUT_SIZE)
+            {
+                std::cerr << "MTreeForest: Bad size of input data\n";
+                nodes.clear();
+                return;
+            }
+
+        size_t total = 0;
+
+        for (size_t t = 0; t < n; ++t)
+        {
+            leaves_n.push_back(inputs[t].second / Hash::BLOCK_SIZE);
+
+            for (size_t l = 0; l < height; total += width(t, l++))
+                offsets.push_back(total);
+            offsets.push_back(total);
+        }
+
+        // the arena only grows, digests are all overwritten
+        nodes.resize(total);
+
+#pragma omp parallel
+        {
+            Batch batch;
+
+            for (size_t l = 0; l < height; ++l)
+            {
+#pragma omp for schedule(dynamic, 16) nowait
+                for (size_t t = 0; t < n; ++t)
+                {
+                    if (l == 0)
+                        hash_run(node(t, 0, 0), (const uint8_t *)inputs[t].first, leaves_n[t],
+                                 Hash::BLOCK_SIZE, batch);
+                    else
+                        hash_run(node(t, l, 0), node(t, l - 1, 0)->data(), width(t, l),
+                                 (width(t, l - 1) - (width(t, l) - 1) * ARITY) *
+                                     Hash::DIGEST_SIZE,
+                                 batch);
+                }
+
+                // a level is complete once every thread hashed what it gathered
+                batch.flush();
+#pragma omp barrier
+            }
+        }
+    }
+
+    // Number of trees
+    size_t size() const
+    {
+        return leaves_n.size();
+    }
+
+    // Number of leaves of tree t
+    size_t leaves(size_t t) const
+    {
+        return leaves_n[t];
+    }
+
+    const uint8_t *digest(size_t t) const
+    {
+        return node(t, height - 1, 0)->data();
+    }
+
+    // Paths of leaves of tree t, laid out like MTree::paths
+    std::vector<Digest> paths(size_t t, const size_t *indices, size_t n) const
+    {
+        for (size_t i = 0; i < n; ++i)
+            if (indices[i] >= leaves_n[t])
+            {
+                std::cerr << "MTreeForest: Bad leaf index\n";
+                return {};
+            }
+
+        std::vector<Digest> out(n * PATH_N);
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            Digest *dst = out.data() + i * PATH_N;
+
+            for (size_t l = 0, p = indices[i]; l + 1 < height; ++l, p /= ARITY)
+            {
+                const size_t first = p / ARITY * ARITY;
+                const size_t last = std::min(first + ARITY, width(t, l));
+
+                dst = std::copy(node(t, l, first), node(t, l, p), dst);
+                dst = std::copy(node(t, l, p + 1), node(t, l, last), dst);
+                dst += first + ARITY - last;
+            }
+        }
+
+        return out;
+    }
+
+private:
+    size_t width(size_t t, size_t l) const
+    {
+        return (leaves_n[t] - 1) / pow(ARITY, l) + 1;
+    }
+
+    Digest *node(size_t t, size_t l, size_t p)
+    {
+        return nodes.data() + offsets[t * (height + 1) + l] + p;
+    }
+
+    const Digest *node(size_t t, size_t l, size_t p) const
+    {
+        return nodes.data() + offsets[t * (height + 1) + l] + p;
+    }
+
+    /*
+    n nodes from n consecutive blocks, the last one of last_size bytes. Whole batches of lanes
+    are hashed in place, the rest and a short last block go through the shared batch.
+    */
+    static void hash_run(Digest *out, const uint8_t *blocks, size_t n, size_t last_size,
+                         Batch &batch)
+    {
+        const size_t full = last_size < Hash::BLOCK_SIZE ? n - 1 : n;
+        const size_t direct = full / LANES_N * LANES_N;
+
+        hash_oneblock_many<Hash>(out[0].data(), blocks, direct);
+
+        for (size_t i = direct; i < n; ++i)
+            batch.push(blocks + i * Hash::BLOCK_SIZE, i < full ? Hash::BLOCK_SIZE : last_size,
+                       out[i].data());
+    }
+};
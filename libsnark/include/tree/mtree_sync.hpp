@@ -0,0 +1,296 @@
+#pragma once
+
+#include "hash/batch.hpp"
+#include "tree/mtree.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+
+/*
+Replica catch-up for MTree over a stream, a pipe or a socket, one file descriptor to read from
+and one to write to (the same one for a socket).
+
+The source sends a header and its root. The replica then walks down a level at a time: it sends
+the positions of the nodes of level l + 1 whose digests differ from its own, the source answers
+with all their children at level l, and the replica keeps the children that differ again. At the
+leaf level the differing digests are the new leaves of the replica. Only the differing subtrees
+cross the stream, k changed leaves take height - 1 round trips and O(k log n) digests. A replica
+with nothing left to ask sends an empty request and the source stops.
+
+The replica hashes every group of children it receives and compares it with the digest of the
+parent it asked about before going a level down, missing children of a partial tree hashed as
+zero digests. A corrupted stream or a bad source is rejected before anything is applied.
+
+Messages are in the native byte order, both ends run the same build:
+- source: Header, root digest
+- replica: count, count positions of level l + 1 as uint64_t, sorted and unique
+- source: the digests of the children of those nodes at level l, missing children skipped
+*/
+template<size_t height, typename Hash>
+class MTreeSync
+{
+public:
+    using Tree = MTree<height, Hash>;
+    using Digest = typename Tree::Digest;
+    using LeafRange = typename Tree::LeafRange;
+
+    static constexpr size_t ARITY = Tree::ARITY;
+
+private:
+    static constexpr size_t HEADER_SIZE = 48;
+    static constexpr char MAGIC[8] = {'M', 'T', 'R', 'E', 'E', 'S', 'Y', 'N'};
+
+    struct Header
+    {
+        char magic[8];
+        // hash_id<Hash>()
+        uint8_t hash_id[8];
+        uint64_t arity;
+        uint64_t tree_height;
+        uint64_t digest_size;
+        uint64_t leaves_n;
+    };
+
+    static_assert(sizeof(Header) == HEADER_SIZE);
+
+public:
+    // Answers one replica until it stops asking, false on a stream error or a bad request
+    static bool serve(const Tree &tree, int in_fd, int out_fd)
+    {
+        const Header header = make_header(tree.size());
+
+        if (!write_all(out_fd, &header, HEADER_SIZE) ||
+            !write_all(out_fd, tree.digest(), Hash::DIGEST_SIZE))
+            return false;
+
+        std::vector<uint64_t> pos;
+        std::vector<Digest> children;
+
+        for (size_t l = height - 1; l-- > 0;)
+        {
+            uint64_t n;
+
+            if (!read_all(in_fd, &n, sizeof(n)))
+                return false;
+            if (n == 0)
+                return true;
+
+            if (n > tree.size())
+            {
+                std::cerr << "MTreeSync: Bad request\n";
+                return false;
+            }
+
+            pos.resize(n);
+            if (!read_all(in_fd, pos.data(), n * sizeof(uint64_t)))
+                return false;
+
+            children.clear();
+            for (size_t i = 0; i < n; ++i)
+            {
+                if (!tree.digest(l + 1, pos[i]) || (i > 0 && pos[i] <= pos[i - 1]))
+                {
+                    std::cerr << "MTreeSync: Bad request\n";
+                    return false;
+                }
+
+                for (size_t c = pos[i] * ARITY; c < pos[i] * ARITY + ARITY; ++c)
+                    if (const uint8_t *d = tree.digest(l, c))
+                        memcpy(children.emplace_back().data(), d, Hash::DIGEST_SIZE);
+            }
+
+            if (!write_all(out_fd, children.data(), children.size() * Hash::DIGEST_SIZE))
+                return false;
+        }
+
+        return true;
+    }
+
+    /*
+    Brings replica to the root of the source. The changed leaf ranges are stored in changed if
+    it is not null. A replica of a different size or shape, or children that do not hash to the
+    root of the header, leave the replica as it is and give false.
+    */
+    static bool pull(Tree &replica, int in_fd, int out_fd,
+                     std::vector<LeafRange> *changed = nullptr)
+    {
+        const Header expected = make_header(replica.size());
+        Header header;
+        Digest root;
+
+        if (changed)
+            changed->clear();
+
+        if (!read_all(in_fd, &header, HEADER_SIZE) ||
+            !read_all(in_fd, root.data(), Hash::DIGEST_SIZE))
+            return false;
+
+        if (memcmp(&header, &expected, HEADER_SIZE) != 0)
+        {
+            std::cerr << "MTreeSync: The source holds a different tree\n";
+            stop(out_fd);
+            return false;
+        }
+
+        std::vector<uint64_t> differ;
+        // digests received for the nodes of differ, their children must hash to them
+        std::vector<Digest> wanted;
+        std::vector<Digest> children;
+        std::vector<Digest> hashed;
+        std::vector<uint8_t> blocks;
+
+        if (memcmp(root.data(), replica.digest(), Hash::DIGEST_SIZE) != 0)
+        {
+            differ.push_back(0);
+            wanted.push_back(root);
+        }
+
+        for (size_t l = height - 1; l-- > 0;)
+        {
+            if (differ.empty())
+                return stop(out_fd);
+
+            const uint64_t n = differ.size();
+            size_t children_n = 0;
+
+            for (uint64_t p : differ)
+                for (size_t c = p * ARITY; c < p * ARITY + ARITY && replica.digest(l, c); ++c)
+                    ++children_n;
+
+            children.resize(children_n);
+
+            if (!write_all(out_fd, &n, sizeof(n)) ||
+                !write_all(out_fd, differ.data(), n * sizeof(uint64_t)) ||
+                !read_all(in_fd, children.data(), children_n * Hash::DIGEST_SIZE))
+                return false;
+
+            blocks.assign(n * Hash::BLOCK_SIZE, 0);
+            hashed.resize(n);
+
+            for (size_t j = 0, i = 0; j < n; ++j)
+                for (size_t c = 0; c < ARITY && replica.digest(l, differ[j] * ARITY + c); ++c, ++i)
+                    memcpy(blocks.data() + j * Hash::BLOCK_SIZE + c * Hash::DIGEST_SIZE,
+                           children[i].data(), Hash::DIGEST_SIZE);
+
+            hash_oneblock_many<Hash>(hashed[0].data(), blocks.data(), n);
+
+            if (hashed != wanted)
+            {
+                std::cerr << "MTreeSync: The children do not match their parents\n";
+                // the source waits for a request until the leaves are sent
+                if (l > 0)
+                    stop(out_fd);
+                return false;
+            }
+
+            std::vector<uint64_t> below;
+            std::vector<Digest> digests;
+            size_t i = 0;
+
+            for (uint64_t p : differ)
+                for (size_t c = p * ARITY; c < p * ARITY + ARITY && replica.digest(l, c); ++c, ++i)
+                    if (memcmp(children[i].data(), replica.digest(l, c), Hash::DIGEST_SIZE) != 0)
+                    {
+                        below.push_back(c);
+                        digests.push_back(children[i]);
+                    }
+
+            differ = std::move(below);
+            wanted = std::move(digests);
+
+            // the differing leaves are the whole change set
+            if (l == 0)
+            {
+                std::vector<typename Tree::LeafUpdate> updates(differ.size());
+
+                for (size_t j = 0; j < differ.size(); ++j)
+                    updates[j] = {differ[j], wanted[j]};
+
+                replica.update_leaves(updates.data(), updates.size());
+            }
+        }
+
+        if (memcmp(root.data(), replica.digest(), Hash::DIGEST_SIZE) != 0)
+        {
+            std::cerr << "MTreeSync: The replica did not reach the root of the source\n";
+            return false;
+        }
+
+        if (changed)
+        {
+            for (uint64_t leaf : differ)
+                if (!changed->empty() && changed->back().second == leaf)
+                    ++changed->back().second;
+                else
+                    changed->emplace_back(leaf, leaf + 1);
+        }
+
+        return true;
+    }
+
+private:
+    static Header make_header(size_t leaves_n)
+    {
+        Header header{};
+
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        memcpy(header.hash_id, hash_id<Hash>().data(), sizeof(header.hash_id));
+        header.arity = ARITY;
+        header.tree_height = height;
+        header.digest_size = Hash::DIGEST_SIZE;
+        header.leaves_n = leaves_n;
+
+        return header;
+    }
+
+    // Empty request, the source stops
+    static bool stop(int out_fd)
+    {
+        const uint64_t n = 0;
+
+        return write_all(out_fd, &n, sizeof(n));
+    }
+
+    static bool write_all(int fd, const void *data, size_t size)
+    {
+        for (size_t done = 0; done < size;)
+        {
+            ssize_t n = ::write(fd, (const uint8_t *)data + done, size - done);
+
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+            {
+                std::cerr << "MTreeSync: Cannot write to the stream\n";
+                return false;
+            }
+
+            done += n;
+        }
+
+        return true;
+    }
+
+    static bool read_all(int fd, void *data, size_t size)
+    {
+        for (size_t done = 0; done < size;)
+        {
+            ssize_t n = ::read(fd, (uint8_t *)data + done, size - done);
+
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+            {
+                std::cerr << "MTreeSync: Cannot read from the stream\n";
+                return false;
+            }
+
+            done += n;
+        }
+
+        return true;
+    }
+};
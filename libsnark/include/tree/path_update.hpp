@@ -0,0 +1,40 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <omp.h>
+#include <vector>
+
+/*
+Recomputation of the ancestors of a set of changed leaves.
+Positions are kept sorted and unique level by level, so an ancestor shared by many changed leaves
+is recomputed once, and every level is recomputed in parallel before moving to the next one.
+Costs O(k log n) hashes for k leaves instead of a rebuild, less when paths merge near the root.
+
+Levels are numbered as in build_subtrees. The tree provides one callback:
+- parents(l, pos, n) recomputes the n nodes of level l at positions pos[0..n), in increasing order
+*/
+
+// Dirty nodes handed to one parents call
+static constexpr size_t PATH_UPDATE_CHUNK = 64;
+
+template<size_t ARITY, typename Parents>
+void update_paths(size_t height, std::vector<size_t> dirty, const Parents &parents)
+{
+    std::sort(dirty.begin(), dirty.end());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+    for (size_t l = 1; l < height && !dirty.empty(); ++l)
+    {
+        // positions stay sorted, siblings collapse into neighbouring duplicates
+        for (size_t &p : dirty)
+            p /= ARITY;
+        dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+        const size_t n = dirty.size();
+
+#pragma omp parallel for schedule(dynamic, 1) if (n > PATH_UPDATE_CHUNK)
+        for (size_t i = 0; i < n; i += PATH_UPDATE_CHUNK)
+            parents(l, dirty.data() + i, std::min(PATH_UPDATE_CHUNK, n - i));
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <omp.h>
+
+/*
+Verification of authentication paths without building a tree.
+A path is a leaf index and the ARITY - 1 siblings of each of its levels from the leaves up, in
+child order without the path node, as returned by MTree::paths. Paths are checked LANES at a
+time, each level of the group is one batched hash call, and only stack buffers are used.
+
+The tree provides one callback:
+- hash_children(digests, children, n) hashes n contiguous groups of ARITY digests
+*/
+
+// Paths handed to one thread at a time by verify_paths_many, in groups of LANES
+static constexpr size_t PATH_VERIFY_CHUNK = 64;
+
+template<size_t ARITY, size_t DIGEST_SIZE, size_t LANES, typename HashChildren>
+void verify_paths_lanes(bool *valid, size_t levels, const uint8_t *root, const uint8_t *leaves,
+                        const size_t *indices, const uint8_t *siblings, size_t n,
+                        const HashChildren &hash_children)
+{
+    static constexpr size_t GROUP_SIZE = ARITY * DIGEST_SIZE;
+
+    const size_t path_size = levels * (ARITY - 1) * DIGEST_SIZE;
+
+    uint8_t children[LANES * GROUP_SIZE];
+    uint8_t digests[LANES * DIGEST_SIZE];
+    size_t pos[LANES];
+
+    memcpy(digests, leaves, n * DIGEST_SIZE);
+    std::copy(indices, indices + n, pos);
+
+    for (size_t l = 0; l < levels; ++l)
+    {
+        // put the path node between its siblings
+        for (size_t i = 0; i < n; ++i)
+        {
+            const uint8_t *s = siblings + i * path_size + l * (ARITY - 1) * DIGEST_SIZE;
+            uint8_t *group = children + i * GROUP_SIZE;
+            size_t k = pos[i] % ARITY;
+
+            memcpy(group, s, k * DIGEST_SIZE);
+            memcpy(group + k * DIGEST_SIZE, digests + i * DIGEST_SIZE, DIGEST_SIZE);
+            memcpy(group + (k + 1) * DIGEST_SIZE, s + k * DIGEST_SIZE,
+                   (ARITY - 1 - k) * DIGEST_SIZE);
+
+            pos[i] /= ARITY;
+        }
+
+        hash_children(digests, children, n);
+    }
+
+    // an index left over after the last level is outside of the tree
+    for (size_t i = 0; i < n; ++i)
+        valid[i] = pos[i] == 0 && memcmp(digests + i * DIGEST_SIZE, root, DIGEST_SIZE) == 0;
+}
+
+template<size_t ARITY, size_t DIGEST_SIZE, size_t LANES, typename HashChildren>
+void verify_paths_many(bool *valid, size_t levels, const uint8_t *root, const uint8_t *leaves,
+                       const size_t *indices, const uint8_t *siblings, size_t n,
+                       const HashChildren &hash_children)
+{
+    const size_t path_size = levels * (ARITY - 1) * DIGEST_SIZE;
+
+#pragma omp parallel for schedule(dynamic, 1) if (n > PATH_VERIFY_CHUNK)
+    for (size_t c = 0; c < n; c += PATH_VERIFY_CHUNK)
+        for (size_t i = c; i < std::min(n, c + PATH_VERIFY_CHUNK); i += LANES)
+            verify_paths_lanes<ARITY, DIGEST_SIZE, LANES>(
+                valid + i, levels, root, leaves + i * DIGEST_SIZE, indices + i,
+                siblings + i * path_size, std::min(LANES, n - i), hash_children);
+}
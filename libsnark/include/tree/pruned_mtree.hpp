@@ -0,0 +1,307 @@
+#pragma once
+
+#include "hash/batch.hpp"
+#include "util/const_math.hpp"
+#include "util/flat_map.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <omp.h>
+#include <vector>
+
+#if __cplusplus >= 202002L
+    #include <ranges>
+#endif
+
+/*
+MTree that keeps only its top levels in memory.
+The cached_levels levels below and including the root are stored like in MTree, the level under
+them is cut into subtrees rooted at the lowest stored level. The internal nodes of those subtrees
+are recomputed when a path needs them, from the leaf digests when they are kept, else from the
+input data which must then outlive the tree. The last recomputed subtrees are kept in an LRU
+cache of a bounded number of subtrees. Roots and paths are the same as the ones of MTree.
+
+The cache is updated by paths, so a tree must not be queried from several threads at once.
+*/
+template<size_t height, typename Hash>
+class PrunedMTree
+{
+public:
+    using Digest = std::array<uint8_t, Hash::DIGEST_SIZE>;
+
+    static constexpr size_t ARITY = Hash::BLOCK_SIZE / Hash::DIGEST_SIZE;
+    static constexpr size_t LEAVES_N = pow(ARITY, height - 1);
+    static constexpr size_t INPUT_SIZE = LEAVES_N * Hash::BLOCK_SIZE;
+    static constexpr size_t LANES_N = hash_lanes_v<Hash>;
+    static constexpr size_t PATH_N = (ARITY - 1) * (height - 1);
+    // Default number of recomputed subtrees kept
+    static constexpr size_t CACHE_SUBTREES = 64;
+
+    static_assert(ARITY * Hash::DIGEST_SIZE == Hash::BLOCK_SIZE,
+                  "PrunedMTree: the children of a node must fill a block");
+    static_assert(sizeof(Digest) == Hash::DIGEST_SIZE);
+
+private:
+    struct CacheEntry
+    {
+        size_t subtree;
+        size_t last_use;
+        std::vector<Digest> nodes;
+    };
+
+    // Lowest stored level, the subtrees below it have cut levels
+    size_t cut = 0;
+    size_t cache_subtrees = CACHE_SUBTREES;
+    const uint8_t *data = nullptr;
+
+    // Stored levels from the cut to the root, leaf digests if kept
+    std::vector<Digest> top{};
+    std::vector<Digest> leaves{};
+
+    mutable std::vector<CacheEntry> cache{};
+    mutable FlatMap<size_t, size_t> cache_index{};
+    mutable size_t clock = 0;
+
+public:
+#if __cplusplus >= 202002L
+    template<std::ranges::range Range>
+    PrunedMTree(const Range &range, size_t cached_levels, bool keep_leaves = true,
+                size_t cache_subtrees = CACHE_SUBTREES) :
+        PrunedMTree(std::ranges::cdata(range),
+                    std::ranges::size(range) * sizeof(*std::ranges::cdata(range)), cached_levels,
+                    keep_leaves, cache_subtrees)
+    {}
+#endif
+
+    template<typename Iter>
+    PrunedMTree(const Iter begin, const Iter end, size_t cached_levels, bool keep_leaves = true,
+                size_t cache_subtrees = CACHE_SUBTREES) :
+        PrunedMTree(&*begin, std::distance(begin, end) * sizeof(*begin), cached_levels,
+                    keep_leaves, cache_subtrees)
+    {}
+
+    /*
+    Keeps cached_levels levels in [1, height], the root alone for 1, every node for height.
+    Without keep_leaves the tree reads the leaves back from vdata.
+    */
+    PrunedMTree(const void *vdata, size_t sz, size_t cached_levels, bool keep_leaves = true,
+                size_t cache_subtrees = CACHE_SUBTREES) :
+        cut{height - std::min(cached_levels, height)},
+        cache_subtrees{std::max(cache_subtrees, (size_t)1)}
+    {
+        if (sz != INPUT_SIZE)
+        {
+            std::cerr << "PrunedMTree: Bad size of input data\n";
+            return;
+        }
+        if (cached_levels == 0 || cached_levels > height)
+        {
+            std::cerr << "PrunedMTree: Bad number of cached levels\n";
+            return;
+        }
+
+        data = (const uint8_t *)vdata;
+        top.resize(top_offset(height));
+
+        if (cut == 0)
+            hash_leaves(top.data(), 0, LEAVES_N);
+        else
+        {
+            if (keep_leaves)
+            {
+                leaves.resize(LEAVES_N);
+                hash_leaves(leaves.data(), 0, LEAVES_N);
+                data = nullptr;
+            }
+
+            // every subtree once, to get its root
+#pragma omp parallel
+            {
+                std::vector<Digest> nodes(subtree_offset(cut));
+
+#pragma omp for schedule(dynamic, 1)
+                for (size_t p = 0; p < width(cut); ++p)
+                {
+                    build_subtree(p, nodes.data());
+                    Hash::hash_oneblock(top[p].data(), nodes[subtree_offset(cut - 1)].data());
+                }
+            }
+        }
+
+        for (size_t l = cut + 1; l < height; ++l)
+            hash_oneblock_many<Hash>(top[top_offset(l)].data(), top[top_offset(l - 1)].data(),
+                                     width(l));
+    }
+
+    // The zero digest if the arguments of the constructor were rejected
+    const uint8_t *digest() const
+    {
+        static const Digest zero{};
+
+        return top.empty() ? zero.data() : top.back().data();
+    }
+
+    // Digests held outside of the cache
+    size_t resident_size() const
+    {
+        return top.size() + leaves.size();
+    }
+
+    // Digests held by the cache of recomputed subtrees
+    size_t cache_size() const
+    {
+        return cache.size() * subtree_offset(cut);
+    }
+
+#if __cplusplus >= 202002L
+    template<std::ranges::range Range>
+    std::vector<Digest> paths(const Range &range) const
+    {
+        return paths(std::ranges::cdata(range), std::ranges::size(range));
+    }
+#endif
+
+    template<typename Iter>
+    std::vector<Digest> paths(const Iter begin, const Iter end) const
+    {
+        return paths(&*begin, std::distance(begin, end));
+    }
+
+    // Paths of the leaves at the given indices, laid out like MTree::paths
+    std::vector<Digest> paths(const size_t *indices, size_t n) const
+    {
+        if (top.empty())
+        {
+            std::cerr << "PrunedMTree: The tree was not built\n";
+            return {};
+        }
+
+        for (size_t i = 0; i < n; ++i)
+            if (indices[i] >= LEAVES_N)
+            {
+                std::cerr << "PrunedMTree: Bad leaf index\n";
+                return {};
+            }
+
+        std::vector<Digest> out(n * PATH_N);
+        std::vector<size_t> order(n);
+
+        // leaves of the same subtree together, so it is recomputed at most once
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(),
+                  [&](size_t a, size_t b) { return indices[a] < indices[b]; });
+
+        const Digest *nodes = nullptr;
+
+        for (size_t j = 0; j < n; ++j)
+        {
+            size_t i = indices[order[j]];
+            size_t p = i / width_under(cut);
+            Digest *dst = out.data() + order[j] * PATH_N;
+
+            if (cut > 0 && (j == 0 || p != indices[order[j - 1]] / width_under(cut)))
+                nodes = subtree(p);
+
+            for (size_t l = 0, q = i; l + 1 < height; ++l, q /= ARITY)
+            {
+                const Digest *group;
+
+                // positions in a subtree are relative to its first node on the level
+                if (l < cut)
+                    group = nodes + subtree_offset(l) +
+                            (q - p * width_under(cut - l)) / ARITY * ARITY;
+                else
+                    group = top.data() + top_offset(l) + q / ARITY * ARITY;
+
+                dst = std::copy(group, group + q % ARITY, dst);
+                dst = std::copy(group + q % ARITY + 1, group + ARITY, dst);
+            }
+        }
+
+        return out;
+    }
+
+private:
+    // Nodes of level l
+    static size_t width(size_t l)
+    {
+        return pow(ARITY, height - 1 - l);
+    }
+
+    // Nodes of level 0 under one node of level l
+    static size_t width_under(size_t l)
+    {
+        return pow(ARITY, l);
+    }
+
+    // Start of stored level l >= cut
+    size_t top_offset(size_t l) const
+    {
+        return pow_sum(ARITY, height - l, height - cut);
+    }
+
+    // Start of level l < cut in a subtree, levels from the leaves up without the root
+    size_t subtree_offset(size_t l) const
+    {
+        return pow_sum(ARITY, cut - l + 1, cut + 1);
+    }
+
+    void hash_leaves(Digest *out, size_t first, size_t n) const
+    {
+#pragma omp parallel for schedule(static) if (n >= 4096)
+        for (size_t i = 0; i < n; i += 1024)
+            hash_oneblock_many<Hash>(out[i].data(), data + (first + i) * Hash::BLOCK_SIZE,
+                                     std::min((size_t)1024, n - i));
+    }
+
+    // Levels below the cut of subtree p
+    void build_subtree(size_t p, Digest *nodes) const
+    {
+        const size_t first = p * width_under(cut);
+
+        if (leaves.empty())
+            for (size_t i = 0; i < width_under(cut); i += LANES_N)
+                hash_oneblock_many<Hash>(nodes[i].data(),
+                                         data + (first + i) * Hash::BLOCK_SIZE,
+                                         std::min(LANES_N, width_under(cut) - i));
+        else
+            std::copy(leaves.begin() + first, leaves.begin() + first + width_under(cut), nodes);
+
+        for (size_t l = 1; l < cut; ++l)
+            hash_oneblock_many<Hash>(nodes[subtree_offset(l)].data(),
+                                     nodes[subtree_offset(l - 1)].data(), width_under(cut - l));
+    }
+
+    // Recomputed levels of subtree p, from the cache or evicting the least recently used one
+    const Digest *subtree(size_t p) const
+    {
+        if (const size_t *slot = cache_index.find(p))
+        {
+            cache[*slot].last_use = ++clock;
+            return cache[*slot].nodes.data();
+        }
+
+        size_t slot = cache.size();
+
+        if (cache.size() < cache_subtrees)
+            cache.push_back({p, 0, std::vector<Digest>(subtree_offset(cut))});
+        else
+        {
+            slot = std::min_element(cache.begin(), cache.end(),
+                                    [](const CacheEntry &a, const CacheEntry &b)
+                                    { return a.last_use < b.last_use; }) -
+                   cache.begin();
+            cache_index.erase(cache[slot].subtree);
+        }
+
+        build_subtree(p, cache[slot].nodes.data());
+        cache[slot].subtree = p;
+        cache[slot].last_use = ++clock;
+        cache_index.insert_or_assign(p, slot);
+
+        return cache[slot].nodes.data();
+    }
+};
@@ -0,0 +1,212 @@
+#pragma once
+
+#include "tree/fixed_mtree.hpp"
+#include "util/flat_map.hpp"
+
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+/*
+Sparse Merkle tree keyed by leaf index, for heights up to 256.
+Parents hash like in FixedMTree, the two children zero padded to a block. Leaves that were never
+set hold the zero digest, so an empty subtree has a known digest per level, computed once per
+Hash. Only nodes whose digest differs from the empty one of their level are stored, memory grows
+with the number of set leaves instead of 2^height. Setting a leaf to the zero digest removes it.
+*/
+template<size_t height, typename Hash>
+class SparseMTree
+{
+    static_assert(height >= 2 && height <= 256, "SparseMTree: height must be in [2, 256]");
+
+public:
+    static constexpr size_t KEY_WORDS = (height - 1 + 63) / 64;
+
+    using Digest = std::array<uint8_t, Hash::DIGEST_SIZE>;
+    // Leaf index as little-endian 64-bit words
+    using Key = std::array<uint64_t, KEY_WORDS>;
+
+private:
+    struct NodeId
+    {
+        Key pos;
+        size_t level;
+
+        bool operator==(const NodeId &other) const
+        {
+            return level == other.level && pos == other.pos;
+        }
+
+        bool operator!=(const NodeId &other) const { return !(*this == other); }
+    };
+
+    struct NodeIdHash
+    {
+        uint64_t operator()(const NodeId &id) const
+        {
+            uint64_t h = id.level;
+
+            // every word is mixed into the previous ones
+            for (uint64_t w : id.pos)
+                h = mix64(h ^ w);
+
+            return h;
+        }
+    };
+
+    FlatMap<NodeId, Digest, NodeIdHash> nodes{};
+
+public:
+    SparseMTree() = default;
+
+    static Key key_of(uint64_t index)
+    {
+        Key key{};
+
+        key[0] = index;
+
+        return key;
+    }
+
+    // Digest of an empty subtree whose root is at the given level, 0 for leaves
+    static const Digest &empty_digest(size_t level)
+    {
+        return empty_digests()[level];
+    }
+
+    void insert(const Key &key, const Digest &leaf)
+    {
+        if (!is_valid(key))
+        {
+            std::cerr << "SparseMTree: Bad leaf index\n";
+            return;
+        }
+
+        NodeId id{key, 0};
+        Digest digest{leaf};
+        uint8_t pair[2 * Hash::DIGEST_SIZE];
+
+        set(id, digest);
+
+        for (size_t l = 1; l < height; ++l)
+        {
+            size_t right = id.pos[0] & 1;
+
+            memcpy(pair + Hash::DIGEST_SIZE * right, digest.data(), Hash::DIGEST_SIZE);
+            memcpy(pair + Hash::DIGEST_SIZE * (1 - right), get(sibling(id)).data(),
+                   Hash::DIGEST_SIZE);
+
+            fixed_mtree_hash_pairs<Hash>(digest.data(), pair, 1);
+            id = parent(id);
+            set(id, digest);
+        }
+    }
+
+    void insert(uint64_t index, const Digest &leaf) { insert(key_of(index), leaf); }
+
+    void remove(const Key &key) { insert(key, empty_digest(0)); }
+    void remove(uint64_t index) { remove(key_of(index)); }
+
+    Digest get_leaf(const Key &key) const { return get({key, 0}); }
+    Digest get_leaf(uint64_t index) const { return get_leaf(key_of(index)); }
+
+    Digest digest() const
+    {
+        return get({Key{}, height - 1});
+    }
+
+    // Siblings of the path from the leaf up to the root, height - 1 digests
+    std::vector<Digest> path(const Key &key) const
+    {
+        std::vector<Digest> siblings;
+        NodeId id{key, 0};
+
+        if (!is_valid(key))
+        {
+            std::cerr << "SparseMTree: Bad leaf index\n";
+            return siblings;
+        }
+
+        siblings.reserve(height - 1);
+        for (size_t l = 1; l < height; ++l, id = parent(id))
+            siblings.push_back(get(sibling(id)));
+
+        return siblings;
+    }
+
+    std::vector<Digest> path(uint64_t index) const { return path(key_of(index)); }
+
+    // Number of stored nodes, the ones that differ from an empty subtree
+    size_t size() const { return nodes.size(); }
+
+private:
+    static const std::array<Digest, height> &empty_digests()
+    {
+        // Built on first use, the constants of Hash may not be initialized before
+        static const std::array<Digest, height> empty = []() {
+            std::array<Digest, height> e{};
+            uint8_t pair[2 * Hash::DIGEST_SIZE];
+
+            for (size_t l = 1; l < height; ++l)
+            {
+                memcpy(pair, e[l - 1].data(), Hash::DIGEST_SIZE);
+                memcpy(pair + Hash::DIGEST_SIZE, e[l - 1].data(), Hash::DIGEST_SIZE);
+                fixed_mtree_hash_pairs<Hash>(e[l].data(), pair, 1);
+            }
+
+            return e;
+        }();
+
+        return empty;
+    }
+
+    static bool is_valid(const Key &key)
+    {
+        // no bit at or above height - 1
+        for (size_t i = 0; i < KEY_WORDS; ++i)
+        {
+            size_t low = 64 * i;
+
+            if (height - 1 <= low ? key[i] != 0
+                                  : height - 1 < low + 64 && key[i] >> (height - 1 - low) != 0)
+                return false;
+        }
+
+        return true;
+    }
+
+    static NodeId parent(const NodeId &id)
+    {
+        NodeId p{{}, id.level + 1};
+
+        for (size_t i = 0; i < KEY_WORDS; ++i)
+            p.pos[i] = id.pos[i] >> 1 | (i + 1 < KEY_WORDS ? id.pos[i + 1] << 63 : 0);
+
+        return p;
+    }
+
+    static NodeId sibling(const NodeId &id)
+    {
+        NodeId s{id};
+
+        s.pos[0] ^= 1;
+
+        return s;
+    }
+
+    Digest get(const NodeId &id) const
+    {
+        const Digest *d = nodes.find(id);
+
+        return d ? *d : empty_digest(id.level);
+    }
+
+    void set(const NodeId &id, const Digest &digest)
+    {
+        if (digest == empty_digest(id.level))
+            nodes.erase(id);
+        else
+            nodes.insert_or_assign(id, digest);
+    }
+};
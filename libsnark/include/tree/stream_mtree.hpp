@@ -0,0 +1,285 @@
+#pragma once
+
+#include "hash/batch.hpp"
+#include "util/const_math.hpp"
+#include "util/ordered_ring.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <omp.h>
+#include <thread>
+#include <vector>
+
+/*
+Root of an MTree computed from a stream of its input, without storing the tree.
+Level l keeps a frontier of up to LANES_N blocks of children, the digests of level l - 1 that
+are not hashed yet (the input blocks for the leaves). Once a frontier holds LANES_N blocks they
+are hashed in one batch and the digests move up, so memory is O(height * LANES_N * ARITY)
+digests whatever the input size. The root is the same as the one of MTree<height, Hash>.
+
+update() is not thread-safe. Input produced on other threads either goes through
+update_parallel(), which pulls it from a callback on threads it starts, or is pushed into a Feed
+from any threads while one thread runs consume() on it.
+*/
+template<size_t height, typename Hash>
+class StreamMTree
+{
+public:
+    using Digest = std::array<uint8_t, Hash::DIGEST_SIZE>;
+
+    static constexpr size_t ARITY = Hash::BLOCK_SIZE / Hash::DIGEST_SIZE;
+    static constexpr size_t LEAVES_N = pow(ARITY, height - 1);
+    static constexpr size_t INPUT_SIZE = LEAVES_N * Hash::BLOCK_SIZE;
+    static constexpr size_t LANES_N = hash_lanes_v<Hash>;
+    // Default size of the chunks handed over by producer threads
+    static constexpr size_t CHUNK_SIZE = 1ULL << 20;
+
+    static_assert(ARITY * Hash::DIGEST_SIZE == Hash::BLOCK_SIZE,
+                  "StreamMTree: the children of a node must fill a block");
+
+private:
+    static constexpr size_t FRONTIER_SIZE = LANES_N * Hash::BLOCK_SIZE;
+
+    std::array<std::array<uint8_t, FRONTIER_SIZE>, height> frontier{};
+    std::array<size_t, height> fill{};
+    Digest root{};
+    size_t fed = 0;
+
+public:
+    /*
+    Bounded queue of input chunks between producer threads and consume().
+    push() is thread-safe, chunks enter the tree in the order in which the push calls took their
+    ticket, and a push waits while capacity chunks are still in flight. close() is called once
+    every push returned, e.g. after joining the producers.
+    */
+    class Feed
+    {
+        friend class StreamMTree;
+
+        OrderedRing<std::vector<uint8_t>> ring;
+        std::atomic<size_t> next{0};
+        std::atomic<bool> closed{false};
+        size_t chunk_size;
+
+    public:
+        explicit Feed(size_t capacity, size_t chunk_size = CHUNK_SIZE) :
+            ring{capacity, std::vector<uint8_t>(chunk_size)}, chunk_size{chunk_size}
+        {
+        }
+
+        // Returns false for chunks larger than chunk_size, they are not queued
+        bool push(const void *data, size_t size)
+        {
+            if (size > chunk_size)
+            {
+                std::cerr << "StreamMTree: Chunk larger than the feed slots\n";
+                return false;
+            }
+
+            const size_t s = next.fetch_add(1, std::memory_order_relaxed);
+            std::vector<uint8_t> *chunk;
+
+            while (!(chunk = ring.try_claim(s)))
+                std::this_thread::yield();
+
+            // within the capacity of the slot, nothing is reallocated
+            chunk->assign((const uint8_t *)data, (const uint8_t *)data + size);
+            ring.publish(s);
+
+            return true;
+        }
+
+        void close() { closed.store(true, std::memory_order_release); }
+    };
+
+    StreamMTree() = default;
+
+    bool is_complete() const { return fed == INPUT_SIZE; }
+
+    // Input bytes received so far
+    size_t size() const { return fed; }
+
+    // Root once the whole input was received
+    const uint8_t *digest() const
+    {
+        return root.data();
+    }
+
+    // Appends input bytes, pieces may have any size
+    void update(const void *vdata, size_t size)
+    {
+        if (size > INPUT_SIZE - fed)
+        {
+            std::cerr << "StreamMTree: Too much input data\n";
+            return;
+        }
+
+        const uint8_t *data = (const uint8_t *)vdata;
+
+        fed += size;
+
+        // whole batches of blocks are hashed straight from the input
+        if (fill[0] == 0 && size >= FRONTIER_SIZE)
+        {
+            size_t n = size / FRONTIER_SIZE * FRONTIER_SIZE;
+
+            hash_blocks(0, data, n / Hash::BLOCK_SIZE);
+            data += n;
+            size -= n;
+        }
+
+        push(0, data, size);
+
+        if (is_complete())
+            finish();
+    }
+
+    /*
+    Streams the rest of the input from producer threads.
+    produce(offset, buffer, size) writes input bytes [offset, offset + size) and returns false on
+    failure. Chunks of chunk_size bytes are handed out in increasing order and may be produced
+    concurrently, at most depth of them wait in an OrderedRing while the calling thread hashes
+    them in order. Returns whether the input is complete.
+    */
+    template<typename Produce>
+    bool update_parallel(const Produce &produce, size_t producers,
+                         size_t chunk_size = CHUNK_SIZE, size_t depth = 0)
+    {
+        const size_t start = fed;
+        const size_t chunks = (INPUT_SIZE - start + chunk_size - 1) / chunk_size;
+
+        OrderedRing<std::vector<uint8_t>> ring(depth ? depth : 2 * producers + 1,
+                                               std::vector<uint8_t>(chunk_size));
+        std::atomic<size_t> next{0};
+        std::atomic<bool> failed{false};
+
+        auto size_of = [&](size_t c)
+        { return std::min(chunk_size, INPUT_SIZE - start - c * chunk_size); };
+
+#pragma omp parallel num_threads(producers + 1)
+        if (omp_get_num_threads() == 1)
+        {
+            std::vector<uint8_t> chunk(chunk_size);
+
+            for (size_t c = 0; c < chunks; ++c)
+            {
+                if (!produce(start + c * chunk_size, chunk.data(), size_of(c)))
+                    break;
+
+                update(chunk.data(), size_of(c));
+            }
+        }
+        else if (omp_get_thread_num() == 0)
+        {
+            // consumer, takes the chunks back in order
+            for (size_t c = 0; c < chunks; ++c)
+            {
+                const std::vector<uint8_t> *chunk;
+
+                while (!(chunk = ring.try_front(c)) && !failed.load(std::memory_order_relaxed))
+                    std::this_thread::yield();
+                if (!chunk)
+                    break;
+
+                update(chunk->data(), size_of(c));
+                ring.release(c);
+            }
+        }
+        else
+        {
+            // producers, claim the next chunk and wait for its slot
+            for (size_t c; (c = next.fetch_add(1, std::memory_order_relaxed)) < chunks;)
+            {
+                std::vector<uint8_t> *chunk;
+
+                while (!(chunk = ring.try_claim(c)) && !failed.load(std::memory_order_relaxed))
+                    std::this_thread::yield();
+                if (!chunk)
+                    break;
+
+                if (!produce(start + c * chunk_size, chunk->data(), size_of(c)))
+                {
+                    failed.store(true, std::memory_order_relaxed);
+                    break;
+                }
+
+                ring.publish(c);
+            }
+        }
+
+        return is_complete();
+    }
+
+    // Hashes the chunks of feed until it is closed and drained, returns whether input is complete
+    bool consume(Feed &feed)
+    {
+        for (size_t s = 0;; ++s)
+        {
+            const std::vector<uint8_t> *chunk;
+
+            while (!(chunk = feed.ring.try_front(s)))
+            {
+                // every push returned before close(), a chunk still missing was never pushed
+                if (feed.closed.load(std::memory_order_acquire) && !feed.ring.try_front(s))
+                    return is_complete();
+
+                std::this_thread::yield();
+            }
+
+            update(chunk->data(), chunk->size());
+            feed.ring.release(s);
+        }
+    }
+
+private:
+    // Hashes n blocks into nodes of level l, which feed the frontier of level l + 1
+    void hash_blocks(size_t l, const uint8_t *blocks, size_t n)
+    {
+        for (size_t i = 0; i < n; i += LANES_N)
+        {
+            uint8_t digests[LANES_N * Hash::DIGEST_SIZE];
+            size_t m = std::min(LANES_N, n - i);
+
+            hash_oneblock_many<Hash>(digests, blocks + i * Hash::BLOCK_SIZE, m);
+
+            if (l + 1 == height)
+                memcpy(root.data(), digests, Hash::DIGEST_SIZE);
+            else
+                push(l + 1, digests, m * Hash::DIGEST_SIZE);
+        }
+    }
+
+    void push(size_t l, const uint8_t *data, size_t size)
+    {
+        while (size > 0)
+        {
+            size_t n = std::min(size, FRONTIER_SIZE - fill[l]);
+
+            memcpy(frontier[l].data() + fill[l], data, n);
+            fill[l] += n;
+            data += n;
+            size -= n;
+
+            if (fill[l] == FRONTIER_SIZE)
+            {
+                fill[l] = 0;
+                hash_blocks(l, frontier[l].data(), LANES_N);
+            }
+        }
+    }
+
+    // Levels narrower than a batch are left in the frontiers, they always hold whole blocks
+    void finish()
+    {
+        for (size_t l = 0; l < height; ++l)
+        {
+            size_t n = fill[l] / Hash::BLOCK_SIZE;
+
+            fill[l] = 0;
+            hash_blocks(l, frontier[l].data(), n);
+        }
+    }
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "util/const_math.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <omp.h>
+
+/*
+Parallel bottom-up construction of a complete tree without a barrier per level.
+The tree is cut at a split level: every node of that level roots a subtree that one thread
+builds on its own, leaves first and then its levels up to the subtree root, so the digests it
+touches stay in cache. Subtrees are handed out dynamically. Above the split level every node has
+a counter of children still missing, the thread that completes the last child builds the parent
+and keeps climbing, so the top of the tree is merged as soon as its inputs exist.
+
+Levels are numbered from the leaves (0) to the root (height - 1). With leaves_n leaves level l
+has ceil(leaves_n / ARITY^l) nodes, ARITY^(height - 1 - l) for a complete tree, so only the last
+node of a level may have fewer than ARITY children. The tree only provides two callbacks over
+contiguous ranges:
+- leaves(first, n) computes leaves [first, first + n)
+- parents(l, first, n) computes nodes [first, first + n) of level l from level l - 1
+*/
+
+// Largest subtree, in leaves, one thread builds by itself
+static constexpr size_t SUBTREE_LEAVES_MAX = 1ULL << 13;
+
+template<size_t ARITY, typename Leaves, typename Parents>
+void build_subtrees(size_t height, const Leaves &leaves, const Parents &parents,
+                    size_t subtree_leaves = SUBTREE_LEAVES_MAX, size_t leaves_n = SIZE_MAX)
+{
+    leaves_n = std::min(leaves_n, pow(ARITY, height - 1));
+
+    auto width = [leaves_n](size_t l) { return (leaves_n - 1) / pow(ARITY, l) + 1; };
+
+    // Split as high as the size limit allows while leaving a few subtrees per thread
+    const size_t min_subtrees = 4 * (size_t)omp_get_max_threads();
+    size_t split = 0;
+
+    while (split + 1 < height && pow(ARITY, split + 1) <= subtree_leaves &&
+           width(split + 1) >= min_subtrees)
+        ++split;
+
+    // Missing children of the nodes above the split level, level by level
+    size_t top_n = 0;
+
+    for (size_t l = split + 1; l < height; ++l)
+        top_n += width(l);
+
+    std::unique_ptr<std::atomic<size_t>[]> pending{new std::atomic<size_t>[top_n]};
+
+    for (size_t l = split + 1, base = 0; l < height; base += width(l++))
+        for (size_t q = 0; q < width(l); ++q)
+            pending[base + q].store(std::min(ARITY, width(l - 1) - q * ARITY),
+                                    std::memory_order_relaxed);
+
+    const size_t subtrees = width(split);
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (size_t p = 0; p < subtrees; ++p)
+    {
+        // the last subtree may be cut short on every level
+        for (size_t l = 0; l <= split; ++l)
+        {
+            size_t first = p * pow(ARITY, split - l);
+            size_t n = std::min(pow(ARITY, split - l), width(l) - first);
+
+            if (l == 0)
+                leaves(first, n);
+            else
+                parents(l, first, n);
+        }
+
+        // Climb while this thread completes the last missing child
+        for (size_t l = split + 1, q = p, base = 0; l < height; base += width(l++))
+        {
+            q /= ARITY;
+
+            if (pending[base + q].fetch_sub(1, std::memory_order_acq_rel) != 1)
+                break;
+
+            parents(l, q, 1);
+        }
+    }
+}
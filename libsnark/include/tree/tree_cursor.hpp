@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+/*
+Handle on a node of an implicitly indexed tree.
+The trees only store digests, level by level in one contiguous array, and compute the parent
+and children of a node from its index. A cursor is the tree and the index, it is passed by value
+and dereferences to itself, so navigation keeps the shape it had with node pointers:
+tree.get_node(i)->get_f()->get_c(j)->get_digest(). Moving past the root or below a leaf gives
+a null cursor.
+*/
+template<typename Tree>
+class TreeCursor
+{
+public:
+    static constexpr size_t NONE = SIZE_MAX;
+
+private:
+    const Tree *tree = nullptr;
+    size_t index = NONE;
+
+public:
+    TreeCursor() = default;
+
+    TreeCursor(const Tree *tree, size_t index) :
+        tree{index == NONE ? nullptr : tree}, index{index}
+    {}
+
+    explicit operator bool() const { return tree != nullptr; }
+
+    size_t get_index() const { return index; }
+    decltype(auto) get_digest() const { return tree->digest_of(index); }
+    // Only for trees of field elements
+    decltype(auto) get_field() const { return tree->field_of(index); }
+    TreeCursor get_f() const { return {tree, tree->parent_of(index)}; }
+    TreeCursor get_c(size_t i) const { return {tree, tree->child_of(index, i)}; }
+
+    const TreeCursor *operator->() const { return this; }
+    const TreeCursor &operator*() const { return *this; }
+
+    bool operator==(const TreeCursor &other) const
+    {
+        return tree == other.tree && index == other.index;
+    }
+
+    bool operator!=(const TreeCursor &other) const { return !(*this == other); }
+
+    // Prints the subtree under the node
+    void print(std::ostream &os) const
+    {
+        if (tree)
+            tree->print(os, index);
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const TreeCursor &node)
+    {
+        node.print(os);
+
+        return os;
+    }
+};
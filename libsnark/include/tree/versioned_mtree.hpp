@@ -0,0 +1,456 @@
+#pragma once
+
+#include "hash/batch.hpp"
+#include "util/const_math.hpp"
+#include "util/flat_map.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <omp.h>
+#include <utility>
+#include <vector>
+
+#if __cplusplus >= 202002L
+    #include <ranges>
+#endif
+
+/*
+Persistent Merkle tree keeping several versions of the same complete tree, with the roots of
+MTree<height, Hash>. Internal nodes live in a store keyed by their level and digest and hold the
+digests of their children, leaves are only digests inside the nodes of level 1. A leaf block may
+equal the children of a node, so equal digests on different levels are different nodes. An
+update creates the nodes on the paths of the changed leaves and shares every other subtree with
+the versions it came from, identical subtrees are stored once. Memory for k versions of m
+updates each is O(n + k m log n) nodes instead of k copies of the tree.
+
+Every node counts the references to it from stored parents and from versions. snapshot keeps the
+current root as a version, release drops one, and nodes no longer reachable from a version or
+the current root are freed right away.
+*/
+template<size_t height, typename Hash>
+class VersionedMTree
+{
+public:
+    using Digest = std::array<uint8_t, Hash::DIGEST_SIZE>;
+    // New digest of the leaf at the given index
+    using LeafUpdate = std::pair<size_t, Digest>;
+
+    static constexpr size_t ARITY = Hash::BLOCK_SIZE / Hash::DIGEST_SIZE;
+    static constexpr size_t LEAVES_N = pow(ARITY, height - 1);
+    static constexpr size_t INPUT_SIZE = LEAVES_N * Hash::BLOCK_SIZE;
+    static constexpr size_t PATH_N = (ARITY - 1) * (height - 1);
+
+    static_assert(height >= 2, "VersionedMTree: height must be at least 2");
+    static_assert(ARITY * Hash::DIGEST_SIZE == Hash::BLOCK_SIZE,
+                  "VersionedMTree: the children of a node must fill a block");
+    static_assert(sizeof(Digest) == Hash::DIGEST_SIZE && sizeof(Digest) >= sizeof(uint64_t));
+
+private:
+    // The children of a node, laid out as the block it is hashed from
+    using Children = std::array<Digest, ARITY>;
+
+    struct Node
+    {
+        Children children;
+        size_t refs;
+    };
+
+    static_assert(sizeof(Children) == Hash::BLOCK_SIZE);
+
+    struct NodeId
+    {
+        Digest digest;
+        size_t level;
+
+        bool operator==(const NodeId &other) const
+        {
+            return level == other.level && digest == other.digest;
+        }
+    };
+
+    struct NodeIdHash
+    {
+        uint64_t operator()(const NodeId &id) const
+        {
+            uint64_t h;
+
+            // digests are already uniform, mixing only covers weak hashes
+            memcpy(&h, id.digest.data(), sizeof(h));
+
+            return mix64(h ^ id.level);
+        }
+    };
+
+    FlatMap<NodeId, Node, NodeIdHash> nodes{};
+    FlatMap<size_t, Digest> versions{};
+    size_t next_version = 0;
+    // Current root, it holds a reference like a version
+    Digest root{};
+
+public:
+#if __cplusplus >= 202002L
+    template<std::ranges::range Range>
+    VersionedMTree(const Range &range) :
+        VersionedMTree(std::ranges::cdata(range),
+                       std::ranges::size(range) * sizeof(*std::ranges::cdata(range)))
+    {}
+#endif
+
+    template<typename Iter>
+    VersionedMTree(const Iter begin, const Iter end) :
+        VersionedMTree(&*begin, std::distance(begin, end) * sizeof(*begin))
+    {}
+
+    // The first current root, from INPUT_SIZE bytes, one leaf per block
+    VersionedMTree(const void *vdata, size_t sz)
+    {
+        std::vector<Digest> level(LEAVES_N);
+
+        if (sz != INPUT_SIZE)
+            std::cerr << "VersionedMTree: Bad size of input data\n";
+        else
+            hash_level(level.data(), vdata, LEAVES_N);
+
+        // a stored node takes over the references its children got from interning them
+        for (size_t l = 1; l < height; ++l)
+        {
+            std::vector<Digest> parents(level.size() / ARITY);
+
+            hash_level(parents.data(), level.data(), parents.size());
+
+            for (size_t p = 0; p < parents.size(); ++p)
+            {
+                Children children;
+
+                std::copy_n(level.begin() + p * ARITY, ARITY, children.begin());
+                intern(parents[p], children, l);
+            }
+
+            level = std::move(parents);
+        }
+
+        root = level[0];
+    }
+
+    VersionedMTree(const VersionedMTree &) = delete;
+    VersionedMTree &operator=(const VersionedMTree &) = delete;
+
+    const uint8_t *digest() const
+    {
+        return root.data();
+    }
+
+    // Root of a version, nullptr if it was released
+    const uint8_t *digest(size_t version) const
+    {
+        const Digest *d = versions.find(version);
+
+        if (!d)
+        {
+            std::cerr << "VersionedMTree: Bad version\n";
+            return nullptr;
+        }
+
+        return d->data();
+    }
+
+    // Keeps the current root, the returned version stays valid until it is released
+    size_t snapshot()
+    {
+        ref(root, height - 1);
+        versions.insert_or_assign(next_version, root);
+
+        return next_version++;
+    }
+
+    // Drops a version, the nodes only it used are freed
+    void release(size_t version)
+    {
+        const Digest *d = versions.find(version);
+
+        if (!d)
+        {
+            std::cerr << "VersionedMTree: Bad version\n";
+            return;
+        }
+
+        const Digest old = *d;
+
+        versions.erase(version);
+        unref(old, height - 1);
+    }
+
+    // Makes the root of a version the current one, for a rollback
+    void checkout(size_t version)
+    {
+        const Digest *d = versions.find(version);
+
+        if (!d)
+        {
+            std::cerr << "VersionedMTree: Bad version\n";
+            return;
+        }
+
+        const Digest old = root;
+
+        root = *d;
+        ref(root, height - 1);
+        unref(old, height - 1);
+    }
+
+#if __cplusplus >= 202002L
+    template<std::ranges::range Range>
+    void update_leaves(const Range &range)
+    {
+        update_leaves(std::ranges::cdata(range), std::ranges::size(range));
+    }
+#endif
+
+    template<typename Iter>
+    void update_leaves(const Iter begin, const Iter end)
+    {
+        update_leaves(&*begin, std::distance(begin, end));
+    }
+
+    /*
+    Sets leaf digests of the current root, the last update of a leaf wins. The nodes on the
+    changed paths are read top down, then the new ones are hashed bottom up, a level at a time.
+    */
+    void update_leaves(const LeafUpdate *updates, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+            if (updates[i].first >= LEAVES_N)
+            {
+                std::cerr << "VersionedMTree: Bad leaf index\n";
+                return;
+            }
+
+        if (n == 0)
+            return;
+
+        std::vector<LeafUpdate> leaves(updates, updates + n);
+
+        std::stable_sort(leaves.begin(), leaves.end(),
+                         [](const LeafUpdate &a, const LeafUpdate &b) { return a.first < b.first; });
+        leaves.erase(leaves.begin(),
+                     std::unique(leaves.rbegin(), leaves.rend(),
+                                 [](const LeafUpdate &a, const LeafUpdate &b)
+                                 { return a.first == b.first; })
+                         .base());
+
+        // positions of the changed nodes of every level, sorted
+        std::vector<std::vector<size_t>> pos(height);
+        std::vector<std::vector<Children>> children(height);
+
+        for (const LeafUpdate &leaf : leaves)
+            pos[0].push_back(leaf.first);
+
+        for (size_t l = 1; l < height; ++l)
+        {
+            for (size_t p : pos[l - 1])
+                if (pos[l].empty() || pos[l].back() != p / ARITY)
+                    pos[l].push_back(p / ARITY);
+
+            children[l].resize(pos[l].size());
+        }
+
+        // nothing is changed before every node on the paths is found
+        const Children *top = children_of(root, height - 1);
+
+        if (!top)
+            return;
+
+        children[height - 1][0] = *top;
+
+        for (size_t l = height - 1; l-- > 1;)
+            for (size_t i = 0, j = 0; i < pos[l].size(); ++i)
+            {
+                while (pos[l + 1][j] != pos[l][i] / ARITY)
+                    ++j;
+
+                const Children *node = children_of(children[l + 1][j][pos[l][i] % ARITY], l);
+
+                if (!node)
+                    return;
+
+                children[l][i] = *node;
+            }
+
+        std::vector<Digest> level(leaves.size());
+
+        for (size_t i = 0; i < leaves.size(); ++i)
+            level[i] = leaves[i].second;
+
+        for (size_t l = 1; l < height; ++l)
+        {
+            std::vector<Digest> parents(pos[l].size());
+
+            // unchanged children get one more reference, changed ones bring their own
+            for (size_t i = 0, j = 0; i < pos[l].size(); ++i)
+                for (size_t c = 0; c < ARITY; ++c)
+                    if (j < pos[l - 1].size() && pos[l - 1][j] == pos[l][i] * ARITY + c)
+                        children[l][i][c] = level[j++];
+                    else
+                        ref(children[l][i][c], l - 1);
+
+            hash_level(parents.data(), children[l].data(), parents.size());
+
+            for (size_t i = 0; i < parents.size(); ++i)
+                intern(parents[i], children[l][i], l);
+
+            level = std::move(parents);
+        }
+
+        const Digest old = root;
+
+        root = level[0];
+        unref(old, height - 1);
+    }
+
+    // Paths of leaves of the current root, laid out like MTree::paths
+    std::vector<Digest> paths(const size_t *indices, size_t n) const
+    {
+        return paths_from(root, indices, n);
+    }
+
+    std::vector<Digest> paths(size_t version, const size_t *indices, size_t n) const
+    {
+        const Digest *d = versions.find(version);
+
+        if (!d)
+        {
+            std::cerr << "VersionedMTree: Bad version\n";
+            return {};
+        }
+
+        return paths_from(*d, indices, n);
+    }
+
+    // Number of versions kept by snapshot
+    size_t versions_n() const
+    {
+        return versions.size();
+    }
+
+    // Number of stored nodes, shared ones counted once
+    size_t size() const
+    {
+        return nodes.size();
+    }
+
+private:
+    // Blocks hashed in parallel chunks, the lanes of Hash filled within a chunk
+    static void hash_level(Digest *digests, const void *blocks, size_t n)
+    {
+        static constexpr size_t CHUNK = 1024;
+
+#pragma omp parallel for schedule(static) if (n > CHUNK)
+        for (size_t i = 0; i < n; i += CHUNK)
+            hash_oneblock_many<Hash>(digests[i].data(),
+                                     (const uint8_t *)blocks + i * Hash::BLOCK_SIZE,
+                                     std::min(CHUNK, n - i));
+    }
+
+    // Stores the node at level l unless it exists, the references of its children move to it
+    void intern(const Digest &digest, const Children &children, size_t l)
+    {
+        Node *node = nodes.find({digest, l});
+
+        if (!node)
+        {
+            nodes.insert_or_assign({digest, l}, Node{children, 1});
+            return;
+        }
+
+        ++node->refs;
+        for (const Digest &child : children)
+            unref(child, l - 1);
+    }
+
+    void ref(const Digest &digest, size_t l)
+    {
+        if (l == 0)
+            return;
+
+        if (Node *node = nodes.find({digest, l}))
+            ++node->refs;
+        else
+            std::cerr << "VersionedMTree: Missing node\n";
+    }
+
+    void unref(const Digest &digest, size_t l)
+    {
+        if (l == 0)
+            return;
+
+        Node *node = nodes.find({digest, l});
+
+        if (!node)
+        {
+            std::cerr << "VersionedMTree: Missing node\n";
+            return;
+        }
+
+        if (--node->refs > 0)
+            return;
+
+        // erasing moves entries around, the children are read before
+        const Children children = node->children;
+
+        nodes.erase({digest, l});
+        for (const Digest &child : children)
+            unref(child, l - 1);
+    }
+
+    // Children of the stored node at level l, nullptr if it is missing
+    const Children *children_of(const Digest &digest, size_t l) const
+    {
+        const Node *node = nodes.find({digest, l});
+
+        if (!node)
+        {
+            std::cerr << "VersionedMTree: Missing node\n";
+            return nullptr;
+        }
+
+        return &node->children;
+    }
+
+    std::vector<Digest> paths_from(const Digest &top, const size_t *indices, size_t n) const
+    {
+        for (size_t i = 0; i < n; ++i)
+            if (indices[i] >= LEAVES_N)
+            {
+                std::cerr << "VersionedMTree: Bad leaf index\n";
+                return {};
+            }
+
+        std::vector<Digest> out(n * PATH_N);
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            const Digest *digest = &top;
+
+            // down from the root, the siblings of level l - 1 go to the l - 1 slot of the path
+            for (size_t l = height - 1; l > 0; --l)
+            {
+                const Children *node = children_of(*digest, l);
+
+                if (!node)
+                    return {};
+
+                const Children &children = *node;
+                const size_t c = indices[i] / pow(ARITY, l - 1) % ARITY;
+                Digest *dst = out.data() + i * PATH_N + (l - 1) * (ARITY - 1);
+
+                dst = std::copy(children.begin(), children.begin() + c, dst);
+                std::copy(children.begin() + c + 1, children.end(), dst);
+                digest = &children[c];
+            }
+        }
+
+        return out;
+    }
+};
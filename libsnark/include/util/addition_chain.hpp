@@ -0,0 +1,252 @@
+#pragma once
+
+#include "util/constants.hpp"
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+/*
+Compile-time addition chains for fixed exponents.
+The exponent is scanned with a left-to-right sliding window, the window size is chosen to
+minimize the number of multiplications, and the chain is emitted as straight-line code: a table
+of odd powers followed by one unrolled squaring or multiplication per step.
+*/
+
+// (p - 1) mod d, p is odd so p - 1 does not borrow
+template<uint64_t d, size_t n>
+constexpr uint64_t order_mod(std::array<uint64_t, n> p)
+{
+    using u128 = unsigned __int128;
+
+    uint64_t r = 0;
+
+    p[0] -= 1;
+    for (size_t i = n; i-- > 0;)
+        r = (uint64_t)((((u128)r << 64) | p[i]) % d);
+
+    return r;
+}
+
+// Whether x^d is a permutation of the field, that is gcd(d, p - 1) = 1
+template<uint64_t d, size_t n>
+constexpr bool exponent_is_invertible(const std::array<uint64_t, n> &p)
+{
+    uint64_t a = d;
+    uint64_t b = order_mod<d>(p);
+
+    while (b != 0)
+        a = std::exchange(b, a % b);
+
+    return a == 1;
+}
+
+// d^-1 mod (p - 1), not a constant expression if gcd(d, p - 1) is not 1
+template<uint64_t d, size_t n>
+constexpr std::array<uint64_t, n> inverse_exponent(std::array<uint64_t, n> p)
+{
+    using u128 = unsigned __int128;
+
+    std::array<uint64_t, n + 1> t{};
+    std::array<uint64_t, n> e{};
+    const uint64_t r0 = order_mod<d>(p);
+    uint64_t r = 0;
+    uint64_t k = 1;
+
+    // k * (p - 1) + 1 = 0 (mod d)
+    while (k < d && (k * r0 + 1) % d)
+        ++k;
+
+    if (k == d)
+        throw std::domain_error("inverse_exponent: d is not invertible mod p - 1");
+
+    p[0] -= 1;
+
+    uint64_t carry = 1;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        u128 s = (u128)p[i] * k + carry;
+        t[i] = (uint64_t)s;
+        carry = (uint64_t)(s >> 64);
+    }
+    t[n] = carry;
+
+    for (size_t i = n + 1; i-- > 0;)
+    {
+        u128 s = ((u128)r << 64) | t[i];
+
+        if (i < n)
+            e[i] = (uint64_t)(s / d);
+        r = (uint64_t)(s % d);
+    }
+
+    return e;
+}
+
+template<typename FieldT, uint64_t d>
+struct InverseExponent
+{
+    static_assert(exponent_is_invertible<d>(FieldModulus<FieldT>::value),
+                  "InverseExponent: x^d has no inverse in this field");
+
+    static constexpr auto value = inverse_exponent<d>(FieldModulus<FieldT>::value);
+};
+
+template<typename Exponent>
+class AdditionChain
+{
+public:
+    static constexpr auto E = Exponent::value;
+    static constexpr size_t BITS_N = E.size() * 64;
+
+private:
+    struct Plan
+    {
+        size_t start;  // index of the odd power the accumulator starts from
+        size_t table;  // number of odd powers x, x^3, x^5, ... that are used
+        size_t steps;  // squarings and multiplications after the start
+        size_t cost;   // total multiplications, table included
+    };
+
+    static constexpr bool bit(size_t i)
+    {
+        return E[i / 64] >> (i % 64) & 1;
+    }
+
+    static constexpr size_t num_bits()
+    {
+        size_t i = BITS_N;
+
+        while (i > 0 && !bit(i - 1))
+            --i;
+
+        return i;
+    }
+
+    // Walks the exponent with window w and writes the steps if ops is not null
+    // Step 0 squares the accumulator, step k multiplies it by x^(2k - 1)
+    static constexpr Plan walk(size_t w, uint8_t *ops = nullptr)
+    {
+        Plan plan{0, 1, 0, 0};
+        bool first = true;
+
+        for (size_t i = num_bits(); i-- > 0;)
+        {
+            if (!bit(i))
+            {
+                if (ops)
+                    ops[plan.steps] = 0;
+                ++plan.steps;
+                continue;
+            }
+
+            // Longest window ending in a one
+            size_t l = i + 1 >= w ? i + 1 - w : 0;
+            size_t v = 0;
+
+            while (!bit(l))
+                ++l;
+
+            for (size_t j = i + 1; j-- > l;)
+                v = v << 1 | bit(j);
+
+            if (plan.table < v / 2 + 1)
+                plan.table = v / 2 + 1;
+
+            if (first)
+                plan.start = v / 2;
+            else
+            {
+                for (size_t j = l; j <= i; ++j)
+                {
+                    if (ops)
+                        ops[plan.steps] = 0;
+                    ++plan.steps;
+                }
+
+                if (ops)
+                    ops[plan.steps] = (uint8_t)(v / 2 + 1);
+                ++plan.steps;
+            }
+
+            first = false;
+            i = l;
+        }
+
+        // x^2, then one multiplication per odd power
+        plan.cost = plan.steps + (plan.table > 1 ? plan.table : 0);
+
+        return plan;
+    }
+
+    static constexpr size_t best_window()
+    {
+        size_t best = 1;
+
+        for (size_t w = 2; w <= 8; ++w)
+            if (walk(w).cost < walk(best).cost)
+                best = w;
+
+        return best;
+    }
+
+public:
+    static constexpr size_t WINDOW = best_window();
+    static constexpr Plan PLAN = walk(WINDOW);
+    static constexpr size_t TABLE_N = PLAN.table;
+    static constexpr size_t STEPS_N = PLAN.steps;
+    static constexpr size_t COST = PLAN.cost;
+
+private:
+    static constexpr std::array<uint8_t, STEPS_N> steps()
+    {
+        std::array<uint8_t, STEPS_N> ops{};
+
+        walk(WINDOW, ops.data());
+
+        return ops;
+    }
+
+    static constexpr std::array<uint8_t, STEPS_N> STEPS = steps();
+
+    template<uint8_t op, typename T>
+    static inline void step(T &x, const std::array<T, TABLE_N> &t)
+    {
+        if constexpr (op == 0)
+            x *= x;
+        else
+            x *= t[op - 1];
+    }
+
+    template<typename T, size_t... I>
+    static inline void run(T &x, const std::array<T, TABLE_N> &t, std::index_sequence<I...>)
+    {
+        (step<STEPS[I]>(x, t), ...);
+    }
+
+public:
+    template<typename T>
+    static void pow(T &x)
+    {
+        std::array<T, TABLE_N> t;
+
+        // Odd powers x, x^3, x^5, ...
+        t[0] = x;
+        if constexpr (TABLE_N > 1)
+        {
+            T x2{x};
+
+            x2 *= x;
+            for (size_t i = 1; i < TABLE_N; ++i)
+            {
+                t[i] = t[i - 1];
+                t[i] *= x2;
+            }
+        }
+
+        x = t[PLAN.start];
+        run(x, t, std::make_index_sequence<STEPS_N>{});
+    }
+};
@@ -1,7 +1,13 @@
 #pragma once
 
+#ifdef _WIN32
+    #include <intrin.h>
+#else
+    #include <x86intrin.h>
+#endif
 #include <array>
 #include <cstddef>
+#include <cstring>
 #include <gmpxx.h>
 #include <libff/common/default_types/ec_pp.hpp>
 #include <utility>
@@ -12,46 +18,87 @@ constexpr size_t field_size()
     return FieldT::num_limbs * sizeof(mp_limb_t);
 }
 
-template<typename FieldT>
-mpz_class field_to_mpz(const FieldT &x)
+template<mp_size_t n>
+void bigint_from_bytes(libff::bigint<n> &x, const void *bytes, size_t sz = n * sizeof(mp_limb_t))
 {
-    mpz_class x_mpz;
+    // Big-endian bytes to little-endian limbs, sz must not exceed the size of the bigint
+    const uint8_t *b = (const uint8_t *)bytes + sz;
+    mp_limb_t limb;
+    mp_size_t i = 0;
 
-    x.as_bigint().to_mpz(x_mpz.get_mpz_t());
+    for (; sz >= sizeof(mp_limb_t); ++i, sz -= sizeof(mp_limb_t))
+    {
+        b -= sizeof(mp_limb_t);
+        memcpy(&limb, b, sizeof(mp_limb_t));
+        x.data[i] = _bswap64(limb);
+    }
 
-    return x_mpz;
+    // Most significant partial limb
+    if (sz)
+    {
+        for (limb = 0, b -= sz; sz; --sz)
+            limb = limb << 8 | *b++;
+        x.data[i++] = limb;
+    }
+
+    for (; i < n; ++i)
+        x.data[i] = 0;
 }
 
-template<typename Bigint>
-mpz_class bigint_to_mpz(const Bigint &x)
+template<mp_size_t n>
+void bigint_to_bytes(void *bytes, const libff::bigint<n> &x, size_t sz = n * sizeof(mp_limb_t))
 {
-    mpz_class x_mpz;
+    // Little-endian limbs to fixed-width big-endian bytes, truncated to the low sz bytes
+    uint8_t *b = (uint8_t *)bytes + sz;
+    mp_limb_t limb;
+    mp_size_t i = 0;
 
-    x.to_mpz(x_mpz.get_mpz_t());
+    for (; sz >= sizeof(mp_limb_t); ++i, sz -= sizeof(mp_limb_t))
+    {
+        b -= sizeof(mp_limb_t);
+        limb = _bswap64(x.data[i]);
+        memcpy(b, &limb, sizeof(mp_limb_t));
+    }
 
-    return x_mpz;
+    for (limb = i < n ? x.data[i] : 0; sz; --sz, limb >>= 8)
+        *--b = (uint8_t)limb;
 }
 
 template<typename FieldT>
-int legendre(const FieldT &x)
+FieldT field_from_bytes(const void *bytes, size_t sz = field_size<FieldT>())
 {
-    static const auto p = bigint_to_mpz(FieldT::mod);
+    // Multiplying by R^2 in the constructor reduces any value below 2^(64 * n) into Montgomery form
+    libff::bigint<FieldT::num_limbs> x;
 
-    return mpz_legendre(field_to_mpz(x).get_mpz_t(), p.get_mpz_t());
+    bigint_from_bytes(x, bytes, sz);
+
+    return FieldT{x};
 }
 
 template<typename FieldT>
-std::pair<FieldT, FieldT> get_irreducible_pair(size_t max_trials = 32)
+void field_to_bytes(void *bytes, const FieldT &x, size_t sz = field_size<FieldT>())
 {
-    for (size_t i = 0; i < max_trials; ++i)
-    {
-        std::pair<FieldT, FieldT> ab{FieldT::random_element(), FieldT::random_element()};
+    bigint_to_bytes(bytes, x.as_bigint(), sz);
+}
 
-        if (legendre(ab.first.squared() - (ab.second + ab.second + ab.second + ab.second)) < 0)
-            return ab;
-    }
+template<typename FieldT>
+mpz_class field_to_mpz(const FieldT &x)
+{
+    mpz_class x_mpz;
 
-    return {0, 0};
+    x.as_bigint().to_mpz(x_mpz.get_mpz_t());
+
+    return x_mpz;
+}
+
+template<typename Bigint>
+mpz_class bigint_to_mpz(const Bigint &x)
+{
+    mpz_class x_mpz;
+
+    x.to_mpz(x_mpz.get_mpz_t());
+
+    return x_mpz;
 }
 
 template<typename FieldT>
@@ -98,16 +145,6 @@ FieldT inverse(const FieldT &x, const FieldT &modulus)
     return xb;
 }
 
-template<typename FieldT, size_t sz>
-static std::array<FieldT, sz> random_array()
-{
-    std::array<FieldT, sz> a;
-
-    std::generate(a.begin(), a.end(), []() { return FieldT::random_element(); });
-
-    return a;
-}
-
 namespace libff
 {
     template<mp_size_t n, const bigint<n> &m>
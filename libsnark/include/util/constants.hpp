@@ -0,0 +1,638 @@
+#pragma once
+
+#include "util/algebra.hpp"
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <iostream>
+#include <string_view>
+
+/*
+Deterministic derivation of hash constants.
+Every constant is squeezed from SHAKE128(domain || parameters || modulus) by rejection sampling
+and stored as Montgomery limbs, so the tables can be copied straight into Fp_model::mont_repr.
+When the modulus of a field is known at compile time (see FieldModulus) the whole derivation is
+a constant expression and the tables are baked into the binary, otherwise the same derivation
+runs once at static initialization with the modulus of the field, giving the same constants.
+*/
+
+constexpr uint64_t rotl64(uint64_t x, unsigned s)
+{
+    return s ? x << s | x >> (64 - s) : x;
+}
+
+constexpr void keccak_f1600(std::array<uint64_t, 25> &state)
+{
+    // Lane-walk formulation, plain arrays and tables keep it cheap for the constant evaluator
+    constexpr uint64_t RC[24] = {
+        0x0000000000000001, 0x0000000000008082, 0x800000000000808A, 0x8000000080008000,
+        0x000000000000808B, 0x0000000080000001, 0x8000000080008081, 0x8000000000008009,
+        0x000000000000008A, 0x0000000000000088, 0x0000000080008009, 0x000000008000000A,
+        0x000000008000808B, 0x800000000000008B, 0x8000000000008089, 0x8000000000008003,
+        0x8000000000008002, 0x8000000000000080, 0x000000000000800A, 0x800000008000000A,
+        0x8000000080008081, 0x8000000000008080, 0x0000000080000001, 0x8000000080008008};
+    // rho offsets and pi destinations along the walk starting at lane 1
+    constexpr unsigned ROT[24] = {1,  3,  6,  10, 15, 21, 28, 36, 45, 55, 2,  14,
+                                  27, 41, 56, 8,  25, 43, 62, 18, 39, 61, 20, 44};
+    constexpr unsigned PI[24] = {10, 7,  11, 17, 18, 3, 5,  16, 8,  21, 24, 4,
+                                 15, 23, 19, 13, 12, 2, 20, 14, 22, 9,  6,  1};
+    constexpr unsigned NEXT[6] = {1, 2, 3, 4, 0, 1};
+    uint64_t a[25]{};
+    uint64_t c[7]{};
+
+    for (size_t i = 0; i < 25; ++i)
+        a[i] = state[i];
+
+    for (size_t r = 0; r < 24; ++r)
+    {
+        // theta
+        for (size_t x = 0; x < 5; ++x)
+            c[x] = a[x] ^ a[x + 5] ^ a[x + 10] ^ a[x + 15] ^ a[x + 20];
+        c[5] = c[0];
+        c[6] = c[1];
+
+        for (size_t x = 0; x < 5; ++x)
+        {
+            uint64_t d = c[x + 4 - 5 * (x != 0)] ^ rotl64(c[x + 1], 1);
+
+            a[x] ^= d, a[x + 5] ^= d, a[x + 10] ^= d, a[x + 15] ^= d, a[x + 20] ^= d;
+        }
+
+        // rho and pi
+        uint64_t t = a[1];
+
+        for (size_t i = 0; i < 24; ++i)
+        {
+            uint64_t b = a[PI[i]];
+
+            a[PI[i]] = rotl64(t, ROT[i]);
+            t = b;
+        }
+
+        // chi
+        for (size_t y = 0; y < 25; y += 5)
+        {
+            for (size_t x = 0; x < 5; ++x)
+                c[x] = a[y + x];
+
+            for (size_t x = 0; x < 5; ++x)
+                a[y + x] = c[x] ^ (~c[NEXT[x]] & c[NEXT[x + 1]]);
+        }
+
+        // iota
+        a[0] ^= RC[r];
+    }
+
+    for (size_t i = 0; i < 25; ++i)
+        state[i] = a[i];
+}
+
+class Shake128
+{
+public:
+    static constexpr size_t RATE = 168;
+
+private:
+    std::array<uint64_t, 25> a{};
+    size_t pos = 0;
+    bool squeezing = false;
+
+public:
+    constexpr void absorb(uint8_t byte)
+    {
+        a[pos / 8] ^= (uint64_t)byte << 8 * (pos % 8);
+
+        if (++pos == RATE)
+        {
+            keccak_f1600(a);
+            pos = 0;
+        }
+    }
+
+    constexpr void absorb(std::string_view s)
+    {
+        for (char ch : s)
+            absorb((uint8_t)ch);
+    }
+
+    constexpr void absorb_u64(uint64_t x)
+    {
+        // Little-endian, like the lanes of the state
+        for (size_t i = 0; i < 8; ++i, x >>= 8)
+            absorb((uint8_t)x);
+    }
+
+    constexpr uint8_t squeeze()
+    {
+        if (!squeezing || pos == RATE)
+            permute();
+
+        uint8_t byte = a[pos / 8] >> 8 * (pos % 8);
+        ++pos;
+
+        return byte;
+    }
+
+    constexpr uint64_t squeeze_u64()
+    {
+        uint64_t x = 0;
+
+        if (pos % 8)
+        {
+            for (size_t i = 0; i < 8; ++i)
+                x |= (uint64_t)squeeze() << 8 * i;
+
+            return x;
+        }
+
+        // Whole lanes, the rate is a multiple of 8 bytes
+        if (!squeezing || pos == RATE)
+            permute();
+
+        x = a[pos / 8];
+        pos += 8;
+
+        return x;
+    }
+
+private:
+    constexpr void permute()
+    {
+        if (!squeezing)
+        {
+            // SHAKE domain separation and pad10*1
+            a[pos / 8] ^= (uint64_t)0x1F << 8 * (pos % 8);
+            a[(RATE - 1) / 8] ^= (uint64_t)0x80 << 8 * ((RATE - 1) % 8);
+            squeezing = true;
+        }
+
+        keccak_f1600(a);
+        pos = 0;
+    }
+};
+
+template<size_t n>
+class ConstantStream
+{
+public:
+    using Limbs = std::array<uint64_t, n>;
+
+private:
+    using u128 = unsigned __int128;
+
+    Limbs p;
+    Limbs r2;
+    uint64_t inv;
+    uint64_t top_mask;
+    Shake128 shake;
+
+    static constexpr bool less(const Limbs &x, const Limbs &y)
+    {
+        for (size_t i = n; i-- > 0;)
+            if (x[i] != y[i])
+                return x[i] < y[i];
+
+        return false;
+    }
+
+    static constexpr bool is_zero(const Limbs &x)
+    {
+        for (size_t i = 0; i < n; ++i)
+            if (x[i])
+                return false;
+
+        return true;
+    }
+
+    static constexpr uint64_t sub(Limbs &x, const Limbs &y)
+    {
+        uint64_t borrow = 0;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            u128 d = (u128)x[i] - y[i] - borrow;
+            x[i] = (uint64_t)d;
+            borrow = (uint64_t)(d >> 64) & 1;
+        }
+
+        return borrow;
+    }
+
+    constexpr Limbs add_mod(Limbs x, const Limbs &y) const
+    {
+        uint64_t carry = 0;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            u128 s = (u128)x[i] + y[i] + carry;
+            x[i] = (uint64_t)s;
+            carry = (uint64_t)(s >> 64);
+        }
+
+        if (carry || !less(x, p))
+            sub(x, p);
+
+        return x;
+    }
+
+    constexpr Limbs sub_mod(Limbs x, const Limbs &y) const
+    {
+        if (sub(x, y))
+        {
+            uint64_t carry = 0;
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                u128 s = (u128)x[i] + p[i] + carry;
+                x[i] = (uint64_t)s;
+                carry = (uint64_t)(s >> 64);
+            }
+        }
+
+        return x;
+    }
+
+    constexpr Limbs mont_mul(const Limbs &x, const Limbs &y) const
+    {
+        // CIOS Montgomery multiplication, x * y / R mod p
+        uint64_t t[n + 2]{};
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            uint64_t carry = 0;
+            u128 s = 0;
+
+            for (size_t j = 0; j < n; ++j)
+            {
+                s = (u128)x[j] * y[i] + t[j] + carry;
+                t[j] = (uint64_t)s;
+                carry = (uint64_t)(s >> 64);
+            }
+            s = (u128)t[n] + carry;
+            t[n] = (uint64_t)s;
+            t[n + 1] = (uint64_t)(s >> 64);
+
+            uint64_t m = t[0] * inv;
+
+            s = (u128)m * p[0] + t[0];
+            carry = (uint64_t)(s >> 64);
+            for (size_t j = 1; j < n; ++j)
+            {
+                s = (u128)m * p[j] + t[j] + carry;
+                t[j - 1] = (uint64_t)s;
+                carry = (uint64_t)(s >> 64);
+            }
+            s = (u128)t[n] + carry;
+            t[n - 1] = (uint64_t)s;
+            t[n] = t[n + 1] + (uint64_t)(s >> 64);
+        }
+
+        Limbs z{};
+
+        for (size_t i = 0; i < n; ++i)
+            z[i] = t[i];
+
+        if (t[n] || !less(z, p))
+            sub(z, p);
+
+        return z;
+    }
+
+    constexpr int jacobi(const Limbs &a) const
+    {
+        // Binary Jacobi symbol (a / p) for a < p, only the significant limbs are touched
+        uint64_t x[n]{};
+        uint64_t m[n]{};
+        size_t xn = 0;
+        size_t mn = n;
+        int j = 1;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            x[i] = a[i];
+            m[i] = p[i];
+            if (x[i])
+                xn = i + 1;
+        }
+
+        while (xn)
+        {
+            // Remove all the factors of two at once
+            size_t z = 0;
+
+            while (!x[z])
+                ++z;
+
+            unsigned s = __builtin_ctzll(x[z]);
+
+            for (size_t i = 0; i < xn; ++i)
+            {
+                size_t k = i + z;
+
+                x[i] = k < xn ? x[k] >> s | (s && k + 1 < xn ? x[k + 1] << (64 - s) : 0) : 0;
+            }
+            while (xn && !x[xn - 1])
+                --xn;
+
+            if ((z * 64 + s) & 1 && ((m[0] & 7) == 3 || (m[0] & 7) == 5))
+                j = -j;
+
+            // Both are odd, swap them by quadratic reciprocity to keep x >= m
+            bool swap = xn < mn;
+
+            for (size_t i = xn; i-- > 0 && xn == mn;)
+                if (x[i] != m[i])
+                {
+                    swap = x[i] < m[i];
+                    break;
+                }
+
+            if (swap)
+            {
+                for (size_t i = 0; i < mn; ++i)
+                {
+                    uint64_t t = x[i];
+
+                    x[i] = m[i];
+                    m[i] = t;
+                }
+
+                size_t t = xn;
+
+                xn = mn;
+                mn = t;
+
+                if ((x[0] & 3) == 3 && (m[0] & 3) == 3)
+                    j = -j;
+            }
+
+            uint64_t borrow = 0;
+
+            for (size_t i = 0; i < xn; ++i)
+            {
+                u128 d = (u128)x[i] - (i < mn ? m[i] : 0) - borrow;
+                x[i] = (uint64_t)d;
+                borrow = (uint64_t)(d >> 64) & 1;
+            }
+            while (xn && !x[xn - 1])
+                --xn;
+        }
+
+        return mn == 1 && m[0] == 1 ? j : 0;
+    }
+
+    constexpr Limbs sample()
+    {
+        // Uniform in [1, p) by rejection, limbs are squeezed least significant first
+        Limbs x{};
+
+        do
+        {
+            for (size_t i = 0; i < n; ++i)
+                x[i] = shake.squeeze_u64();
+            x[n - 1] &= top_mask;
+        } while (is_zero(x) || !less(x, p));
+
+        return x;
+    }
+
+public:
+    constexpr ConstantStream(const Limbs &p, std::string_view domain,
+                             std::initializer_list<size_t> params) :
+        p{p}, r2{}, inv{1}, top_mask{~0ULL}, shake{}
+    {
+        // -p^-1 mod 2^64 by Newton iteration
+        for (size_t i = 0; i < 6; ++i)
+            inv *= 2 - p[0] * inv;
+        inv = -inv;
+
+        while (top_mask && top_mask >> 1 >= p[n - 1])
+            top_mask >>= 1;
+
+        // R^2 mod p by doubling 1 (2 * 64 * n) times
+        r2[0] = 1;
+        for (size_t i = 0; i < 2 * 64 * n; ++i)
+            r2 = add_mod(r2, r2);
+
+        shake.absorb(domain);
+        for (size_t x : params)
+            shake.absorb_u64(x);
+        for (size_t i = 0; i < n; ++i)
+            shake.absorb_u64(p[i]);
+    }
+
+    // Next nonzero element, in Montgomery form
+    constexpr Limbs element()
+    {
+        return mont_mul(sample(), r2);
+    }
+
+    // Next pair (a, b) such that x^2 + a*x + b is irreducible, in Montgomery form
+    constexpr std::array<Limbs, 2> irreducible_pair()
+    {
+        Limbs one{1};
+
+        while (true)
+        {
+            Limbs a{element()};
+            Limbs b{element()};
+            Limbs b4{add_mod(b, b)};
+
+            b4 = add_mod(b4, b4);
+
+            // a^2 - 4b must be a quadratic non-residue
+            if (jacobi(mont_mul(sub_mod(mont_mul(a, a), b4), one)) < 0)
+                return {a, b};
+        }
+    }
+
+    template<size_t N>
+    constexpr std::array<Limbs, N> elements()
+    {
+        std::array<Limbs, N> x{};
+
+        for (size_t i = 0; i < N; ++i)
+            x[i] = element();
+
+        return x;
+    }
+
+    template<size_t N>
+    constexpr std::array<std::array<Limbs, 2>, N> irreducible_pairs()
+    {
+        std::array<std::array<Limbs, 2>, N> x{};
+
+        for (size_t i = 0; i < N; ++i)
+            x[i] = irreducible_pair();
+
+        return x;
+    }
+};
+
+// Moduli known at compile time, the tables of any other field are derived at startup
+template<typename FieldT>
+struct FieldModulus
+{
+    static constexpr bool known = false;
+};
+
+#if defined(CURVE_ALT_BN128) || defined(CURVE_BN128)
+template<>
+struct FieldModulus<libff::Fq<libff::default_ec_pp>>
+{
+    static constexpr bool known = true;
+    static constexpr std::array<uint64_t, 4> value{0x3c208c16d87cfd47, 0x97816a916871ca8d,
+                                                   0xb85045b68181585d, 0x30644e72e131a029};
+};
+
+template<>
+struct FieldModulus<libff::Fr<libff::default_ec_pp>>
+{
+    static constexpr bool known = true;
+    static constexpr std::array<uint64_t, 4> value{0x43e1f593f0000001, 0x2833e84879b97091,
+                                                   0xb85045b68181585d, 0x30644e72e131a029};
+};
+#elif defined(CURVE_BLS12_381)
+template<>
+struct FieldModulus<libff::Fq<libff::default_ec_pp>>
+{
+    static constexpr bool known = true;
+    static constexpr std::array<uint64_t, 6> value{0xb9feffffffffaaab, 0x1eabfffeb153ffff,
+                                                   0x6730d2a0f6b0f624, 0x64774b84f38512bf,
+                                                   0x4b1ba7b6434bacd7, 0x1a0111ea397fe69a};
+};
+
+template<>
+struct FieldModulus<libff::Fr<libff::default_ec_pp>>
+{
+    static constexpr bool known = true;
+    static constexpr std::array<uint64_t, 4> value{0xffffffff00000001, 0x53bda402fffe5bfe,
+                                                   0x3339d80809a1d805, 0x73eda753299d7d48};
+};
+#elif defined(CURVE_MNT4)
+template<>
+struct FieldModulus<libff::Fq<libff::default_ec_pp>>
+{
+    static constexpr bool known = true;
+    static constexpr std::array<uint64_t, 5> value{0xc90cd65a71660001, 0x41a9e35e51200e12,
+                                                   0xcaeec9635d1330ea, 0xa266249da7b0548e,
+                                                   0x000003bcf7bcd473};
+};
+
+template<>
+struct FieldModulus<libff::Fr<libff::default_ec_pp>>
+{
+    static constexpr bool known = true;
+    static constexpr std::array<uint64_t, 5> value{0xbb4334a400000001, 0xfb494c07925d6ad3,
+                                                   0xcaeec9635cf44194, 0xa266249da7b0548e,
+                                                   0x000003bcf7bcd473};
+};
+#elif defined(CURVE_MNT6)
+template<>
+struct FieldModulus<libff::Fq<libff::default_ec_pp>>
+{
+    static constexpr bool known = true;
+    static constexpr std::array<uint64_t, 5> value{0xbb4334a400000001, 0xfb494c07925d6ad3,
+                                                   0xcaeec9635cf44194, 0xa266249da7b0548e,
+                                                   0x000003bcf7bcd473};
+};
+
+template<>
+struct FieldModulus<libff::Fr<libff::default_ec_pp>>
+{
+    static constexpr bool known = true;
+    static constexpr std::array<uint64_t, 5> value{0xc90cd65a71660001, 0x41a9e35e51200e12,
+                                                   0xcaeec9635d1330ea, 0xa266249da7b0548e,
+                                                   0x000003bcf7bcd473};
+};
+#elif defined(CURVE_EDWARDS)
+template<>
+struct FieldModulus<libff::Fq<libff::default_ec_pp>>
+{
+    static constexpr bool known = true;
+    static constexpr std::array<uint64_t, 3> value{0xb6eb690b80000001, 0x138b924ed6342d41,
+                                                   0x0040d5fc9d2a395b};
+};
+
+template<>
+struct FieldModulus<libff::Fr<libff::default_ec_pp>>
+{
+    static constexpr bool known = true;
+    static constexpr std::array<uint64_t, 3> value{0x1de5532780000001, 0xc4e2e493b92e12cc,
+                                                   0x0010357f274a8e56};
+};
+#endif
+
+template<typename FieldT>
+std::array<uint64_t, FieldT::num_limbs> field_modulus_limbs()
+{
+    std::array<uint64_t, FieldT::num_limbs> p;
+
+    for (size_t i = 0; i < p.size(); ++i)
+        p[i] = FieldT::mod.data[i];
+
+    return p;
+}
+
+// Tables of Hash::derive_constants, computed at compile time whenever the modulus is known
+template<typename Hash, typename FieldT = typename Hash::Field>
+const auto &hash_constants()
+{
+    auto runtime = []() { return Hash::derive_constants(field_modulus_limbs<FieldT>()); };
+
+    if constexpr (FieldModulus<FieldT>::known)
+    {
+        static constexpr auto table = Hash::derive_constants(FieldModulus<FieldT>::value);
+        static const bool valid = FieldModulus<FieldT>::value == field_modulus_limbs<FieldT>();
+
+        if (valid)
+            return table;
+
+        std::cerr << "hash_constants: Unexpected field modulus, deriving constants at runtime\n";
+        static const auto fallback = runtime();
+
+        return fallback;
+    }
+    else
+    {
+        static const auto table = runtime();
+
+        return table;
+    }
+}
+
+template<typename FieldT>
+FieldT field_from_mont(const std::array<uint64_t, FieldT::num_limbs> &x)
+{
+    FieldT f;
+
+    for (size_t i = 0; i < x.size(); ++i)
+        f.mont_repr.data[i] = x[i];
+
+    return f;
+}
+
+template<typename FieldT, size_t N>
+std::array<FieldT, N> fields_from_mont(
+    const std::array<std::array<uint64_t, FieldT::num_limbs>, N> &x)
+{
+    std::array<FieldT, N> f;
+
+    for (size_t i = 0; i < N; ++i)
+        f[i] = field_from_mont<FieldT>(x[i]);
+
+    return f;
+}
+
+template<typename FieldT, size_t N>
+std::array<std::pair<FieldT, FieldT>, N> field_pairs_from_mont(
+    const std::array<std::array<std::array<uint64_t, FieldT::num_limbs>, 2>, N> &x)
+{
+    std::array<std::pair<FieldT, FieldT>, N> f;
+
+    for (size_t i = 0; i < N; ++i)
+        f[i] = {field_from_mont<FieldT>(x[i][0]), field_from_mont<FieldT>(x[i][1])};
+
+    return f;
+}
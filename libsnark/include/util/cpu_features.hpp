@@ -0,0 +1,91 @@
+#pragma once
+
+#ifndef _WIN32
+    #include <cpuid.h>
+#else
+    #include <intrin.h>
+#endif
+#include <cinttypes>
+
+/*
+Instruction set extensions of the host, detected once at startup.
+Kernels for newer extensions are compiled with target attributes instead of -march flags, so a
+single portable build carries every version and picks the best one the host supports.
+*/
+
+#if defined(__GNUC__)
+    #define TARGET_AVX2 __attribute__((target("avx2")))
+    #define TARGET_AVX512 __attribute__((target("avx512f")))
+    #define TARGET_SHA __attribute__((target("sha,sse4.1")))
+    // For generic kernels that are only built inside one of the targets above
+    #define KERNEL_INLINE __attribute__((always_inline)) inline
+#else
+    #define TARGET_AVX2
+    #define TARGET_AVX512
+    #define TARGET_SHA
+    #define KERNEL_INLINE inline
+#endif
+
+struct CpuFeatures
+{
+    bool avx2 = false;
+    bool avx512f = false;
+    bool sha = false;
+
+    static CpuFeatures detect()
+    {
+        CpuFeatures f;
+        uint32_t r[4]{};
+
+        cpuid(r, 0, 0);
+        if (r[0] < 7)
+            return f;
+
+        cpuid(r, 1, 0);
+        bool osxsave = r[2] >> 27 & 1;
+        bool sse41 = r[2] >> 19 & 1;
+        uint64_t xcr0 = osxsave ? xgetbv() : 0;
+
+        // The OS must save the vector registers too, YMM state for AVX2, ZMM and masks for AVX-512
+        bool ymm = (xcr0 & 0x06) == 0x06;
+        bool zmm = (xcr0 & 0xe6) == 0xe6;
+
+        cpuid(r, 7, 0);
+        f.avx2 = ymm && (r[1] >> 5 & 1);
+        f.avx512f = zmm && (r[1] >> 16 & 1);
+        f.sha = sse41 && (r[1] >> 29 & 1);
+
+        return f;
+    }
+
+private:
+    static void cpuid(uint32_t r[4], uint32_t leaf, uint32_t subleaf)
+    {
+#ifdef _WIN32
+        __cpuidex((int *)r, (int)leaf, (int)subleaf);
+#else
+        __cpuid_count(leaf, subleaf, r[0], r[1], r[2], r[3]);
+#endif
+    }
+
+    static uint64_t xgetbv()
+    {
+#ifdef _WIN32
+        return _xgetbv(0);
+#else
+        uint32_t lo;
+        uint32_t hi;
+
+        asm("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+
+        return (uint64_t)hi << 32 | lo;
+#endif
+    }
+};
+
+inline const CpuFeatures &cpu_features()
+{
+    static const CpuFeatures features{CpuFeatures::detect()};
+
+    return features;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+template<typename FieldT, size_t lanes>
+struct FieldLanes
+{
+    /* FieldLanes
+    * Structure-of-arrays pack of independent field elements.
+    * Every operator is applied lane by lane, so a permutation written once for a single element
+    * can be instantiated on a pack and run several independent states in lockstep. Consecutive
+    * lane operations do not depend on each other, which breaks the long dependency chain of
+    * modular multiplications of a single permutation and lets the core overlap them.
+    */
+    using Field = FieldT;
+
+    static constexpr size_t LANES_N = lanes;
+
+    std::array<Field, LANES_N> v;
+
+    FieldLanes() = default;
+
+    // Broadcast a single element to all lanes
+    FieldLanes(const Field &x) { v.fill(x); }
+
+    Field &operator[](size_t i) { return v[i]; }
+    const Field &operator[](size_t i) const { return v[i]; }
+
+    FieldLanes &operator+=(const FieldLanes &x)
+    {
+        for (size_t i = 0; i < LANES_N; ++i)
+            v[i] += x.v[i];
+
+        return *this;
+    }
+
+    FieldLanes &operator-=(const FieldLanes &x)
+    {
+        for (size_t i = 0; i < LANES_N; ++i)
+            v[i] -= x.v[i];
+
+        return *this;
+    }
+
+    FieldLanes &operator*=(const FieldLanes &x)
+    {
+        for (size_t i = 0; i < LANES_N; ++i)
+            v[i] *= x.v[i];
+
+        return *this;
+    }
+
+    FieldLanes &operator+=(const Field &x)
+    {
+        for (size_t i = 0; i < LANES_N; ++i)
+            v[i] += x;
+
+        return *this;
+    }
+
+    FieldLanes &operator-=(const Field &x)
+    {
+        for (size_t i = 0; i < LANES_N; ++i)
+            v[i] -= x;
+
+        return *this;
+    }
+
+    FieldLanes &operator*=(const Field &x)
+    {
+        for (size_t i = 0; i < LANES_N; ++i)
+            v[i] *= x;
+
+        return *this;
+    }
+
+    template<typename Bigint>
+    FieldLanes &operator^=(const Bigint &e)
+    {
+        // Left-to-right square and multiply, all lanes share the same exponent bits
+        FieldLanes r{Field{1}};
+
+        for (size_t i = e.num_bits(); i-- > 0;)
+        {
+            r *= r;
+            if (e.test_bit(i))
+                r *= *this;
+        }
+
+        return *this = r;
+    }
+
+    friend FieldLanes operator+(FieldLanes x, const FieldLanes &y) { return x += y; }
+    friend FieldLanes operator-(FieldLanes x, const FieldLanes &y) { return x -= y; }
+    friend FieldLanes operator*(FieldLanes x, const FieldLanes &y) { return x *= y; }
+    friend FieldLanes operator+(FieldLanes x, const Field &y) { return x += y; }
+    friend FieldLanes operator-(FieldLanes x, const Field &y) { return x -= y; }
+    friend FieldLanes operator*(FieldLanes x, const Field &y) { return x *= y; }
+    friend FieldLanes operator+(const Field &x, FieldLanes y) { return y += x; }
+    friend FieldLanes operator*(const Field &x, FieldLanes y) { return y *= x; }
+};
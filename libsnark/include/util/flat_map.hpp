@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// splitmix64 finalizer, spreads every input bit over the whole word
+inline uint64_t mix64(uint64_t h)
+{
+    h = (h ^ h >> 30) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ h >> 27) * 0x94d049bb133111ebULL;
+
+    return h ^ h >> 31;
+}
+
+struct IntHash
+{
+    uint64_t operator()(uint64_t key) const { return mix64(key); }
+};
+
+/*
+Open addressing hash map with linear probing, entries are stored inline in a single array.
+Erasing shifts the following entries of the probe sequence back instead of leaving tombstones,
+so lookups never scan deleted slots and the table only grows with live entries.
+Hasher is a callable returning a well mixed uint64_t for a Key, IntHash for integer keys.
+*/
+template<typename Key, typename Value, typename Hasher = IntHash>
+class FlatMap
+{
+    struct Slot
+    {
+        Key key;
+        Value value;
+        bool used = false;
+    };
+
+    std::vector<Slot> slots{};
+    size_t count = 0;
+
+public:
+    FlatMap() = default;
+
+    size_t size() const { return count; }
+
+    const Value *find(const Key &key) const
+    {
+        if (slots.empty())
+            return nullptr;
+
+        for (size_t i = home(key);; i = next(i))
+        {
+            if (!slots[i].used)
+                return nullptr;
+            if (slots[i].key == key)
+                return &slots[i].value;
+        }
+    }
+
+    Value *find(const Key &key)
+    {
+        return const_cast<Value *>(std::as_const(*this).find(key));
+    }
+
+    void insert_or_assign(const Key &key, const Value &value)
+    {
+        // keep the load below 3/4
+        if (4 * (count + 1) > 3 * slots.size())
+            grow();
+
+        size_t i = home(key);
+
+        for (; slots[i].used; i = next(i))
+            if (slots[i].key == key)
+            {
+                slots[i].value = value;
+                return;
+            }
+
+        slots[i] = {key, value, true};
+        ++count;
+    }
+
+    void erase(const Key &key)
+    {
+        if (slots.empty())
+            return;
+
+        size_t i = home(key);
+
+        for (;; i = next(i))
+        {
+            if (!slots[i].used)
+                return;
+            if (slots[i].key == key)
+                break;
+        }
+
+        // move back every later entry of the run that may not sit past the hole
+        for (size_t j = next(i);; j = next(j))
+        {
+            if (!slots[j].used)
+                break;
+
+            size_t h = home(slots[j].key);
+
+            if (((j - h) & mask()) >= ((j - i) & mask()))
+            {
+                slots[i] = std::move(slots[j]);
+                i = j;
+            }
+        }
+
+        slots[i].used = false;
+        --count;
+    }
+
+private:
+    size_t mask() const { return slots.size() - 1; }
+    size_t home(const Key &key) const { return Hasher{}(key) & mask(); }
+    size_t next(size_t i) const { return (i + 1) & mask(); }
+
+    void grow()
+    {
+        std::vector<Slot> old(slots.empty() ? 16 : 2 * slots.size());
+
+        old.swap(slots);
+        count = 0;
+
+        for (Slot &s : old)
+            if (s.used)
+                insert_or_assign(s.key, s.value);
+    }
+};
@@ -0,0 +1,354 @@
+#pragma once
+
+#include "util/algebra.hpp"
+#include "util/constants.hpp"
+#include "util/field_lanes.hpp"
+
+#include <array>
+#include <cstdint>
+
+/*
+Lazily reduced accumulators for linear layers.
+Montgomery representations are linear, so sums and small multiples of mont_repr limbs can be
+accumulated without any modular reduction and reduced once at the end. FieldSum accumulates
+elements and small integer multiples of elements, FieldDot accumulates full products and does a
+single Montgomery reduction for the whole dot product.
+*/
+
+template<typename FieldT>
+struct LazyLimbs
+{
+    static constexpr size_t n = FieldT::num_limbs;
+
+    using u128 = unsigned __int128;
+
+    static const mp_limb_t *mod() { return FieldT::mod.data; }
+
+    // -p^-1 mod 2^64
+    static mp_limb_t inv()
+    {
+        if constexpr (FieldModulus<FieldT>::known)
+        {
+            constexpr mp_limb_t INV = []() {
+                mp_limb_t p0 = FieldModulus<FieldT>::value[0];
+                mp_limb_t x = 1;
+
+                for (size_t i = 0; i < 6; ++i)
+                    x *= 2 - p0 * x;
+
+                return -x;
+            }();
+
+            return INV;
+        }
+        else
+        {
+            mp_limb_t x = 1;
+
+            for (size_t i = 0; i < 6; ++i)
+                x *= 2 - mod()[0] * x;
+
+            return -x;
+        }
+    }
+
+    // v[0..m) += x[0..k), k <= m
+    static void add(mp_limb_t *v, size_t m, const mp_limb_t *x, size_t k)
+    {
+        mp_limb_t carry = 0;
+
+        for (size_t i = 0; i < m; ++i)
+        {
+            u128 s = (u128)v[i] + (i < k ? x[i] : 0) + carry;
+            v[i] = (mp_limb_t)s;
+            carry = (mp_limb_t)(s >> 64);
+        }
+    }
+
+    // v[0..m) += c * x[0..n)
+    static void add_mul(mp_limb_t *v, size_t m, mp_limb_t c, const mp_limb_t *x)
+    {
+        mp_limb_t carry = 0;
+
+        for (size_t i = 0; i < m; ++i)
+        {
+            u128 s = (u128)v[i] + carry + (i < n ? (u128)c * x[i] : 0);
+            v[i] = (mp_limb_t)s;
+            carry = (mp_limb_t)(s >> 64);
+        }
+    }
+
+    // v[0..n] mod p into r
+    static void reduce(mp_limb_t *r, mp_limb_t *v)
+    {
+        const mp_limb_t *p = mod();
+
+        // The quotient estimated from the top limbs never exceeds the real one
+        if (v[n] || v[n - 1] >= p[n - 1])
+        {
+            u128 top = (u128)v[n] << 64 | v[n - 1];
+            mp_limb_t q = (mp_limb_t)(top / ((u128)p[n - 1] + 1));
+            mp_limb_t borrow = 0;
+            mp_limb_t carry = 0;
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                u128 qp = (u128)q * p[i] + carry;
+                carry = (mp_limb_t)(qp >> 64);
+
+                u128 d = (u128)v[i] - (mp_limb_t)qp - borrow;
+                v[i] = (mp_limb_t)d;
+                borrow = (mp_limb_t)(d >> 64) & 1;
+            }
+            v[n] -= carry + borrow;
+        }
+
+        while (v[n] || !less(v, p))
+        {
+            mp_limb_t borrow = 0;
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                u128 d = (u128)v[i] - p[i] - borrow;
+                v[i] = (mp_limb_t)d;
+                borrow = (mp_limb_t)(d >> 64) & 1;
+            }
+            v[n] -= borrow;
+        }
+
+        for (size_t i = 0; i < n; ++i)
+            r[i] = v[i];
+    }
+
+    static bool less(const mp_limb_t *x, const mp_limb_t *y)
+    {
+        for (size_t i = n; i-- > 0;)
+            if (x[i] != y[i])
+                return x[i] < y[i];
+
+        return false;
+    }
+};
+
+template<typename T>
+class FieldSum
+{
+    using L = LazyLimbs<T>;
+    using u128 = typename L::u128;
+
+    static constexpr size_t n = L::n;
+
+    mp_limb_t v[n + 1]{};
+
+public:
+    FieldSum() = default;
+
+    explicit FieldSum(const T &x) { L::add(v, n + 1, x.mont_repr.data, n); }
+
+    FieldSum &operator+=(const T &x)
+    {
+        L::add(v, n + 1, x.mont_repr.data, n);
+
+        return *this;
+    }
+
+    FieldSum &operator-=(const T &x)
+    {
+        // Add p - x instead, it is never negative
+        const mp_limb_t *p = L::mod();
+        mp_limb_t d[n];
+        mp_limb_t borrow = 0;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            u128 t = (u128)p[i] - x.mont_repr.data[i] - borrow;
+            d[i] = (mp_limb_t)t;
+            borrow = (mp_limb_t)(t >> 64) & 1;
+        }
+        L::add(v, n + 1, d, n);
+
+        return *this;
+    }
+
+    // += c * x for a small integer c
+    FieldSum &add_mul(uint64_t c, const T &x)
+    {
+        L::add_mul(v, n + 1, c, x.mont_repr.data);
+
+        return *this;
+    }
+
+    T reduce() const
+    {
+        mp_limb_t t[n + 1];
+        T r;
+
+        for (size_t i = 0; i <= n; ++i)
+            t[i] = v[i];
+        L::reduce(r.mont_repr.data, t);
+
+        return r;
+    }
+};
+
+template<typename T>
+class FieldDot
+{
+    using L = LazyLimbs<T>;
+    using u128 = typename L::u128;
+
+    static constexpr size_t n = L::n;
+
+    mp_limb_t v[2 * n + 1]{};
+
+public:
+    FieldDot() = default;
+
+    // += x * y, the product is kept double-width
+    FieldDot &add_mul(const T &x, const T &y)
+    {
+        const mp_limb_t *a = x.mont_repr.data;
+        const mp_limb_t *b = y.mont_repr.data;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            mp_limb_t carry = 0;
+
+            for (size_t j = 0; j < n; ++j)
+            {
+                u128 s = (u128)a[j] * b[i] + v[i + j] + carry;
+                v[i + j] = (mp_limb_t)s;
+                carry = (mp_limb_t)(s >> 64);
+            }
+
+            for (size_t k = i + n; carry && k <= 2 * n; ++k)
+            {
+                u128 s = (u128)v[k] + carry;
+                v[k] = (mp_limb_t)s;
+                carry = (mp_limb_t)(s >> 64);
+            }
+        }
+
+        return *this;
+    }
+
+    T reduce() const
+    {
+        const mp_limb_t *p = L::mod();
+        const mp_limb_t inv = L::inv();
+        mp_limb_t t[2 * n + 1];
+        T r;
+
+        for (size_t i = 0; i <= 2 * n; ++i)
+            t[i] = v[i];
+
+        // Bring the high half below p, subtracting p * R does not change the result
+        L::reduce(t + n, t + n);
+
+        // Single Montgomery reduction of the whole sum
+        for (size_t i = 0; i < n; ++i)
+        {
+            mp_limb_t m = t[i] * inv;
+            mp_limb_t carry = 0;
+
+            for (size_t j = 0; j < n; ++j)
+            {
+                u128 s = (u128)m * p[j] + t[i + j] + carry;
+                t[i + j] = (mp_limb_t)s;
+                carry = (mp_limb_t)(s >> 64);
+            }
+
+            for (size_t k = i + n; carry && k <= 2 * n; ++k)
+            {
+                u128 s = (u128)t[k] + carry;
+                t[k] = (mp_limb_t)s;
+                carry = (mp_limb_t)(s >> 64);
+            }
+        }
+
+        L::reduce(r.mont_repr.data, t + n);
+
+        return r;
+    }
+};
+
+// Lane-wise accumulators for FieldLanes
+template<typename FieldT, size_t lanes>
+class FieldSum<FieldLanes<FieldT, lanes>>
+{
+    using T = FieldLanes<FieldT, lanes>;
+
+    std::array<FieldSum<FieldT>, lanes> s{};
+
+public:
+    FieldSum() = default;
+
+    explicit FieldSum(const T &x)
+    {
+        for (size_t i = 0; i < lanes; ++i)
+            s[i] += x[i];
+    }
+
+    FieldSum &operator+=(const T &x)
+    {
+        for (size_t i = 0; i < lanes; ++i)
+            s[i] += x[i];
+
+        return *this;
+    }
+
+    FieldSum &operator-=(const T &x)
+    {
+        for (size_t i = 0; i < lanes; ++i)
+            s[i] -= x[i];
+
+        return *this;
+    }
+
+    FieldSum &add_mul(uint64_t c, const T &x)
+    {
+        for (size_t i = 0; i < lanes; ++i)
+            s[i].add_mul(c, x[i]);
+
+        return *this;
+    }
+
+    T reduce() const
+    {
+        T r;
+
+        for (size_t i = 0; i < lanes; ++i)
+            r[i] = s[i].reduce();
+
+        return r;
+    }
+};
+
+template<typename FieldT, size_t lanes>
+class FieldDot<FieldLanes<FieldT, lanes>>
+{
+    using T = FieldLanes<FieldT, lanes>;
+
+    std::array<FieldDot<FieldT>, lanes> s{};
+
+public:
+    FieldDot() = default;
+
+    FieldDot &add_mul(const FieldT &x, const T &y)
+    {
+        for (size_t i = 0; i < lanes; ++i)
+            s[i].add_mul(x, y[i]);
+
+        return *this;
+    }
+
+    T reduce() const
+    {
+        T r;
+
+        for (size_t i = 0; i < lanes; ++i)
+            r[i] = s[i].reduce();
+
+        return r;
+    }
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+/*
+Bounded lock-free ring that hands items back in sequence order.
+Item s lives in slot s % capacity. Any number of threads may fill distinct items concurrently and
+in any order, a single consumer takes them back as s = 0, 1, 2, ... Filling item s waits (the try
+call fails) until item s - capacity was released, so at most capacity items are in flight.
+
+Every slot has a sequence word: 2s when free for item s, 2s + 1 once item s is published.
+*/
+template<typename T>
+class OrderedRing
+{
+    struct Slot
+    {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t capacity;
+
+public:
+    // Every slot starts as a copy of init, e.g. a preallocated buffer
+    explicit OrderedRing(size_t capacity, const T &init = T{}) :
+        slots{new Slot[capacity]}, capacity{capacity}
+    {
+        for (size_t i = 0; i < capacity; ++i)
+        {
+            slots[i].seq.store(2 * i, std::memory_order_relaxed);
+            slots[i].value = init;
+        }
+    }
+
+    // Slot to fill with item s, nullptr while it still holds item s - capacity
+    T *try_claim(size_t s)
+    {
+        Slot &slot = slots[s % capacity];
+
+        return slot.seq.load(std::memory_order_acquire) == 2 * s ? &slot.value : nullptr;
+    }
+
+    void publish(size_t s)
+    {
+        slots[s % capacity].seq.store(2 * s + 1, std::memory_order_release);
+    }
+
+    // Item s, nullptr until it is published
+    const T *try_front(size_t s) const
+    {
+        const Slot &slot = slots[s % capacity];
+
+        return slot.seq.load(std::memory_order_acquire) == 2 * s + 1 ? &slot.value : nullptr;
+    }
+
+    void release(size_t s)
+    {
+        slots[s % capacity].seq.store(2 * (s + capacity), std::memory_order_release);
+    }
+};
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "util/cpu_features.hpp"
+
+#ifdef _WIN32
+    #include <intrin.h>
+#else
+    #include <x86intrin.h>
+#endif
+#include <cinttypes>
+#include <cstddef>
+
+/*
+Vector lanes of 32-bit and 64-bit words for multi-buffer hashing.
+Each lane holds one word of an independent message, so a compression function written once
+against these operations hashes LANES_N blocks at once. Loads gather word i of LANES_N blocks
+that are stride bytes apart, stores write the lanes to a plain array.
+Every operation carries the target attribute of its extension, a kernel built on them must be
+inlined into a function with the same target and only called when cpu_features() has it.
+*/
+
+struct U32x8
+{
+    using V = __m256i;
+    using Word = uint32_t;
+
+    static constexpr size_t LANES_N = 8;
+
+    TARGET_AVX2 static V set1(Word x) { return _mm256_set1_epi32((int)x); }
+    TARGET_AVX2 static V add(V x, V y) { return _mm256_add_epi32(x, y); }
+    TARGET_AVX2 static V xor3(V x, V y, V z) { return _mm256_xor_si256(_mm256_xor_si256(x, y), z); }
+    TARGET_AVX2 static V shr(V x, int n) { return _mm256_srli_epi32(x, n); }
+
+    TARGET_AVX2 static V ror(V x, int n)
+    {
+        return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+    }
+
+    TARGET_AVX2 static V ch(V e, V f, V g)
+    {
+        return _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+    }
+
+    TARGET_AVX2 static V maj(V a, V b, V c)
+    {
+        return _mm256_or_si256(_mm256_and_si256(a, b),
+                               _mm256_and_si256(c, _mm256_or_si256(a, b)));
+    }
+
+    // Big-endian word i of each block
+    TARGET_AVX2 static V load(const uint8_t *blocks, size_t i, size_t stride)
+    {
+        const __m256i idx = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                               _mm256_set1_epi32((int)stride));
+        const __m256i bswap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13,
+                                               12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14,
+                                               13, 12);
+
+        return _mm256_shuffle_epi8(
+            _mm256_i32gather_epi32((const int *)(blocks + i * sizeof(Word)), idx, 1), bswap);
+    }
+
+    TARGET_AVX2 static void store(Word *out, V x) { _mm256_storeu_si256((__m256i *)out, x); }
+};
+
+struct U64x4
+{
+    using V = __m256i;
+    using Word = uint64_t;
+
+    static constexpr size_t LANES_N = 4;
+
+    TARGET_AVX2 static V set1(Word x) { return _mm256_set1_epi64x((long long)x); }
+    TARGET_AVX2 static V add(V x, V y) { return _mm256_add_epi64(x, y); }
+    TARGET_AVX2 static V xor3(V x, V y, V z) { return _mm256_xor_si256(_mm256_xor_si256(x, y), z); }
+    TARGET_AVX2 static V shr(V x, int n) { return _mm256_srli_epi64(x, n); }
+
+    TARGET_AVX2 static V ror(V x, int n)
+    {
+        return _mm256_or_si256(_mm256_srli_epi64(x, n), _mm256_slli_epi64(x, 64 - n));
+    }
+
+    TARGET_AVX2 static V ch(V e, V f, V g)
+    {
+        return _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+    }
+
+    TARGET_AVX2 static V maj(V a, V b, V c)
+    {
+        return _mm256_or_si256(_mm256_and_si256(a, b),
+                               _mm256_and_si256(c, _mm256_or_si256(a, b)));
+    }
+
+    TARGET_AVX2 static V load(const uint8_t *blocks, size_t i, size_t stride)
+    {
+        const long long s = (long long)stride;
+        const __m256i idx = _mm256_setr_epi64x(0, s, 2 * s, 3 * s);
+        const __m256i bswap = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9,
+                                               8, 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10,
+                                               9, 8);
+        const long long *base = (const long long *)(blocks + i * sizeof(Word));
+
+        return _mm256_shuffle_epi8(_mm256_i64gather_epi64(base, idx, 1), bswap);
+    }
+
+    TARGET_AVX2 static void store(Word *out, V x) { _mm256_storeu_si256((__m256i *)out, x); }
+};
+
+struct U32x16
+{
+    using V = __m512i;
+    using Word = uint32_t;
+
+    static constexpr size_t LANES_N = 16;
+    // Masked forms with every lane set, the unmasked ones trip -Wuninitialized in GCC headers
+    static constexpr __mmask16 ALL = 0xffff;
+
+    TARGET_AVX512 static V set1(Word x) { return _mm512_set1_epi32((int)x); }
+    TARGET_AVX512 static V add(V x, V y) { return _mm512_add_epi32(x, y); }
+    TARGET_AVX512 static V xor3(V x, V y, V z) { return _mm512_ternarylogic_epi32(x, y, z, 0x96); }
+    TARGET_AVX512 static V shr(V x, int n) { return _mm512_maskz_srli_epi32(ALL, x, n); }
+    TARGET_AVX512 static V ch(V e, V f, V g) { return _mm512_ternarylogic_epi32(e, f, g, 0xca); }
+    TARGET_AVX512 static V maj(V a, V b, V c) { return _mm512_ternarylogic_epi32(a, b, c, 0xe8); }
+
+    TARGET_AVX512 static V ror(V x, int n)
+    {
+        return _mm512_maskz_rorv_epi32(ALL, x, _mm512_set1_epi32(n));
+    }
+
+    TARGET_AVX512 static V load(const uint8_t *blocks, size_t i, size_t stride)
+    {
+        const __m512i idx = _mm512_mullo_epi32(
+            _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+            _mm512_set1_epi32((int)stride));
+        __m512i x = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), ALL, idx,
+                                                blocks + i * sizeof(Word), 1);
+
+        // No byte shuffle without AVX512BW, swap with rotates and a blend instead
+        __m512i r = _mm512_maskz_rorv_epi32(ALL, x, _mm512_set1_epi32(8));
+        __m512i l = _mm512_maskz_rorv_epi32(ALL, x, _mm512_set1_epi32(24));
+
+        return _mm512_ternarylogic_epi32(r, l, _mm512_set1_epi32(0x00ff00ff), 0xd8);
+    }
+
+    TARGET_AVX512 static void store(Word *out, V x) { _mm512_storeu_si512(out, x); }
+};
+
+struct U64x8
+{
+    using V = __m512i;
+    using Word = uint64_t;
+
+    static constexpr size_t LANES_N = 8;
+    static constexpr __mmask8 ALL = 0xff;
+
+    TARGET_AVX512 static V set1(Word x) { return _mm512_set1_epi64((long long)x); }
+    TARGET_AVX512 static V add(V x, V y) { return _mm512_add_epi64(x, y); }
+    TARGET_AVX512 static V xor3(V x, V y, V z) { return _mm512_ternarylogic_epi64(x, y, z, 0x96); }
+    TARGET_AVX512 static V shr(V x, int n) { return _mm512_maskz_srli_epi64(ALL, x, n); }
+    TARGET_AVX512 static V ch(V e, V f, V g) { return _mm512_ternarylogic_epi64(e, f, g, 0xca); }
+    TARGET_AVX512 static V maj(V a, V b, V c) { return _mm512_ternarylogic_epi64(a, b, c, 0xe8); }
+
+    TARGET_AVX512 static V ror(V x, int n)
+    {
+        return _mm512_maskz_rorv_epi64(ALL, x, _mm512_set1_epi64(n));
+    }
+
+    TARGET_AVX512 static V load(const uint8_t *blocks, size_t i, size_t stride)
+    {
+        const long long s = (long long)stride;
+        const __m512i idx = _mm512_setr_epi64(0, s, 2 * s, 3 * s, 4 * s, 5 * s, 6 * s, 7 * s);
+        __m512i x = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), ALL, idx,
+                                                blocks + i * sizeof(Word), 1);
+
+        // Swap the 32-bit halves, then the bytes of each half
+        x = _mm512_maskz_rorv_epi64(ALL, x, _mm512_set1_epi64(32));
+
+        __m512i r = _mm512_maskz_rorv_epi32(0xffff, x, _mm512_set1_epi32(8));
+        __m512i l = _mm512_maskz_rorv_epi32(0xffff, x, _mm512_set1_epi32(24));
+
+        return _mm512_ternarylogic_epi64(r, l, _mm512_set1_epi32(0x00ff00ff), 0xd8);
+    }
+
+    TARGET_AVX512 static void store(Word *out, V x) { _mm512_storeu_si512(out, x); }
+};
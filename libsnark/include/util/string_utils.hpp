@@ -9,8 +9,7 @@
 
 
 #ifdef USE_LIBFF
-    #include <gmpxx.h>
-    #include <libff/common/default_types/ec_pp.hpp>
+    #include "util/algebra.hpp"
 #endif
 
 #include "util/bit_pack.hpp"
@@ -226,11 +225,10 @@ template<mp_size_t limbs>
 std::string hexdump(const libff::bigint<limbs> &x, bool up = false, bool rev = false,
                     size_t space = 0)
 {
-    mp_limb_t buff[limbs]{}; // limbs are 64-bit wide
-    mpz_class tmp;
+    mp_limb_t buff[limbs]; // limbs are 64-bit wide
 
-    x.to_mpz(tmp.get_mpz_t());
-    mpz_export(buff, NULL, 1, 1, 0, 0, tmp.get_mpz_t());
+    // same fixed-width big-endian encoding used for digests
+    bigint_to_bytes(buff, x);
 
     return hexdump(buff, up, rev, space);
 }
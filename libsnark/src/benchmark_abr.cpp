@@ -2,13 +2,11 @@
 #include "tree/fixed_abr.hpp"
 #include "util/measure.hpp"
 
-#include "gadget/griffin/griffin_gadget.hpp"
 #include "gadget/mimc256/mimc256_gadget.hpp"
 #include "gadget/mimc512f/mimc512f_gadget.hpp"
 #include "gadget/mimc512f2k/mimc512f2k_gadget.hpp"
-#include "gadget/sha256/sha256_gadget.hpp"
-#include "gadget/sha512/sha512_gadget.hpp"
-#include "gadget/poseidon5/poseidon5_gadget.hpp"
+#include "gadget/sha256/sha256_gadget_pp.hpp"
+#include "gadget/sha512/sha512_gadget_pp.hpp"
 #include "gadget/arion/arion_gadget.hpp"
 
 #include <libsnark/common/default_types/r1cs_ppzksnark_pp.hpp>
@@ -30,13 +28,11 @@ static constexpr size_t MAX_TREE_HEIGHT = 31;
 using ppT = libsnark::default_r1cs_ppzksnark_pp;
 using FieldT = libff::Fr<ppT>;
 
-using GadGriffin = griffin_two_to_one_hash_gadget<FieldT>;
-using GadSha256 = libsnark::sha256_two_to_one_hash_gadget<FieldT>;
-using GadSha512 = libsnark::sha512::sha512_two_to_one_hash_gadget<FieldT>;
+using GadSha256 = sha256_two_to_one_hash_gadget<FieldT>;
+using GadSha512 = sha512_two_to_one_hash_gadget<FieldT>;
 using GadMimc256 = mimc256_two_to_one_hash_gadget<FieldT>;
 using GadMimc512F = mimc512f_two_to_one_hash_gadget<FieldT>;
 using GadMimc512F2K = mimc512f2k_two_to_one_hash_gadget<FieldT>;
-using GadPoseidon5 = poseidon5_two_to_one_hash_gadget<FieldT>;
 using GadArion = arion_two_to_one_hash_gadget<FieldT>;
 
 std::ofstream log_file;
@@ -264,17 +260,21 @@ bool test_ptRee()
     elap = measure(
         [&]()
         {
-            out[0].generate_r1cs_witness(tree.digest());
-            trans[0].generate_r1cs_witness(tree.get_node(TRANS_IDX)->get_digest());
-            other[0].generate_r1cs_witness(tree.get_node(TRANS_IDX + 1)->get_digest());
+            out[0].generate_r1cs_witness(tree.digest(), Hash::DIGEST_SIZE);
+            trans[0].generate_r1cs_witness(tree.get_node(TRANS_IDX)->get_digest(),
+                                           Hash::DIGEST_SIZE);
+            other[0].generate_r1cs_witness(tree.get_node(TRANS_IDX + 1)->get_digest(),
+                                           Hash::DIGEST_SIZE);
 
             for (size_t i = 0, j = FixTree::LEAVES_N; i < middle.size();
                  ++i, j += 1ULL << (tree_height - 2 - i))
-                middle[i].generate_r1cs_witness(tree.get_node(j)->get_digest());
+                middle[i].generate_r1cs_witness(tree.get_node(j)->get_digest(),
+                                                Hash::DIGEST_SIZE);
 
             for (size_t i = 0, j = FixTree::INPUT_N + 1; i < otherx.size();
                  ++i, j += 1ULL << (tree_height - 1 - i))
-                otherx[i].generate_r1cs_witness(tree.get_node(j)->get_digest());
+                otherx[i].generate_r1cs_witness(tree.get_node(j)->get_digest(),
+                                                Hash::DIGEST_SIZE);
 
             gadget[0].generate_r1cs_witness();
         },
@@ -384,34 +384,22 @@ int main()
     log_file << "MiMC256\n";
     log_file << table_header;
     test_ptRee_from<MIN_TREE_HEIGHT, MAX_TREE_HEIGHT, GadMimc256>("MiMC256");
-    log_file << "\n";*
+    log_file << "\n";
 
     log_file << "MiMC512-SK\n";
     log_file << table_header;
     test_ptRee_from<MIN_TREE_HEIGHT, MAX_TREE_HEIGHT, GadMimc512F>("MiMC512-SK");
-    log_file << "\n";*
+    log_file << "\n";
 
     log_file << "MiMC512-DK\n";
     log_file << table_header;
     test_ptRee_from<MIN_TREE_HEIGHT, MAX_TREE_HEIGHT, GadMimc512F2K>("MiMC512-DK");
-    log_file << "\n";*
-
-/*
-    log_file << "Griffin\n";
-    log_file << table_header;
-    test_ptRee_from<MIN_TREE_HEIGHT, MAX_TREE_HEIGHT, GadGriffin>("Griffin");
     log_file << "\n";
 
-    log_file << "Poseidon5\n";
-    log_file << table_header;
-    test_ptRee_from<MIN_TREE_HEIGHT, MAX_TREE_HEIGHT, GadPoseidon5>("Poseidon5");
-    log_file << "\n";*/
-
-/*
     log_file << "Arion\n";
     log_file << table_header;
-    test_ptRee_from<MIN_TREE_HEIGHT, MAX_TREE_HEIGHT, GadArion>("Arion5");
-    log_file << "\n";*/
+    test_ptRee_from<MIN_TREE_HEIGHT, MAX_TREE_HEIGHT, GadArion>("Arion");
+    log_file << "\n";
 
     return 0;
 }
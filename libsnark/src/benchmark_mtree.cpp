@@ -102,7 +102,7 @@ bool test_mtree(size_t trans_idx = 0)
     trans.generate_r1cs_witness(tree->get_node(trans_idx)->get_digest());
     pb.val(idx) = trans_idx;
 
-    const Node *aux = tree->get_node(trans_idx)->get_f();
+    Node aux = tree->get_node(trans_idx)->get_f();
     for (size_t i = 0; i < other.size(); ++i, aux = aux->get_f())
         for (size_t j = 0; j < other[i].size(); ++j)
             other[i][j].generate_r1cs_witness(aux->get_c(j)->get_digest());
@@ -2,6 +2,8 @@
 #include "util/string_utils.hpp"
 #include <cstring>
 #include <iostream>
+#include <random>
+#include <vector>
 
 using ppT = libff::default_ec_pp;
 using FieldT = libff::Fr<ppT>;
@@ -12,7 +14,7 @@ static bool run_tests()
     //There are no test vectors for MiMC, so we assume our implementation to be correct
     uint8_t msg[Hash::BLOCK_SIZE]{};
     uint8_t dig[Hash::DIGEST_SIZE]{};
-    auto real_dig = BIGHEX(95ca1619d909ae2bd63490f95ecd41094c87464aebfd77577a985a5a39f8dd00);
+    auto real_dig = BIGHEX(00229e3e05861b9289c35f5b0f1a2fe31cd8e1fb0b30fb858fdca406323c1f95);
 
     bool check = true;
     bool all_check = true;
@@ -29,6 +31,27 @@ static bool run_tests()
     std::cout << check << '\n';
     all_check &= check;
 
+    std::cout << "Batched hashing... ";
+    check = true;
+    {
+        static constexpr size_t COUNT = 2 * Hash::LANES_N + 1;
+
+        std::mt19937 rng{std::random_device{}()};
+        std::vector<uint8_t> blocks(COUNT * Hash::BLOCK_SIZE);
+        std::vector<uint8_t> digests(COUNT * Hash::DIGEST_SIZE);
+
+        std::generate(blocks.begin(), blocks.end(), std::ref(rng));
+        Hash::hash_oneblock_many(digests.data(), blocks.data(), COUNT);
+
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            Hash::hash_oneblock(dig, blocks.data() + i * Hash::BLOCK_SIZE);
+            check &= memcmp(dig, digests.data() + i * Hash::DIGEST_SIZE, sizeof(dig)) == 0;
+        }
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
     return all_check;
 
     return true;
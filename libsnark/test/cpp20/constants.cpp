@@ -0,0 +1,193 @@
+#include "util/constants.hpp"
+#include "util/addition_chain.hpp"
+#include "util/field_lanes.hpp"
+#include "hash/arion.hpp"
+#include "hash/arion_v2.hpp"
+#include "hash/poseidon5.hpp"
+#include "util/string_utils.hpp"
+#include <cstring>
+#include <iostream>
+
+using ppT = libff::default_ec_pp;
+using FieldT = libff::Fr<ppT>;
+
+// SHAKE128("abc"), first 32 bytes
+static constexpr auto shake_abc()
+{
+    Shake128 s;
+    std::array<uint8_t, 32> out{};
+
+    s.absorb(std::string_view{"abc"});
+    for (auto &b : out)
+        b = s.squeeze();
+
+    return out;
+}
+
+template<typename Field>
+static bool is_non_residue(const Field &x)
+{
+    // Euler's criterion, x^((p - 1) / 2) = -1
+    libff::bigint<Field::num_limbs> e{Field::mod};
+
+    e.data[0] &= ~1UL;
+    for (size_t i = 0; i < (size_t)Field::num_limbs; ++i)
+        e.data[i] = e.data[i] >> 1 | (i + 1 < (size_t)Field::num_limbs ? e.data[i + 1] << 63 : 0);
+
+    return (x ^ e) == Field{-1};
+}
+
+template<typename Hash>
+static bool same_as_runtime()
+{
+    // The tables baked at compile time must equal the ones derived from the modulus of the field
+    static constexpr bool known = FieldModulus<typename Hash::Field>::known;
+    auto runtime = Hash::derive_constants(field_modulus_limbs<typename Hash::Field>());
+
+    return known && memcmp(&runtime, &hash_constants<Hash>(), sizeof(runtime)) == 0;
+}
+
+template<typename Field, uint64_t d>
+static bool has_root_of_unity()
+{
+    // d is prime and divides p - 1, so x^((p - 1) / d) is a d-th root of one, not always one
+    libff::bigint<Field::num_limbs> e{Field::mod};
+    unsigned __int128 r = 0;
+    bool nontrivial = false;
+
+    e.data[0] -= 1;
+    for (size_t i = Field::num_limbs; i-- > 0;)
+    {
+        r = r << 64 | e.data[i];
+        e.data[i] = (uint64_t)(r / d);
+        r %= d;
+    }
+
+    for (size_t i = 0; i < 8; ++i)
+    {
+        Field w = Field::random_element() ^ e;
+
+        if ((w ^ d) != Field::one())
+            return false;
+        nontrivial |= w != Field::one();
+    }
+
+    return r == 0 && nontrivial;
+}
+
+template<typename Field, uint64_t d>
+static bool chain_matches_power()
+{
+    // x^(1/d) by the compile-time chain must equal the generic exponentiation and invert x^d
+    using Chain = AdditionChain<InverseExponent<Field, d>>;
+
+    libff::bigint<Field::num_limbs> e;
+    FieldLanes<Field, 4> lanes;
+    bool check = true;
+
+    for (size_t i = 0; i < (size_t)Field::num_limbs; ++i)
+        e.data[i] = InverseExponent<Field, d>::value[i];
+
+    for (size_t i = 0; i < 4; ++i)
+        lanes[i] = Field::random_element();
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        Field x{lanes[i]};
+
+        Chain::pow(x);
+        check &= x == (lanes[i] ^ e) && (x ^ d) == lanes[i];
+    }
+
+    FieldLanes<Field, 4> y{lanes};
+
+    Chain::pow(y);
+    for (size_t i = 0; i < 4; ++i)
+        check &= (y[i] ^ d) == lanes[i];
+
+    return check;
+}
+
+template<typename Field, uint64_t d>
+static bool chain_is_inverse_power()
+{
+    // x^d has no inverse when gcd(d, p - 1) > 1, then no chain can exist for it
+    if constexpr (!exponent_is_invertible<d>(FieldModulus<Field>::value))
+        return has_root_of_unity<Field, d>();
+    else
+        return chain_matches_power<Field, d>();
+}
+
+static bool run_tests()
+{
+    bool check = true;
+    bool all_check = true;
+
+    std::cout << std::boolalpha;
+
+    std::cout << "SHAKE128... ";
+    {
+        static constexpr auto dig = shake_abc();
+        auto real_dig = BIGHEX(5881092dd818bf5cf8a3ddb793fbcba74097d5c526a6d35f97b83351940f2cc8);
+
+        check = memcmp(dig.data(), real_dig.data(), dig.size()) == 0;
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Compile-time moduli... ";
+    check = FieldModulus<FieldT>::value == field_modulus_limbs<FieldT>();
+    check &= FieldModulus<libff::Fq<ppT>>::value == field_modulus_limbs<libff::Fq<ppT>>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Compile-time tables... ";
+    check = same_as_runtime<Arion<FieldT, 2, 1>>();
+    check &= same_as_runtime<Arion<FieldT, 3, 1, 8>>();
+    check &= same_as_runtime<Poseidon5<FieldT, 2, 1>>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Irreducible g_i... ";
+    check = true;
+    for (const auto &[a, b] : Arion<FieldT, 2, 1>::alpha)
+        check &= is_non_residue(a * a - (b + b + b + b));
+    for (const auto &[a, b] : ArionV2<FieldT, 3, 1, 8>::alpha)
+        check &= is_non_residue(a * a - (b + b + b + b));
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Addition chains... ";
+    check = chain_is_inverse_power<FieldT, 5>();
+    check &= chain_is_inverse_power<FieldT, 11>();
+    check &= chain_is_inverse_power<FieldT, 257>();
+    check &= chain_is_inverse_power<libff::Fq<ppT>, 5>();
+    check &= chain_is_inverse_power<libff::Fq<ppT>, 11>();
+    check &= chain_is_inverse_power<libff::Fq<ppT>, 257>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Domain separation... ";
+    check = Arion<FieldT, 2, 1>::round_c[0] != ArionV2<FieldT, 2, 1>::round_c[0];
+    check &= Arion<FieldT, 2, 1>::round_c[0] != Arion<FieldT, 2, 1, 8>::round_c[0];
+    check &= Arion<FieldT, 2, 1>::beta[0] != Arion<FieldT, 2, 1>::beta[1];
+    std::cout << check << '\n';
+    all_check &= check;
+
+    return all_check;
+}
+
+int main()
+{
+    std::cout << "\n==== Testing Constants ====\n";
+
+    bool all_check = run_tests();
+
+    std::cout << "\n==== " << (all_check ? "ALL TESTS SUCCEEDED" : "SOME TESTS FAILED")
+              << " ====\n\n";
+
+#ifdef MEASURE_PERFORMANCE
+#endif
+
+    return 0;
+}
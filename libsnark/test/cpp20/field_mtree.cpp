@@ -0,0 +1,99 @@
+#include "tree/field_mtree.hpp"
+#include "hash/arion.hpp"
+#include "hash/poseidon5.hpp"
+#include "tree/mtree.hpp"
+#include "util/string_utils.hpp"
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using FieldT = libff::Fq<libff::default_ec_pp>;
+
+// The field-native tree must agree with the byte-oriented tree node by node
+template<size_t height, typename Hash>
+static bool same_as_mtree()
+{
+    using Tree = MTree<height, Hash>;
+    using FTree = FieldMTree<height, Hash>;
+
+    static std::mt19937 rng{std::random_device{}()};
+
+    std::vector<uint8_t> data(Tree::INPUT_SIZE);
+    std::generate(data.begin(), data.end(), std::ref(rng));
+
+    Tree tree(data.begin(), data.end());
+    FTree ftree(data.begin(), data.end());
+
+    bool check = memcmp(tree.digest(), ftree.digest().data(), Hash::DIGEST_SIZE) == 0;
+
+    for (size_t i = 0; i < Tree::NODES_N; ++i)
+        check &= tree.get_node(i)->get_digest() == ftree.get_node(i)->get_digest();
+
+    // navigation must match as well
+    check &= ftree.get_node(0)->get_f()->get_c(0) == ftree.get_node(0);
+
+    return check;
+}
+
+static bool run_tests()
+{
+    bool check = true;
+    bool all_check = true;
+
+    static constexpr size_t HEIGHT = 4;
+
+    std::cout << std::boolalpha;
+
+    std::cout << "Field Tree Arion (2:1)... ";
+    check = same_as_mtree<HEIGHT, Arion<FieldT, 2, 1>>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Field Tree Arion (3:1)... ";
+    check = same_as_mtree<HEIGHT, Arion<FieldT, 3, 1, 8>>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Field Tree Poseidon5 (2:1)... ";
+    check = same_as_mtree<HEIGHT, Poseidon5<FieldT, 2, 1>>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Field Tree from elements... ";
+    check = true;
+    {
+        using Hash = Arion<FieldT, 2, 1>;
+        using FTree = FieldMTree<HEIGHT, Hash>;
+
+        std::vector<uint8_t> data(FTree::INPUT_SIZE);
+        std::vector<FieldT> leaves(FTree::INPUT_N);
+
+        for (size_t i = 0; i < leaves.size(); ++i)
+        {
+            leaves[i] = FieldT::random_element();
+            field_to_bytes(data.data() + i * Hash::DIGEST_SIZE, leaves[i]);
+        }
+
+        check = FTree{leaves}.digest_field() == FTree{data.begin(), data.end()}.digest_field();
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    return all_check;
+}
+
+int main()
+{
+    std::cout << "\n==== Testing Field Merkle Tree ====\n";
+
+    bool all_check = run_tests();
+
+    std::cout << "\n==== " << (all_check ? "ALL TESTS SUCCEEDED" : "SOME TESTS FAILED")
+              << " ====\n\n";
+
+#ifdef MEASURE_PERFORMANCE
+#endif
+
+    return 0;
+}
@@ -3,10 +3,63 @@
 #include "hash/mimc512f.hpp"
 #include "hash/sha256.hpp"
 #include "hash/sha512.hpp"
+#include "hash/arion.hpp"
 #include "util/string_utils.hpp"
 #include <cstring>
 #include <iostream>
 
+using FieldT = libff::Fq<libff::default_ec_pp>;
+
+// Root computed layer by layer with Hash::hash_add on bytes
+template<size_t height, typename Hash>
+static bool same_as_reference()
+{
+    using Tree = FixedAbr<height, Hash>;
+    using Digest = std::array<uint8_t, Hash::DIGEST_SIZE>;
+
+    std::vector<uint8_t> data(Tree::INPUT_SIZE);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = i * 7 % 251;
+
+    std::vector<Digest> level(Tree::LEAVES_N);
+    for (size_t i = 0; i < level.size(); ++i)
+        Hash::hash_oneblock(level[i].data(), data.data() + i * Hash::BLOCK_SIZE);
+
+    bool first = true;
+
+    for (size_t q = Tree::LEAVES_N; level.size() > 1; first = false)
+    {
+        std::vector<Digest> parents(level.size() / 2);
+
+        for (size_t p = 0; p < parents.size(); ++p)
+        {
+            uint8_t block[Hash::BLOCK_SIZE]{};
+            Digest middle;
+
+            memcpy(block, level[2 * p].data(), Hash::DIGEST_SIZE);
+            memcpy(block + Hash::DIGEST_SIZE, level[2 * p + 1].data(), Hash::DIGEST_SIZE);
+
+            if (!first)
+            {
+                Hash::hash_oneblock(middle.data(), data.data() + q++ * Hash::BLOCK_SIZE);
+                Hash::hash_add(block, middle.data());
+                Hash::hash_add(block + Hash::DIGEST_SIZE, middle.data());
+            }
+
+            Hash::hash_oneblock(parents[p].data(), block);
+
+            if (!first)
+                Hash::hash_add(parents[p].data(), level[2 * p + 1].data());
+        }
+
+        level = parents;
+    }
+
+    Tree tree(data.begin(), data.end());
+
+    return memcmp(tree.digest(), level[0].data(), Hash::DIGEST_SIZE) == 0;
+}
+
 static bool run_tests()
 {
     bool check = true;
@@ -55,7 +108,13 @@ static bool run_tests()
     std::cout << check << '\n';
     all_check &= check;
 
-
+    std::cout << "ABR layers... ";
+    check = same_as_reference<11, Sha256>();
+    check &= same_as_reference<9, Sha512>();
+    check &= same_as_reference<7, Mimc256<FieldT>>();
+    check &= same_as_reference<8, Arion<FieldT>>();
+    std::cout << check << '\n';
+    all_check &= check;
 
     return all_check;
 }
@@ -3,8 +3,74 @@
 #include "hash/sha256.hpp"
 #include "hash/sha512.hpp"
 #include "util/string_utils.hpp"
+#include "tree_updates.hpp"
 #include <cstring>
 #include <iostream>
+#include <memory>
+
+// Leaf digest of a FixedMTree, its block hashed as one pair
+template<typename Hash>
+static void hash_leaf(uint8_t *leaf, const uint8_t *block)
+{
+    fixed_mtree_hash_pairs<Hash>(leaf, block, 1);
+}
+
+template<size_t height, typename Hash>
+static bool paths_verify()
+{
+    using Tree = FixedMTree<height, Hash>;
+    using Path = FixedMTreePath<height, Hash>;
+    using Digest = typename Tree::Digest;
+
+    static constexpr size_t LEAVES_N = 1ULL << (height - 1);
+    static constexpr size_t PATH_N = height - 1;
+
+    std::vector<uint8_t> data(Tree::INPUT_SIZE);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = i * 3 % 233;
+
+    Tree tree(data.begin(), data.end());
+    const uint8_t *ROOT = tree.digest().data();
+
+    std::vector<size_t> indices;
+    std::vector<Digest> siblings;
+    for (size_t i = 0; i < 300; ++i)
+    {
+        indices.push_back(i * 7919 % LEAVES_N);
+
+        auto node = tree.get_node(indices.back());
+        for (auto parent = node->get_f(); parent; node = parent, parent = parent->get_f())
+            siblings.push_back(parent->get_c(parent->get_c(0) == node)->get_digest());
+    }
+
+    std::vector<Digest> leaves;
+    for (size_t i : indices)
+        leaves.push_back(tree.get_node(i)->get_digest());
+
+    // every third path keeps a flipped sibling bit or an index past the last leaf
+    for (size_t i = 0; i < indices.size(); ++i)
+        if (i % 3 == 1)
+            siblings[i * PATH_N + i % PATH_N][i % Hash::DIGEST_SIZE] ^= 1;
+        else if (i % 3 == 2)
+            indices[i] += LEAVES_N;
+
+    std::unique_ptr<bool[]> valid{new bool[indices.size()]};
+    bool check = true;
+
+    Path::verify_paths(valid.get(), ROOT, leaves.data(), indices.data(), siblings.data(),
+                       indices.size());
+
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        check &= valid[i] == (i % 3 == 0);
+        check &= Path::verify_path(ROOT, leaves[i], indices[i], &siblings[i * PATH_N]) == valid[i];
+    }
+
+    leaves[0][0] ^= 1;
+    check &= !Path::verify_path(ROOT, leaves[0], indices[0], &siblings[0]);
+
+    return check;
+}
 
 static bool run_tests()
 {
@@ -42,6 +108,18 @@ static bool run_tests()
     std::cout << check << '\n';
     all_check &= check;
 
+    std::cout << "Leaf updates... ";
+    check = updates_match_rebuild<FixedMTree<12, Sha256>, Sha256>(1ULL << 11, hash_leaf<Sha256>);
+    check &= updates_match_rebuild<FixedMTree<8, Sha512>, Sha512>(1ULL << 7, hash_leaf<Sha512>);
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Path verification... ";
+    check = paths_verify<12, Sha256>();
+    check &= paths_verify<9, Sha512>();
+    std::cout << check << '\n';
+    all_check &= check;
+
     std::cout << "Tree Path SHA256... ";
     check = true;
     {
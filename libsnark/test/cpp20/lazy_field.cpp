@@ -0,0 +1,143 @@
+#include "util/lazy_field.hpp"
+#include <iostream>
+
+using ppT = libff::default_ec_pp;
+
+template<typename Field>
+static bool sum_is_exact()
+{
+    // Long mixed sums with small multiples, enough to carry into the extra limb
+    static constexpr size_t N = 64;
+
+    std::array<Field, N> x;
+    FieldSum<Field> s;
+    Field ref{0};
+
+    for (size_t i = 0; i < N; ++i)
+    {
+        x[i] = Field::random_element();
+
+        if (i % 3 == 0)
+        {
+            s -= x[i];
+            ref -= x[i];
+        }
+        else
+        {
+            s.add_mul(i + 1, x[i]);
+            ref += Field(i + 1) * x[i];
+        }
+    }
+
+    bool check = s.reduce() == ref;
+
+    // Reducing must not consume the accumulator
+    s += x[0];
+    ref += x[0];
+    check &= s.reduce() == ref;
+
+    // Zero and -1 are edge cases of the final subtractions
+    FieldSum<Field> z{Field{-1}};
+
+    z += Field{1};
+    check &= z.reduce() == Field{0};
+
+    return check;
+}
+
+template<typename Field, size_t N>
+static bool dot_is_exact()
+{
+    FieldDot<Field> dot;
+    Field ref{0};
+
+    for (size_t i = 0; i < N; ++i)
+    {
+        Field a{Field::random_element()};
+        Field b{i ? Field::random_element() : Field{-1}};
+
+        dot.add_mul(a, b);
+        ref += a * b;
+    }
+
+    return dot.reduce() == ref;
+}
+
+template<typename Field>
+static bool lanes_are_exact()
+{
+    using Lanes = FieldLanes<Field, 4>;
+
+    Lanes x;
+    Lanes y;
+    Field c{Field::random_element()};
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        x[i] = Field::random_element();
+        y[i] = Field::random_element();
+    }
+
+    FieldSum<Lanes> s{x};
+    FieldDot<Lanes> dot;
+
+    s.add_mul(7, y);
+    s -= x;
+    dot.add_mul(c, x);
+    dot.add_mul(c, y);
+
+    Lanes r{s.reduce()};
+    Lanes d{dot.reduce()};
+    bool check = true;
+
+    for (size_t i = 0; i < 4; ++i)
+        check &= r[i] == Field{7} * y[i] && d[i] == c * (x[i] + y[i]);
+
+    return check;
+}
+
+static bool run_tests()
+{
+    bool check = true;
+    bool all_check = true;
+
+    std::cout << std::boolalpha;
+
+    std::cout << "Lazy sums... ";
+    check = sum_is_exact<libff::Fr<ppT>>();
+    check &= sum_is_exact<libff::Fq<ppT>>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Lazy dot products... ";
+    check = dot_is_exact<libff::Fr<ppT>, 1>();
+    check &= dot_is_exact<libff::Fr<ppT>, 3>();
+    check &= dot_is_exact<libff::Fq<ppT>, 9>();
+    check &= dot_is_exact<libff::Fq<ppT>, 24>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Lazy lanes... ";
+    check = lanes_are_exact<libff::Fr<ppT>>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    return all_check;
+}
+
+int main()
+{
+    std::cout << "\n==== Testing Lazy Field Accumulators ====\n";
+
+    libff::default_ec_pp::init_public_params();
+
+    bool all_check = run_tests();
+
+    std::cout << "\n==== " << (all_check ? "ALL TESTS SUCCEEDED" : "SOME TESTS FAILED")
+              << " ====\n\n";
+
+#ifdef MEASURE_PERFORMANCE
+#endif
+
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include "tree/mapped_mtree.hpp"
+#include "tree/mtree.hpp"
+#include "hash/sha256.hpp"
+#include "hash/sha512.hpp"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+static constexpr size_t HEIGHT = 10;
+
+using Tree = MappedMTree<HEIGHT, Sha256>;
+using Ref = MTree<HEIGHT, Sha256>;
+
+static bool same_nodes(const Tree &tree, const Ref &ref)
+{
+    bool check = memcmp(tree.digest(), ref.digest(), Sha256::DIGEST_SIZE) == 0;
+
+    for (size_t i = 0; i < Ref::NODES_N; ++i)
+        check &= tree.get_node(i)->get_digest() == ref.get_node(i)->get_digest();
+
+    check &= tree.get_node(3)->get_f()->get_c(1)->get_digest() ==
+             ref.get_node(3)->get_f()->get_c(1)->get_digest();
+
+    return check;
+}
+
+static bool run_tests()
+{
+    bool check = true;
+    bool all_check = true;
+
+    auto dir = std::filesystem::temp_directory_path();
+    std::string input = dir / "mapped_mtree_input.bin";
+    std::string path = dir / "mapped_mtree_tree.bin";
+
+    std::vector<uint8_t> data(Tree::INPUT_SIZE);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = i * 17 % 251;
+
+    std::ofstream(input, std::ios::binary).write((const char *)data.data(), data.size());
+    std::remove(path.c_str());
+
+    Ref ref(data.begin(), data.end());
+
+    std::cout << std::boolalpha;
+
+    std::cout << "Interrupted build... ";
+    {
+        // 16 leaves per chunk, stop after 5 of the 32 chunks
+        Tree tree(path, 16);
+
+        check = tree.is_open() && !tree.build(input, 5) && !tree.is_complete();
+    }
+    {
+        // Writes past the checkpoint that never reached the header
+        std::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+        std::vector<char> junk(8 * Sha256::DIGEST_SIZE, 0x55);
+
+        f.seekp(4096 + 5 * 16 * Sha256::DIGEST_SIZE);
+        f.write(junk.data(), junk.size());
+        f.seekp(-(std::streamoff)junk.size(), std::ios::end);
+        f.write(junk.data(), junk.size());
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Resumed build... ";
+    {
+        Tree tree(path);
+
+        check = !tree.is_complete() && tree.build(input) && same_nodes(tree, ref);
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Reopen without input... ";
+    {
+        Tree tree(path);
+        std::vector<size_t> indices{0, 5, 311, Tree::LEAVES_N - 1};
+
+        check = tree.is_complete() && same_nodes(tree, ref);
+        check &= tree.layout() == Tree::Layout::LEVELS;
+        check &= tree.paths(indices.begin(), indices.end()) ==
+                 ref.paths(indices.begin(), indices.end());
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Reject other trees... ";
+    {
+        std::cerr.setstate(std::ios::failbit);
+        MappedMTree<HEIGHT, Sha512> other(path);
+        MappedMTree<HEIGHT - 1, Sha256> shorter(path);
+        std::cerr.clear();
+
+        check = !other.is_open() && !shorter.is_open();
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Blocked layout... ";
+    {
+        std::string blocked = dir / "mapped_mtree_blocked.bin";
+        std::remove(blocked.c_str());
+
+        {
+            Tree tree(blocked, 16, Tree::Layout::BLOCKS);
+
+            check = tree.layout() == Tree::Layout::BLOCKS && !tree.build(input, 5);
+        }
+        {
+            // the file keeps its layout whatever is asked when reopening it
+            Tree tree(blocked);
+            std::vector<size_t> indices{0, 5, 127, 128, 311, Tree::LEAVES_N - 1};
+
+            check &= tree.layout() == Tree::Layout::BLOCKS && tree.build(input) &&
+                     same_nodes(tree, ref);
+            check &= tree.paths(indices.begin(), indices.end()) ==
+                     ref.paths(indices.begin(), indices.end());
+        }
+
+        std::remove(blocked.c_str());
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::remove(path.c_str());
+    std::remove(input.c_str());
+
+    return all_check;
+}
+
+int main()
+{
+    std::cout << "\n==== Testing Memory-Mapped Merkle Tree ====\n";
+
+    bool all_check = run_tests();
+
+    std::cout << "\n==== " << (all_check ? "ALL TESTS SUCCEEDED" : "SOME TESTS FAILED")
+              << " ====\n\n";
+
+#ifdef MEASURE_PERFORMANCE
+#endif
+
+    return 0;
+}
@@ -0,0 +1,186 @@
+#include "tree/mmr.hpp"
+#include "tree/mtree.hpp"
+#include "hash/sha256.hpp"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+// Four children per block, to cover mountains wider than binary
+struct Sha256x4
+{
+    static constexpr size_t BLOCK_SIZE = 4 * Sha256::DIGEST_SIZE;
+    static constexpr size_t DIGEST_SIZE = Sha256::DIGEST_SIZE;
+
+    static void hash_oneblock(uint8_t *digest, const void *message)
+    {
+        uint8_t pair[Sha256::BLOCK_SIZE];
+
+        Sha256::hash_oneblock(pair, message);
+        Sha256::hash_oneblock(pair + DIGEST_SIZE, (const uint8_t *)message + Sha256::BLOCK_SIZE);
+        Sha256::hash_oneblock(digest, pair);
+    }
+};
+
+template<typename Hash>
+static std::vector<typename MMR<Hash>::Digest> make_leaves(size_t n)
+{
+    std::vector<typename MMR<Hash>::Digest> leaves(n);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        uint8_t block[Sha256::BLOCK_SIZE]{};
+
+        memcpy(block, &i, sizeof(i));
+        Sha256::hash_oneblock(leaves[i].data(), block);
+    }
+
+    return leaves;
+}
+
+template<typename Hash>
+static bool proofs_hold(size_t max_n)
+{
+    using Digest = typename MMR<Hash>::Digest;
+
+    auto leaves = make_leaves<Hash>(max_n);
+    std::vector<Digest> roots{MMR<Hash>{}.digest()};
+    MMR<Hash> mmr;
+    bool check = true;
+
+    for (size_t n = 1; n <= max_n; ++n)
+    {
+        mmr.append(leaves[n - 1]);
+        roots.push_back(mmr.digest());
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            auto proof = mmr.prove_inclusion(i);
+
+            check &= MMR<Hash>::verify_inclusion(roots[n], leaves[i], proof);
+            check &= !MMR<Hash>::verify_inclusion(roots[n], leaves[(i + 1) % max_n], proof);
+        }
+
+        for (size_t old_n = 0; old_n <= n; ++old_n)
+        {
+            auto proof = mmr.prove_consistency(old_n);
+
+            check &= MMR<Hash>::verify_consistency(roots[old_n], roots[n], proof);
+            check &= old_n == n || !MMR<Hash>::verify_consistency(roots[old_n + 1], roots[n], proof);
+
+            if (!proof.nodes.empty())
+            {
+                proof.nodes.back()[0] ^= 1;
+                check &= !MMR<Hash>::verify_consistency(roots[old_n], roots[n], proof);
+            }
+        }
+    }
+
+    return check;
+}
+
+static bool run_tests()
+{
+    bool check = true;
+    bool all_check = true;
+
+    std::cout << std::boolalpha;
+
+    std::cout << "Full mountain is MTree... ";
+    check = true;
+    {
+        using Tree = MTree<9, Sha256>;
+
+        std::vector<uint8_t> data(Tree::INPUT_SIZE);
+        for (size_t i = 0; i < data.size(); ++i)
+            data[i] = i % 247;
+
+        Tree tree(data.begin(), data.end());
+        MMR<Sha256> mmr;
+
+        for (size_t i = 0; i < Tree::LEAVES_N; ++i)
+            mmr.append(tree.get_node(i)->get_digest());
+
+        check = memcmp(mmr.digest().data(), tree.digest(), Sha256::DIGEST_SIZE) == 0;
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Inclusion and consistency... ";
+    check = proofs_hold<Sha256>(40);
+    check &= proofs_hold<Sha256x4>(40);
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Node file... ";
+    check = true;
+    {
+        std::string path = std::filesystem::temp_directory_path() / "mmr_test.bin";
+        auto leaves = make_leaves<Sha256>(100);
+        MMR<Sha256> ref;
+
+        std::remove(path.c_str());
+        ref.append(leaves.data(), 60);
+        {
+            MMR<Sha256> mmr(path);
+
+            mmr.append(leaves.data(), 60);
+            check &= mmr.is_open() && mmr.digest() == ref.digest();
+        }
+
+        ref.append(leaves.data() + 60, 40);
+        {
+            MMR<Sha256> mmr(path);
+
+            check &= mmr.size() == 60;
+            mmr.append(leaves.data() + 60, 40);
+            check &= mmr.digest() == ref.digest();
+            check &= MMR<Sha256>::verify_inclusion(ref.digest(), leaves[17],
+                                                   mmr.prove_inclusion(17));
+        }
+
+        // a crash may leave any prefix of the nodes, the pending merges are redone on open
+        std::string full = path + ".full";
+
+        std::filesystem::copy_file(path, full, std::filesystem::copy_options::overwrite_existing);
+        for (size_t nodes_n = 1; nodes_n < 40; ++nodes_n)
+        {
+            std::filesystem::copy_file(full, path,
+                                       std::filesystem::copy_options::overwrite_existing);
+            std::filesystem::resize_file(path, 32 + nodes_n * Sha256::DIGEST_SIZE + nodes_n % 3);
+
+            MMR<Sha256> mmr(path);
+            MMR<Sha256> same;
+
+            same.append(leaves.data(), mmr.size());
+            check &= mmr.digest() == same.digest();
+        }
+
+        std::cerr.setstate(std::ios::failbit);
+        MMR<Sha256x4> other(path);
+        std::cerr.clear();
+        check &= !other.is_open();
+
+        std::remove(path.c_str());
+        std::remove(full.c_str());
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    return all_check;
+}
+
+int main()
+{
+    std::cout << "\n==== Testing Merkle Mountain Range ====\n";
+
+    bool all_check = run_tests();
+
+    std::cout << "\n==== " << (all_check ? "ALL TESTS SUCCEEDED" : "SOME TESTS FAILED")
+              << " ====\n\n";
+
+#ifdef MEASURE_PERFORMANCE
+#endif
+
+    return 0;
+}
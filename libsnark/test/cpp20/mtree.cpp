@@ -3,11 +3,235 @@
 #include "hash/sha512.hpp"
 #include "hash/arion.hpp"
 #include "util/string_utils.hpp"
+#include "tree_updates.hpp"
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <set>
 
 using FieldT = libff::Fq<libff::default_ec_pp>;
 
+template<typename Tree, typename Hash>
+static bool proofs_match_tree()
+{
+    using Digest = typename Tree::Digest;
+
+    std::vector<uint8_t> data(Tree::INPUT_SIZE);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = i * 5 % 241;
+
+    Tree tree(data.begin(), data.end());
+    bool check = true;
+
+    // a cluster sharing most of its siblings, spread leaves and a duplicate
+    std::vector<size_t> indices;
+    for (size_t i = 0; i < 32; ++i)
+        indices.push_back(Tree::LEAVES_N / 2 + i);
+    for (size_t i = 0; i < 16; ++i)
+        indices.push_back(i * 104729 % Tree::LEAVES_N);
+    indices.push_back(indices[3]);
+
+    std::vector<Digest> paths = tree.paths(indices.begin(), indices.end());
+
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        auto node = tree.get_node(indices[i]);
+        const Digest *path = paths.data() + i * Tree::PATH_N;
+
+        for (auto parent = node->get_f(); parent; node = parent, parent = parent->get_f())
+            for (size_t k = 0; k < Tree::ARITY; ++k)
+                if (parent->get_c(k) != node)
+                    check &= *path++ == parent->get_c(k)->get_digest();
+    }
+
+    auto proof = tree.multiproof(indices.begin(), indices.end());
+    std::vector<Digest> leaves;
+
+    for (size_t i : proof.indices)
+        leaves.push_back(tree.get_node(i)->get_digest());
+
+    std::set<size_t> unique(indices.begin(), indices.end());
+
+    check &= std::equal(proof.indices.begin(), proof.indices.end(), unique.begin(), unique.end());
+    check &= proof.siblings.size() < paths.size() / 2;
+    check &= Tree::verify_multiproof(tree.digest(), proof, leaves.data());
+
+    // tampered leaves, siblings, roots and indices must all fail
+    auto bad_leaves = leaves;
+    bad_leaves[5][0] ^= 1;
+    check &= !Tree::verify_multiproof(tree.digest(), proof, bad_leaves.data());
+
+    auto bad_proof = proof;
+    bad_proof.siblings.back()[1] ^= 1;
+    check &= !Tree::verify_multiproof(tree.digest(), bad_proof, leaves.data());
+
+    bad_proof = proof;
+    bad_proof.siblings.pop_back();
+    check &= !Tree::verify_multiproof(tree.digest(), bad_proof, leaves.data());
+
+    bad_proof = proof;
+    bad_proof.siblings.push_back(proof.siblings[0]);
+    check &= !Tree::verify_multiproof(tree.digest(), bad_proof, leaves.data());
+
+    bad_proof = proof;
+    std::swap(bad_proof.indices[0], bad_proof.indices[1]);
+    check &= !Tree::verify_multiproof(tree.digest(), bad_proof, leaves.data());
+
+    check &= !Tree::verify_multiproof(tree.get_node(0)->get_digest().data(), proof, leaves.data());
+
+    return check;
+}
+
+template<size_t height, typename Hash>
+static bool paths_verify()
+{
+    using Tree = MTree<height, Hash>;
+    using Path = MTreePath<height, Hash>;
+    using Digest = typename Tree::Digest;
+
+    static constexpr size_t LEAVES_N = Tree::LEAVES_N;
+    static constexpr size_t PATH_N = Tree::PATH_N;
+
+    std::vector<uint8_t> data(Tree::INPUT_SIZE);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = i * 3 % 233;
+
+    Tree tree(data.begin(), data.end());
+    const uint8_t *ROOT = tree.digest();
+
+    std::vector<size_t> indices;
+    for (size_t i = 0; i < 300; ++i)
+        indices.push_back(i * 7919 % LEAVES_N);
+
+    std::vector<Digest> siblings = tree.paths(indices.begin(), indices.end());
+
+    std::vector<Digest> leaves;
+    for (size_t i : indices)
+        leaves.push_back(tree.get_node(i)->get_digest());
+
+    // every third path keeps a flipped sibling bit or an index past the last leaf
+    for (size_t i = 0; i < indices.size(); ++i)
+        if (i % 3 == 1)
+            siblings[i * PATH_N + i % PATH_N][i % Hash::DIGEST_SIZE] ^= 1;
+        else if (i % 3 == 2)
+            indices[i] += LEAVES_N;
+
+    std::unique_ptr<bool[]> valid{new bool[indices.size()]};
+    bool check = true;
+
+    Path::verify_paths(valid.get(), ROOT, leaves.data(), indices.data(), siblings.data(),
+                       indices.size());
+
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        check &= valid[i] == (i % 3 == 0);
+        check &= Path::verify_path(ROOT, leaves[i], indices[i], &siblings[i * PATH_N]) == valid[i];
+    }
+
+    leaves[0][0] ^= 1;
+    check &= !Path::verify_path(ROOT, leaves[0], indices[0], &siblings[0]);
+
+    return check;
+}
+
+template<size_t height, typename Hash>
+static bool partial_trees()
+{
+    using Tree = MTree<height, Hash>;
+    using Path = MTreePath<height, Hash>;
+    using Digest = typename Tree::Digest;
+
+    static constexpr size_t ARITY = Tree::ARITY;
+    static constexpr size_t LEAVES_N = Tree::LEAVES_N;
+    static constexpr size_t PATH_N = Tree::PATH_N;
+
+    std::vector<uint8_t> data(Tree::INPUT_SIZE);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = i * 13 % 239;
+
+    bool check = true;
+
+    for (size_t leaves_n : {(size_t)1, (size_t)2, ARITY + 1, LEAVES_N / 3 + 5, LEAVES_N - 1})
+    {
+        Tree tree(data.data(), leaves_n * Hash::BLOCK_SIZE);
+
+        // reference root, every level padded with zero digests to a multiple of ARITY
+        std::vector<Digest> level(leaves_n);
+        for (size_t i = 0; i < leaves_n; ++i)
+            Hash::hash_oneblock(level[i].data(), data.data() + i * Hash::BLOCK_SIZE);
+
+        for (size_t l = 1; l < height; ++l)
+        {
+            std::vector<Digest> parents((level.size() - 1) / ARITY + 1);
+
+            level.resize(parents.size() * ARITY);
+            for (size_t p = 0; p < parents.size(); ++p)
+                Hash::hash_oneblock(parents[p].data(), level[p * ARITY].data());
+
+            level = parents;
+        }
+
+        check &= tree.size() == leaves_n;
+        check &= memcmp(tree.digest(), level[0].data(), Hash::DIGEST_SIZE) == 0;
+
+        // the last leaves sit under the nodes with missing children
+        std::vector<size_t> indices;
+        std::vector<Digest> leaves;
+        for (size_t i = 0; i < std::min(leaves_n, (size_t)20); ++i)
+        {
+            indices.push_back(i % 2 ? leaves_n - 1 - i / 2 : i * 7919 % leaves_n);
+            leaves.push_back(tree.get_node(indices.back())->get_digest());
+        }
+
+        std::vector<Digest> siblings = tree.paths(indices.begin(), indices.end());
+        std::unique_ptr<bool[]> valid{new bool[indices.size()]};
+
+        Path::verify_paths(valid.get(), tree.digest(), leaves.data(), indices.data(),
+                           siblings.data(), indices.size(), leaves_n);
+
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            check &= valid[i];
+            check &= Path::verify_path(tree.digest(), leaves[i], indices[i],
+                                       &siblings[i * PATH_N], leaves_n);
+        }
+
+        auto proof = tree.multiproof(indices.begin(), indices.end());
+        std::vector<Digest> proven;
+        for (size_t i : proof.indices)
+            proven.push_back(tree.get_node(i)->get_digest());
+
+        check &= proof.leaves_n == leaves_n;
+        check &= Tree::verify_multiproof(tree.digest(), proof, proven.data());
+
+        // an index past the last leaf is rejected even where its path would hash to the root
+        check &= !Path::verify_path(tree.digest(), leaves[0], indices[0], &siblings[0],
+                                    indices[0]);
+
+        size_t bad = leaves_n;
+
+        std::cerr.setstate(std::ios::failbit);
+        check &= tree.paths(&bad, 1).empty();
+        std::cerr.clear();
+
+        // updating a leaf under a node with missing children matches a rebuild
+        std::vector<uint8_t> changed(data.begin(), data.begin() + leaves_n * Hash::BLOCK_SIZE);
+        typename Tree::LeafUpdate update{leaves_n - 1, {}};
+
+        changed.back() ^= 1;
+        Hash::hash_oneblock(update.second.data(), &changed[(leaves_n - 1) * Hash::BLOCK_SIZE]);
+        tree.update_leaves(&update, 1);
+
+        Tree ref(changed.begin(), changed.end());
+
+        check &= memcmp(tree.digest(), ref.digest(), Hash::DIGEST_SIZE) == 0;
+    }
+
+    check &= Tree(data.begin(), data.end()).size() == LEAVES_N;
+
+    return check;
+}
+
 static bool run_tests()
 {
     bool check = true;
@@ -55,6 +279,94 @@ static bool run_tests()
     std::cout << check << '\n';
     all_check &= check;
 
+    std::cout << "Cursors... ";
+    check = true;
+    {
+        using Tree = MTree<HEIGHT, Sha256>;
+
+        std::vector<uint8_t> data(Tree::INPUT_SIZE);
+        for (size_t i = 0; i < data.size(); ++i)
+            data[i] = i % 251;
+
+        Tree tree(data.begin(), data.end());
+
+        // every parent must be the hash of its children and walking down and up must round trip
+        for (size_t i = Tree::LEAVES_N; i < Tree::NODES_N; ++i)
+        {
+            auto node = tree.get_node(i);
+            uint8_t block[Sha256::BLOCK_SIZE];
+            uint8_t digest[Sha256::DIGEST_SIZE];
+
+            for (size_t k = 0; k < Tree::ARITY; ++k)
+            {
+                memcpy(block + k * Sha256::DIGEST_SIZE, node->get_c(k)->get_digest().data(),
+                       Sha256::DIGEST_SIZE);
+                check &= node->get_c(k)->get_f() == node;
+            }
+
+            Sha256::hash_oneblock(digest, block);
+            check &= memcmp(digest, node->get_digest().data(), Sha256::DIGEST_SIZE) == 0;
+        }
+
+        check &= !tree.get_node(Tree::NODES_N - 1)->get_f();
+        check &= !tree.get_node(0)->get_c(0);
+        check &= memcmp(tree.get_node(Tree::NODES_N - 1)->get_digest().data(), tree.digest(),
+                        Sha256::DIGEST_SIZE) == 0;
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Subtree builds... ";
+    check = true;
+    {
+        // the split level and the merge order depend on the thread count, the root must not
+        using Tree = MTree<12, Sha256>;
+
+        std::vector<uint8_t> data(Tree::INPUT_SIZE);
+        for (size_t i = 0; i < data.size(); ++i)
+            data[i] = i * 7 % 253;
+
+        Tree ref(data.begin(), data.end());
+        int threads = omp_get_max_threads();
+
+        for (int n : {1, 3, 64})
+        {
+            omp_set_num_threads(n);
+
+            Tree tree(data.begin(), data.end());
+
+            check &= memcmp(tree.digest(), ref.digest(), Sha256::DIGEST_SIZE) == 0;
+        }
+        omp_set_num_threads(threads);
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Leaf updates... ";
+    check = updates_match_rebuild<MTree<12, Sha256>, Sha256>(1ULL << 11, Sha256::hash_oneblock);
+    check &= updates_match_rebuild<MTree<8, Sha512>, Sha512>(1ULL << 7, Sha512::hash_oneblock);
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Paths and multiproofs... ";
+    check = proofs_match_tree<MTree<12, Sha256>, Sha256>();
+    check &= proofs_match_tree<MTree<10, Sha512>, Sha512>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Path verification... ";
+    check = paths_verify<12, Sha256>();
+    check &= paths_verify<9, Sha512>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Partial trees... ";
+    check = partial_trees<12, Sha256>();
+    check &= partial_trees<9, Sha512>();
+    check &= partial_trees<4, Arion<FieldT, 7, 1>>();
+    std::cout << check << '\n';
+    all_check &= check;
+
     std::cout << "Tree Path SHA256... ";
     check = true;
     {
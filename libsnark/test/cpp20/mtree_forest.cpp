@@ -0,0 +1,116 @@
+#include "tree/mtree_forest.hpp"
+#include "tree/mtree.hpp"
+#include "hash/sha256.hpp"
+#include "hash/sha512.hpp"
+#include "hash/arion.hpp"
+#include "util/string_utils.hpp"
+#include <cstring>
+#include <iostream>
+#include <span>
+
+using FieldT = libff::Fq<libff::default_ec_pp>;
+
+template<size_t height, typename Hash>
+static bool same_as_mtree(size_t large_n, size_t small_n)
+{
+    using Tree = MTree<height, Hash>;
+    using Forest = MTreeForest<height, Hash>;
+
+    std::vector<uint8_t> data(Tree::INPUT_SIZE * 3);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = i * 17 % 233;
+
+    Forest forest;
+    const int max_threads = omp_get_max_threads();
+    bool check = true;
+
+    // a large batch then a smaller one in the same arena, with 1 and several threads
+    for (size_t trees_n : {large_n, small_n})
+        for (int threads : {1, 3})
+        {
+            std::vector<typename Forest::Input> inputs;
+            for (size_t t = 0; t < trees_n; ++t)
+            {
+                const size_t leaves_n = t % 5 == 0 ? Tree::LEAVES_N : t * 7919 % Tree::LEAVES_N + 1;
+                inputs.emplace_back(data.data() + t * 101 % (2 * Tree::INPUT_SIZE) /
+                                                      Hash::BLOCK_SIZE * Hash::BLOCK_SIZE,
+                                    leaves_n * Hash::BLOCK_SIZE);
+            }
+
+            omp_set_num_threads(threads);
+            forest.build_forest(std::span(inputs));
+            omp_set_num_threads(max_threads);
+            check &= forest.size() == trees_n;
+
+            for (size_t t = 0; t < trees_n; ++t)
+            {
+                Tree tree((const uint8_t *)inputs[t].first, inputs[t].second);
+                std::vector<size_t> indices{0, tree.size() - 1, tree.size() / 2};
+
+                check &= forest.leaves(t) == tree.size();
+                check &= memcmp(forest.digest(t), tree.digest(), Hash::DIGEST_SIZE) == 0;
+                check &= forest.paths(t, indices.data(), indices.size()) ==
+                         tree.paths(indices.begin(), indices.end());
+            }
+        }
+
+    return check;
+}
+
+static bool run_tests()
+{
+    bool check = true;
+    bool all_check = true;
+
+    std::cout << std::boolalpha;
+
+    std::cout << "Same as MTree... ";
+    check = same_as_mtree<5, Sha256>(300, 41);
+    check &= same_as_mtree<9, Sha256>(300, 41);
+    check &= same_as_mtree<4, Sha512>(300, 41);
+    check &= same_as_mtree<3, Arion<FieldT, 7, 1>>(6, 2);
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Bad arguments... ";
+    check = true;
+    {
+        using Forest = MTreeForest<4, Sha256>;
+
+        std::vector<uint8_t> data(Forest::INPUT_SIZE + Sha256::BLOCK_SIZE);
+        Forest forest;
+
+        std::vector<Forest::Input> inputs{{data.data(), Forest::INPUT_SIZE}};
+        forest.build_forest(std::span(inputs));
+        check &= forest.size() == 1;
+
+        std::cerr.setstate(std::ios::failbit);
+        size_t bad = Forest::LEAVES_N;
+        check &= forest.paths(0, &bad, 1).empty();
+
+        for (size_t size : {(size_t)0, Sha256::BLOCK_SIZE - 1, data.size()})
+        {
+            inputs.emplace_back(data.data(), size);
+            forest.build_forest(std::span(inputs));
+            check &= forest.size() == 0;
+            inputs.pop_back();
+        }
+        std::cerr.clear();
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    return all_check;
+}
+
+int main()
+{
+    std::cout << "\n==== Testing Merkle Tree Forest ====\n";
+
+    bool all_check = run_tests();
+
+    std::cout << "\n==== " << (all_check ? "ALL TESTS SUCCEEDED" : "SOME TESTS FAILED")
+              << " ====\n\n";
+
+    return 0;
+}
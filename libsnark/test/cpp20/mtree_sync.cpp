@@ -0,0 +1,254 @@
+#include "tree/mtree_sync.hpp"
+#include "tree/mtree.hpp"
+#include "hash/sha256.hpp"
+#include "hash/sha512.hpp"
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+// Changes the blocks of data at the given indices, sorted ranges of the distinct ones
+template<typename Hash>
+static std::vector<std::pair<size_t, size_t>> change(std::vector<uint8_t> &data,
+                                                     const std::vector<size_t> &indices)
+{
+    std::set<size_t> leaves(indices.begin(), indices.end());
+    std::vector<std::pair<size_t, size_t>> ranges;
+
+    for (size_t leaf : leaves)
+    {
+        data[leaf * Hash::BLOCK_SIZE] ^= 0x5a;
+
+        if (!ranges.empty() && ranges.back().second == leaf)
+            ++ranges.back().second;
+        else
+            ranges.emplace_back(leaf, leaf + 1);
+    }
+
+    return ranges;
+}
+
+// Replica of old data pulled from a source on new data, over a socket or a pair of pipes
+template<size_t height, typename Hash>
+static bool sync(const std::vector<uint8_t> &old_data, const std::vector<uint8_t> &new_data,
+                 bool socket)
+{
+    using Tree = MTree<height, Hash>;
+    using Sync = MTreeSync<height, Hash>;
+
+    Tree source(new_data.begin(), new_data.end());
+    Tree replica(old_data.begin(), old_data.end());
+    const auto ranges = replica.diff(source);
+
+    int to_replica[2], to_source[2];
+
+    if (socket)
+    {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, to_replica) != 0)
+            return false;
+        to_source[0] = to_replica[1];
+        to_source[1] = to_replica[0];
+    }
+    else if (pipe(to_replica) != 0 || pipe(to_source) != 0)
+        return false;
+
+    bool served = false;
+    std::thread server([&]() { served = Sync::serve(source, to_source[0], to_replica[1]); });
+
+    std::vector<typename Tree::LeafRange> changed;
+    bool pulled = Sync::pull(replica, to_replica[0], to_source[1], &changed);
+
+    server.join();
+    close(to_replica[0]);
+    close(to_replica[1]);
+    if (!socket)
+    {
+        close(to_source[0]);
+        close(to_source[1]);
+    }
+
+    return served && pulled && changed == ranges &&
+           memcmp(replica.digest(), source.digest(), Hash::DIGEST_SIZE) == 0;
+}
+
+// Copies a stream until it ends and flips the byte at offset, the bytes copied go to size
+static void relay(int in_fd, int out_fd, size_t offset, size_t &size)
+{
+    uint8_t buff[4096];
+    ssize_t n;
+
+    for (size = 0; (n = read(in_fd, buff, sizeof(buff))) > 0; size += n)
+    {
+        if (offset >= size && offset < size + n)
+            buff[offset - size] ^= 1;
+
+        if (write(out_fd, buff, n) != n)
+            return;
+    }
+}
+
+/*
+Replica of old data pulled from a source on new data through a relay flipping the byte at offset
+of the stream from the source. The replica must refuse it and keep its root. The size of the
+stream goes to size.
+*/
+template<size_t height, typename Hash>
+static bool corrupted(const std::vector<uint8_t> &old_data, const std::vector<uint8_t> &new_data,
+                      size_t offset, size_t &size)
+{
+    using Tree = MTree<height, Hash>;
+    using Sync = MTreeSync<height, Hash>;
+
+    Tree source(new_data.begin(), new_data.end());
+    Tree replica(old_data.begin(), old_data.end());
+    const Tree old_replica(old_data.begin(), old_data.end());
+
+    int from_source[2], to_replica[2], to_source[2];
+
+    if (pipe(from_source) != 0 || pipe(to_replica) != 0 || pipe(to_source) != 0)
+        return false;
+
+    bool served = false;
+    std::thread server([&]() { served = Sync::serve(source, to_source[0], from_source[1]); });
+    std::thread relay_thread([&]() { relay(from_source[0], to_replica[1], offset, size); });
+
+    std::cerr.setstate(std::ios::failbit);
+    bool pulled = Sync::pull(replica, to_replica[0], to_source[1]);
+    std::cerr.clear();
+
+    server.join();
+    close(from_source[1]);
+    relay_thread.join();
+    for (int fd : {from_source[0], to_replica[0], to_replica[1], to_source[0], to_source[1]})
+        close(fd);
+
+    return served && !pulled &&
+           memcmp(replica.digest(), old_replica.digest(), Hash::DIGEST_SIZE) == 0;
+}
+
+template<size_t height, typename Hash>
+static bool diff_and_sync(size_t leaves_n)
+{
+    using Tree = MTree<height, Hash>;
+
+    std::vector<uint8_t> old_data(leaves_n * Hash::BLOCK_SIZE);
+    for (size_t i = 0; i < old_data.size(); ++i)
+        old_data[i] = i * 13 % 251;
+
+    bool check = true;
+
+    // nothing, one leaf, clustered and spread leaves, the last one of a partial tree
+    for (const std::vector<size_t> &indices :
+         std::vector<std::vector<size_t>>{{},
+                                          {leaves_n / 2},
+                                          {3, 4, 5, 6, 40, 41, 7919 % leaves_n},
+                                          {0, leaves_n - 1, leaves_n / 3, leaves_n / 3 + 9}})
+    {
+        std::vector<uint8_t> new_data = old_data;
+        std::vector<size_t> clamped;
+
+        for (size_t i : indices)
+            clamped.push_back(i % leaves_n);
+
+        const auto ranges = change<Hash>(new_data, clamped);
+        Tree old_tree(old_data.begin(), old_data.end());
+        Tree new_tree(new_data.begin(), new_data.end());
+
+        check &= old_tree.diff(new_tree) == ranges && new_tree.diff(old_tree) == ranges;
+        check &= sync<height, Hash>(old_data, new_data, true);
+        check &= sync<height, Hash>(old_data, new_data, false);
+    }
+
+    return check;
+}
+
+static bool run_tests()
+{
+    bool check = true;
+    bool all_check = true;
+
+    std::cout << std::boolalpha;
+
+    std::cout << "Diff and sync... ";
+    check = diff_and_sync<10, Sha256>(MTree<10, Sha256>::LEAVES_N);
+    check &= diff_and_sync<10, Sha256>(300);
+    check &= diff_and_sync<6, Sha512>(MTree<6, Sha512>::LEAVES_N - 5);
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Corrupted stream... ";
+    check = true;
+    {
+        static constexpr size_t HEADER_SIZE = 48;
+
+        const size_t leaves_n = 300;
+        std::vector<uint8_t> old_data(leaves_n * Sha256::BLOCK_SIZE);
+        for (size_t i = 0; i < old_data.size(); ++i)
+            old_data[i] = i * 13 % 251;
+
+        std::vector<uint8_t> new_data = old_data;
+        change<Sha256>(new_data, {0, 7, 150, leaves_n - 1});
+
+        // a relay past the end of the stream only counts it, the replica takes the stream
+        size_t size = 0;
+        check &= !corrupted<10, Sha256>(old_data, new_data, SIZE_MAX, size);
+        check &= size > HEADER_SIZE + Sha256::DIGEST_SIZE;
+
+        // header, root, the children of the root, the last leaf
+        for (size_t offset : {(size_t)0, HEADER_SIZE + 3, HEADER_SIZE + Sha256::DIGEST_SIZE + 5,
+                              size - 1})
+        {
+            size_t corrupted_size = 0;
+
+            check &= corrupted<10, Sha256>(old_data, new_data, offset, corrupted_size);
+        }
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Different sizes... ";
+    check = true;
+    {
+        using Tree = MTree<5, Sha256>;
+
+        std::vector<uint8_t> data(Tree::INPUT_SIZE);
+        Tree full(data.begin(), data.end());
+        Tree part(data.data(), 5 * Sha256::BLOCK_SIZE);
+
+        check &= full.diff(part) == std::vector<Tree::LeafRange>{{0, Tree::LEAVES_N}};
+
+        int fds[2];
+        check &= socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0;
+
+        bool served = false;
+        std::thread server([&]() { served = MTreeSync<5, Sha256>::serve(full, fds[0], fds[0]); });
+
+        std::cerr.setstate(std::ios::failbit);
+        check &= !MTreeSync<5, Sha256>::pull(part, fds[1], fds[1]);
+        std::cerr.clear();
+
+        server.join();
+        close(fds[0]);
+        close(fds[1]);
+
+        check &= served && part.size() == 5;
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    return all_check;
+}
+
+int main()
+{
+    std::cout << "\n==== Testing Merkle Tree Sync ====\n";
+
+    bool all_check = run_tests();
+
+    std::cout << "\n==== " << (all_check ? "ALL TESTS SUCCEEDED" : "SOME TESTS FAILED")
+              << " ====\n\n";
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "tree/pruned_mtree.hpp"
+#include "tree/mtree.hpp"
+#include "hash/sha256.hpp"
+#include "hash/sha512.hpp"
+#include <cstring>
+#include <iostream>
+
+template<size_t height, typename Hash>
+static bool same_as_mtree()
+{
+    using Tree = MTree<height, Hash>;
+    using Pruned = PrunedMTree<height, Hash>;
+
+    std::vector<uint8_t> data(Tree::INPUT_SIZE);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = i * 11 % 241;
+
+    Tree tree(data.begin(), data.end());
+
+    // clustered and spread leaves, the same subtree asked again later
+    std::vector<size_t> indices;
+    for (size_t i = 0; i < 100; ++i)
+        indices.push_back(i < 30 ? i : i * 7919 % Tree::LEAVES_N);
+    indices.push_back(5);
+
+    auto ref = tree.paths(indices.begin(), indices.end());
+    bool check = true;
+
+    for (size_t levels : {(size_t)1, (size_t)3, height - 1, height})
+        for (bool keep_leaves : {true, false})
+            for (size_t cache_subtrees : {1, 4})
+            {
+                Pruned pruned(data.begin(), data.end(), levels, keep_leaves, cache_subtrees);
+
+                check &= memcmp(pruned.digest(), tree.digest(), Hash::DIGEST_SIZE) == 0;
+
+                // twice, the second time partly from the cache
+                for (size_t k = 0; k < 2; ++k)
+                    check &= pruned.paths(indices.begin(), indices.end()) == ref;
+
+                check &= pruned.cache_size() < cache_subtrees * Tree::NODES_N;
+                check &= pruned.resident_size() ==
+                         pow_sum(Pruned::ARITY, (size_t)0, levels) +
+                             (keep_leaves && levels < height ? Tree::LEAVES_N : 0);
+            }
+
+    return check;
+}
+
+static bool run_tests()
+{
+    bool check = true;
+    bool all_check = true;
+
+    std::cout << std::boolalpha;
+
+    std::cout << "Same as MTree... ";
+    check = same_as_mtree<12, Sha256>();
+    check &= same_as_mtree<8, Sha512>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Bad arguments... ";
+    check = true;
+    {
+        using Pruned = PrunedMTree<6, Sha256>;
+
+        std::vector<uint8_t> data(Pruned::INPUT_SIZE);
+
+        std::cerr.setstate(std::ios::failbit);
+        Pruned pruned(data.begin(), data.end(), 3);
+        size_t bad = Pruned::LEAVES_N;
+
+        check &= pruned.paths(&bad, 1).empty();
+        check &= Pruned(data.begin(), data.end(), 0).resident_size() == 0;
+        check &= Pruned(data.begin(), data.end() - 1, 2).resident_size() == 0;
+
+        // rejected trees have the zero digest and no paths
+        const uint8_t zero[Sha256::DIGEST_SIZE]{};
+        size_t index = 0;
+
+        for (const Pruned &rejected : {Pruned(data.begin(), data.end(), 7),
+                                       Pruned(data.begin(), data.end() - 1, 2)})
+        {
+            check &= memcmp(rejected.digest(), zero, Sha256::DIGEST_SIZE) == 0;
+            check &= rejected.paths(&index, 1).empty();
+        }
+        std::cerr.clear();
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    return all_check;
+}
+
+int main()
+{
+    std::cout << "\n==== Testing Pruned Merkle Tree ====\n";
+
+    bool all_check = run_tests();
+
+    std::cout << "\n==== " << (all_check ? "ALL TESTS SUCCEEDED" : "SOME TESTS FAILED")
+              << " ====\n\n";
+
+#ifdef MEASURE_PERFORMANCE
+#endif
+
+    return 0;
+}
@@ -2,6 +2,8 @@
 #include "util/string_utils.hpp"
 #include <cstring>
 #include <iostream>
+#include <random>
+#include <vector>
 
 static bool run_tests()
 {
@@ -22,6 +24,70 @@ static bool run_tests()
     std::cout << check << '\n';
     all_check &= check;
 
+    std::cout << "Batched hashing... ";
+    check = true;
+    {
+        // Enough blocks for every lane width and a remainder
+        static constexpr size_t COUNT = 2 * Sha256::LANES_N + 3;
+
+        std::mt19937 rng{std::random_device{}()};
+        std::vector<uint8_t> blocks(COUNT * Sha256::BLOCK_SIZE);
+        std::vector<uint8_t> digests(COUNT * Sha256::DIGEST_SIZE);
+
+        std::generate(blocks.begin(), blocks.end(), std::ref(rng));
+        Sha256::hash_oneblock_many(digests.data(), blocks.data(), COUNT);
+
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            Sha256::hash_oneblock_generic(dig, blocks.data() + i * Sha256::BLOCK_SIZE);
+            check &= memcmp(dig, digests.data() + i * Sha256::DIGEST_SIZE, sizeof(dig)) == 0;
+            Sha256::hash_oneblock(dig, blocks.data() + i * Sha256::BLOCK_SIZE);
+            check &= memcmp(dig, digests.data() + i * Sha256::DIGEST_SIZE, sizeof(dig)) == 0;
+        }
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Host kernels... ";
+    check = true;
+    {
+        // Every kernel the host supports must agree with the generic code, whatever the dispatch
+        static constexpr size_t COUNT = U32x16::LANES_N;
+
+        const CpuFeatures &cpu = cpu_features();
+        std::mt19937 rng{std::random_device{}()};
+        std::vector<uint8_t> blocks(COUNT * Sha256::BLOCK_SIZE);
+        std::vector<uint8_t> digests(COUNT * Sha256::DIGEST_SIZE);
+        std::vector<uint8_t> lanes(COUNT * Sha256::DIGEST_SIZE);
+
+        std::generate(blocks.begin(), blocks.end(), std::ref(rng));
+        for (size_t i = 0; i < COUNT; ++i)
+            Sha256::hash_oneblock_generic(digests.data() + i * Sha256::DIGEST_SIZE,
+                                          blocks.data() + i * Sha256::BLOCK_SIZE);
+
+        if (cpu.avx2)
+        {
+            Sha256::hash_lanes_avx2(lanes.data(), blocks.data());
+            Sha256::hash_lanes_avx2(lanes.data() + U32x8::LANES_N * Sha256::DIGEST_SIZE,
+                                    blocks.data() + U32x8::LANES_N * Sha256::BLOCK_SIZE);
+            check &= lanes == digests;
+        }
+
+        if (cpu.avx512f)
+        {
+            Sha256::hash_lanes_avx512(lanes.data(), blocks.data());
+            check &= lanes == digests;
+        }
+        if (cpu.sha)
+            for (size_t i = 0; i < COUNT; ++i)
+            {
+                Sha256::hash_oneblock_ni(dig, blocks.data() + i * Sha256::BLOCK_SIZE);
+                check &= memcmp(dig, digests.data() + i * Sha256::DIGEST_SIZE, sizeof(dig)) == 0;
+            }
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
     return all_check;
 }
 
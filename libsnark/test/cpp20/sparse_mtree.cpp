@@ -0,0 +1,155 @@
+#include "tree/sparse_mtree.hpp"
+#include "hash/sha256.hpp"
+#include "hash/sha512.hpp"
+#include "util/string_utils.hpp"
+#include <cstring>
+#include <iostream>
+
+template<typename Tree, typename Hash>
+static typename Tree::Digest fold_path(typename Tree::Key key, typename Tree::Digest digest,
+                                       const std::vector<typename Tree::Digest> &path)
+{
+    uint8_t pair[2 * Hash::DIGEST_SIZE];
+
+    for (const auto &sibling : path)
+    {
+        size_t right = key[0] & 1;
+
+        memcpy(pair + Hash::DIGEST_SIZE * right, digest.data(), Hash::DIGEST_SIZE);
+        memcpy(pair + Hash::DIGEST_SIZE * (1 - right), sibling.data(), Hash::DIGEST_SIZE);
+        fixed_mtree_hash_pairs<Hash>(digest.data(), pair, 1);
+
+        for (size_t i = 0; i < key.size(); ++i)
+            key[i] = key[i] >> 1 | (i + 1 < key.size() ? key[i + 1] << 63 : 0);
+    }
+
+    return digest;
+}
+
+template<size_t height, typename Hash>
+static bool same_as_fixed()
+{
+    // A sparse tree must hash like the full tree holding zero digests in the unset leaves
+    using Sparse = SparseMTree<height, Hash>;
+    using Full = FixedMTree<height, Hash>;
+
+    std::vector<uint8_t> data(Full::INPUT_SIZE);
+    std::vector<typename Full::LeafUpdate> leaves;
+    Sparse sparse;
+
+    for (size_t i = 0; i < (1ULL << (height - 1)); ++i)
+    {
+        typename Full::Digest leaf{};
+
+        if (i % 5 == 2)
+        {
+            leaf[0] = i;
+            leaf[1] = 1;
+            sparse.insert(i, leaf);
+        }
+        leaves.emplace_back(i, leaf);
+    }
+
+    Full full(data.begin(), data.end());
+
+    full.update_leaves(leaves.begin(), leaves.end());
+
+    return sparse.digest() == full.digest();
+}
+
+template<size_t height, typename Hash>
+static bool insert_remove()
+{
+    using Tree = SparseMTree<height, Hash>;
+
+    Tree tree;
+    std::vector<typename Tree::Key> keys;
+    bool check = tree.digest() == Tree::empty_digest(height - 1);
+
+    // Far apart and neighbouring leaves, in every key word
+    for (size_t i = 0; i < 8; ++i)
+    {
+        typename Tree::Key key{};
+
+        key[i % Tree::KEY_WORDS] = (i * 0x9e3779b97f4a7c15ULL) >> (i < 4 ? 1 : 40);
+        key.back() &= (height - 1) % 64 ? (1ULL << ((height - 1) % 64)) - 1 : ~0ULL;
+        keys.push_back(key);
+
+        key[0] ^= 1;
+        keys.push_back(key);
+    }
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        typename Tree::Digest leaf{};
+
+        leaf[i % Hash::DIGEST_SIZE] = i + 1;
+        tree.insert(keys[i], leaf);
+    }
+
+    for (size_t i = 0; i < keys.size(); ++i)
+        check &= fold_path<Tree, Hash>(keys[i], tree.get_leaf(keys[i]), tree.path(keys[i])) ==
+                 tree.digest();
+
+    // Memory only depends on the set leaves
+    check &= tree.size() <= keys.size() * height;
+
+    for (const auto &key : keys)
+        tree.remove(key);
+
+    check &= tree.size() == 0 && tree.digest() == Tree::empty_digest(height - 1);
+
+    return check;
+}
+
+static bool run_tests()
+{
+    bool check = true;
+    bool all_check = true;
+
+    std::cout << std::boolalpha;
+
+    std::cout << "Same as full tree... ";
+    check = same_as_fixed<4, Sha256>();
+    check &= same_as_fixed<9, Sha256>();
+    check &= same_as_fixed<7, Sha512>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Insert and remove... ";
+    check = insert_remove<32, Sha256>();
+    check &= insert_remove<65, Sha256>();
+    check &= insert_remove<256, Sha256>();
+    check &= insert_remove<100, Sha512>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Bad index... ";
+    {
+        SparseMTree<8, Sha256> tree;
+
+        std::cerr.setstate(std::ios::failbit);
+        tree.insert(1ULL << 7, SparseMTree<8, Sha256>::Digest{1});
+        std::cerr.clear();
+        check = tree.size() == 0;
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    return all_check;
+}
+
+int main()
+{
+    std::cout << "\n==== Testing Sparse Merkle Tree ====\n";
+
+    bool all_check = run_tests();
+
+    std::cout << "\n==== " << (all_check ? "ALL TESTS SUCCEEDED" : "SOME TESTS FAILED")
+              << " ====\n\n";
+
+#ifdef MEASURE_PERFORMANCE
+#endif
+
+    return 0;
+}
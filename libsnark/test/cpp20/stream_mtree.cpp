@@ -0,0 +1,183 @@
+#include "tree/stream_mtree.hpp"
+#include "tree/mtree.hpp"
+#include "hash/sha256.hpp"
+#include "hash/sha512.hpp"
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+template<size_t height, typename Hash>
+static bool same_as_mtree()
+{
+    using Tree = MTree<height, Hash>;
+    using Stream = StreamMTree<height, Hash>;
+
+    std::vector<uint8_t> data(Tree::INPUT_SIZE);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = i * 13 % 251;
+
+    Tree tree(data.begin(), data.end());
+    bool check = true;
+
+    auto same = [&](const Stream &stream)
+    {
+        return stream.is_complete() &&
+               memcmp(stream.digest(), tree.digest(), Hash::DIGEST_SIZE) == 0;
+    };
+
+    {
+        Stream stream;
+
+        stream.update(data.data(), data.size());
+        check &= same(stream);
+    }
+
+    // pieces that split blocks and batches
+    {
+        Stream stream;
+
+        for (size_t i = 0, n = 1; i < data.size(); i += n, n = n * 3 % 1000 + 1)
+            stream.update(data.data() + i, std::min(n, data.size() - i));
+        check &= same(stream);
+    }
+
+    // producers reading ahead, the first part streamed by hand
+    for (size_t producers : {1, 3})
+    {
+        Stream stream;
+
+        stream.update(data.data(), 100);
+        check &= stream.update_parallel(
+            [&](size_t offset, uint8_t *chunk, size_t size)
+            {
+                memcpy(chunk, data.data() + offset, size);
+                return true;
+            },
+            producers, 1000, 2);
+        check &= same(stream);
+    }
+
+    // pushed from a thread of its own, through a small feed
+    {
+        Stream stream;
+        typename Stream::Feed feed(2, 1000);
+
+        std::thread producer(
+            [&]
+            {
+                for (size_t i = 0, n = 1; i < data.size(); i += n, n = n * 7 % 1000 + 1)
+                    feed.push(data.data() + i, std::min(n, data.size() - i));
+                feed.close();
+            });
+
+        check &= stream.consume(feed);
+        producer.join();
+        check &= same(stream);
+    }
+
+    return check;
+}
+
+static bool run_tests()
+{
+    bool check = true;
+    bool all_check = true;
+
+    std::cout << std::boolalpha;
+
+    std::cout << "Same as MTree... ";
+    check = same_as_mtree<12, Sha256>();
+    check &= same_as_mtree<9, Sha512>();
+    check &= same_as_mtree<2, Sha256>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Pushed from threads... ";
+    check = true;
+    {
+        using Tree = MTree<10, Sha256>;
+        using Stream = StreamMTree<10, Sha256>;
+
+        // every chunk is the same, whichever producer wins the ticket
+        static constexpr size_t CHUNK = 1024;
+        std::vector<uint8_t> data(Tree::INPUT_SIZE);
+        for (size_t i = 0; i < data.size(); ++i)
+            data[i] = i % CHUNK * 13 % 251;
+
+        Tree tree(data.begin(), data.end());
+        Stream stream;
+        Stream::Feed feed(3, CHUNK);
+        std::atomic<size_t> next{0};
+        std::vector<std::thread> producers;
+
+        for (size_t t = 0; t < 4; ++t)
+            producers.emplace_back(
+                [&]
+                {
+                    while (next.fetch_add(1) < data.size() / CHUNK)
+                        feed.push(data.data(), CHUNK);
+                });
+
+        std::thread closer(
+            [&]
+            {
+                for (auto &producer : producers)
+                    producer.join();
+                feed.close();
+            });
+
+        check &= stream.consume(feed);
+        closer.join();
+        check &= memcmp(stream.digest(), tree.digest(), Sha256::DIGEST_SIZE) == 0;
+
+        // an oversized chunk is refused, an empty closed feed leaves the tree as it was
+        Stream::Feed small(2, 10);
+        Stream empty;
+
+        std::cerr.setstate(std::ios::failbit);
+        check &= !small.push(data.data(), 11);
+        std::cerr.clear();
+        small.close();
+        check &= !empty.consume(small) && empty.size() == 0;
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Bad input... ";
+    check = true;
+    {
+        using Stream = StreamMTree<10, Sha256>;
+
+        std::vector<uint8_t> data(Stream::INPUT_SIZE + 1);
+        Stream stream;
+
+        std::cerr.setstate(std::ios::failbit);
+        stream.update(data.data(), data.size());
+        std::cerr.clear();
+        check &= stream.size() == 0;
+
+        // a failing producer stops the pipeline
+        check &= !stream.update_parallel(
+            [](size_t offset, uint8_t *, size_t) { return offset < 5000; }, 2, 1000, 2);
+        check &= !stream.is_complete() && stream.size() <= 5000;
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    return all_check;
+}
+
+int main()
+{
+    std::cout << "\n==== Testing Streaming Merkle Tree ====\n";
+
+    bool all_check = run_tests();
+
+    std::cout << "\n==== " << (all_check ? "ALL TESTS SUCCEEDED" : "SOME TESTS FAILED")
+              << " ====\n\n";
+
+#ifdef MEASURE_PERFORMANCE
+#endif
+
+    return 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstring>
+#include <vector>
+
+/*
+Updates leaves spread over the tree and clustered under shared ancestors, some of them twice, and
+compares the root with a tree rebuilt from the changed data. hash_leaf(leaf, block) gives the
+digest of a leaf as the tree hashes it.
+*/
+template<typename Tree, typename Hash, typename HashLeaf>
+bool updates_match_rebuild(size_t leaves_n, HashLeaf hash_leaf)
+{
+    std::vector<uint8_t> data(Tree::INPUT_SIZE);
+    std::vector<typename Tree::LeafUpdate> updates;
+
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = i % 239;
+
+    Tree tree(data.begin(), data.end());
+
+    for (size_t k = 0; k < 300; ++k)
+    {
+        size_t i = k < 100 ? k * 7919 % leaves_n : k % 40;
+        uint8_t *block = data.data() + i * Hash::BLOCK_SIZE;
+        typename Tree::Digest leaf;
+
+        block[k % (2 * Hash::DIGEST_SIZE)] ^= k + 1;
+        hash_leaf(leaf.data(), block);
+        updates.emplace_back(i, leaf);
+    }
+
+    tree.update_leaves(updates.begin(), updates.end());
+
+    Tree ref(data.begin(), data.end());
+
+    // the root is a pointer or an array depending on the tree
+    return memcmp(&tree.digest()[0], &ref.digest()[0], Hash::DIGEST_SIZE) == 0;
+}
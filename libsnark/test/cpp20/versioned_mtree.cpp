@@ -0,0 +1,222 @@
+#include "tree/versioned_mtree.hpp"
+#include "tree/mtree.hpp"
+#include "hash/sha256.hpp"
+#include "hash/sha512.hpp"
+#include <cstring>
+#include <iostream>
+#include <numeric>
+
+template<size_t height, typename Hash>
+static bool same_as_mtree()
+{
+    using Tree = MTree<height, Hash>;
+    using Versioned = VersionedMTree<height, Hash>;
+    using Digest = typename Tree::Digest;
+
+    static constexpr size_t VERSIONS_N = 6;
+    static constexpr size_t UPDATES_N = 20;
+
+    // zero data, every level is a single shared node
+    std::vector<uint8_t> data(Tree::INPUT_SIZE);
+    Tree tree(data.begin(), data.end());
+    Versioned versioned(data.begin(), data.end());
+
+    bool check = versioned.size() == height - 1;
+    check &= memcmp(versioned.digest(), tree.digest(), Hash::DIGEST_SIZE) == 0;
+
+    std::vector<size_t> versions;
+    std::vector<Digest> roots;
+    std::vector<std::vector<Digest>> paths;
+    std::vector<std::vector<typename Tree::LeafUpdate>> batches;
+    std::vector<size_t> indices{0, 1, Tree::LEAVES_N / 2, Tree::LEAVES_N - 1};
+
+    for (size_t v = 0; v < VERSIONS_N; ++v)
+    {
+        // a leaf twice in a batch, the last update wins
+        std::vector<typename Tree::LeafUpdate> updates;
+        for (size_t i = 0; i < UPDATES_N; ++i)
+        {
+            Digest leaf{};
+
+            leaf[0] = v + 1;
+            leaf[1] = i;
+            updates.emplace_back(i == UPDATES_N - 1 ? updates[0].first
+                                                    : (v * 31 + i * 7919) % Tree::LEAVES_N,
+                                 leaf);
+        }
+
+        tree.update_leaves(updates.begin(), updates.end());
+        versioned.update_leaves(updates.begin(), updates.end());
+
+        check &= memcmp(versioned.digest(), tree.digest(), Hash::DIGEST_SIZE) == 0;
+        check &= versioned.size() <= height - 1 + (v + 1) * UPDATES_N * (height - 1);
+
+        versions.push_back(versioned.snapshot());
+        roots.emplace_back();
+        memcpy(roots.back().data(), tree.digest(), Hash::DIGEST_SIZE);
+        paths.push_back(tree.paths(indices.begin(), indices.end()));
+        batches.push_back(updates);
+    }
+
+    // every version still answers, the current root included
+    for (size_t v = 0; v < VERSIONS_N; ++v)
+    {
+        check &= memcmp(versioned.digest(versions[v]), roots[v].data(), Hash::DIGEST_SIZE) == 0;
+        check &= versioned.paths(versions[v], indices.data(), indices.size()) == paths[v];
+    }
+    check &= versioned.paths(indices.data(), indices.size()) == paths.back();
+
+    // the nodes of a later version are found again instead of being stored twice
+    const size_t shared = versioned.size();
+    versioned.checkout(versions[2]);
+    versioned.update_leaves(batches[3].begin(), batches[3].end());
+    check &= memcmp(versioned.digest(), roots[3].data(), Hash::DIGEST_SIZE) == 0;
+    check &= versioned.size() == shared;
+
+    // rollback, then the versions are released in any order
+    versioned.checkout(versions[2]);
+    check &= memcmp(versioned.digest(), roots[2].data(), Hash::DIGEST_SIZE) == 0;
+    check &= versioned.paths(indices.data(), indices.size()) == paths[2];
+
+    const size_t before = versioned.size();
+    for (size_t v : {5, 0, 3, 1, 4})
+        versioned.release(versions[v]);
+    check &= versioned.versions_n() == 1 && versioned.size() < before;
+    check &= versioned.paths(versions[2], indices.data(), indices.size()) == paths[2];
+
+    // back to zero leaves, only the shared nodes of the zero tree stay
+    versioned.release(versions[2]);
+    check &= versioned.versions_n() == 0;
+
+    Digest zero_leaf;
+    Hash::hash_oneblock(zero_leaf.data(), data.data());
+
+    std::vector<typename Tree::LeafUpdate> reset;
+    for (size_t v = 0; v < VERSIONS_N; ++v)
+        for (size_t i = 0; i < UPDATES_N; ++i)
+            reset.emplace_back((v * 31 + i * 7919) % Tree::LEAVES_N, zero_leaf);
+    versioned.update_leaves(reset.begin(), reset.end());
+
+    check &= versioned.size() == height - 1;
+    check &= memcmp(versioned.digest(), Versioned(data.begin(), data.end()).digest(),
+                    Hash::DIGEST_SIZE) == 0;
+
+    return check;
+}
+
+static bool run_tests()
+{
+    bool check = true;
+    bool all_check = true;
+
+    std::cout << std::boolalpha;
+
+    std::cout << "Same as MTree... ";
+    check = same_as_mtree<12, Sha256>();
+    check &= same_as_mtree<7, Sha512>();
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Random data... ";
+    check = true;
+    {
+        using Tree = MTree<10, Sha256>;
+        using Versioned = VersionedMTree<10, Sha256>;
+
+        std::vector<uint8_t> data(Tree::INPUT_SIZE);
+        for (size_t i = 0; i < data.size(); ++i)
+            data[i] = i * 13 % 251;
+
+        Tree tree(data.begin(), data.end());
+        Versioned versioned(data.begin(), data.end());
+
+        check &= memcmp(versioned.digest(), tree.digest(), Sha256::DIGEST_SIZE) == 0;
+        check &= versioned.size() <= Tree::NODES_N - Tree::LEAVES_N;
+
+        size_t index = 77;
+        check &= versioned.paths(&index, 1) == tree.paths(&index, 1);
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Leaves equal to nodes... ";
+    check = true;
+    {
+        using Tree = MTree<4, Sha256>;
+        using Versioned = VersionedMTree<4, Sha256>;
+
+        // leaves 4 and 5 hold the children of the first nodes of level 1, so their parent has the
+        // digest of the first node of level 2
+        std::vector<uint8_t> data(Tree::INPUT_SIZE);
+        for (size_t i = 0; i < 4 * Sha256::BLOCK_SIZE; ++i)
+            data[i] = i * 13 % 251;
+        for (size_t i = 0; i < 4; ++i)
+            Sha256::hash_oneblock(data.data() + 4 * Sha256::BLOCK_SIZE + i * Sha256::DIGEST_SIZE,
+                                  data.data() + i * Sha256::BLOCK_SIZE);
+
+        Tree tree(data.begin(), data.end());
+        Versioned versioned(data.begin(), data.end());
+        std::vector<size_t> indices(Tree::LEAVES_N);
+        std::iota(indices.begin(), indices.end(), 0);
+
+        check &= memcmp(tree.digest(1, 2), tree.digest(2, 0), Sha256::DIGEST_SIZE) == 0;
+        check &= memcmp(versioned.digest(), tree.digest(), Sha256::DIGEST_SIZE) == 0;
+        check &= versioned.size() == Tree::NODES_N - Tree::LEAVES_N;
+        check &= versioned.paths(indices.data(), indices.size()) ==
+                 tree.paths(indices.begin(), indices.end());
+
+        // the equal nodes are freed one at a time, each with its own children
+        const size_t version = versioned.snapshot();
+        std::vector<Tree::LeafUpdate> updates{{4, {}}, {5, {}}};
+
+        tree.update_leaves(updates.begin(), updates.end());
+        versioned.update_leaves(updates.begin(), updates.end());
+        versioned.release(version);
+
+        check &= memcmp(versioned.digest(), tree.digest(), Sha256::DIGEST_SIZE) == 0;
+        check &= versioned.size() == Tree::NODES_N - Tree::LEAVES_N;
+        check &= versioned.paths(indices.data(), indices.size()) ==
+                 tree.paths(indices.begin(), indices.end());
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    std::cout << "Bad arguments... ";
+    check = true;
+    {
+        using Versioned = VersionedMTree<4, Sha256>;
+
+        std::vector<uint8_t> data(Versioned::INPUT_SIZE);
+        Versioned versioned(data.begin(), data.end());
+        size_t bad = Versioned::LEAVES_N;
+        const size_t nodes_n = versioned.size();
+
+        std::cerr.setstate(std::ios::failbit);
+        check &= versioned.paths(&bad, 1).empty();
+        check &= versioned.paths(0, &bad, 1).empty();
+        check &= versioned.digest(3) == nullptr;
+
+        versioned.release(0);
+        versioned.checkout(0);
+        std::vector<Versioned::LeafUpdate> updates{{bad, {}}};
+        versioned.update_leaves(updates);
+        check &= versioned.size() == nodes_n;
+        std::cerr.clear();
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
+    return all_check;
+}
+
+int main()
+{
+    std::cout << "\n==== Testing Versioned Merkle Tree ====\n";
+
+    bool all_check = run_tests();
+
+    std::cout << "\n==== " << (all_check ? "ALL TESTS SUCCEEDED" : "SOME TESTS FAILED")
+              << " ====\n\n";
+
+    return 0;
+}
@@ -71,7 +71,7 @@ bool test_mtree(size_t trans_idx = 0)
     trans.generate_r1cs_witness(tree.get_node(trans_idx)->get_digest());
     pb.val(idx) = trans_idx;
 
-    const Node *aux = tree.get_node(trans_idx)->get_f();
+    Node aux = tree.get_node(trans_idx)->get_f();
     for (size_t i = 0; i < other.size(); ++i, aux = aux->get_f())
         for (size_t j = 0; j < other[i].size(); ++j)
             other[i][j].generate_r1cs_witness(aux->get_c(j)->get_digest());
@@ -113,6 +113,86 @@ bool test_mtree(size_t trans_idx = 0)
     return result;
 }
 
+/*
+Satisfiability of the path of leaf trans_idx for a gadget of leaves_n leaves. An index past the
+leaves takes its path from a complete tree, so only the range check can reject it. With
+choice_ones other than 1 the choices of the leaf level are changed after the witness to that many
+set bits, over zero data where every leaf equals its siblings, so only the one-hot check can.
+*/
+template<typename GadTree>
+bool check_index(size_t leaves_n, size_t trans_idx, size_t choice_ones = 1)
+{
+    static constexpr size_t HEIGHT = GadTree::HEIGHT;
+    static constexpr size_t ARITY = GadTree::ARITY;
+
+    using DigVar = typename GadTree::DigVar;
+    using Level = typename GadTree::Level;
+    using GadHash = typename GadTree::GadHash;
+    using Hash = typename GadHash::Hash;
+    using Tree = MTree<HEIGHT, Hash>;
+    using Digest = typename Tree::Digest;
+
+    static constexpr size_t DIGEST_VARS = GadHash::DIGEST_VARS;
+
+    std::vector<uint8_t> data((trans_idx < leaves_n ? leaves_n : Tree::LEAVES_N) *
+                              Hash::BLOCK_SIZE);
+    if (choice_ones == 1)
+        for (size_t i = 0; i < data.size(); ++i)
+            data[i] = i * 13 % 251;
+
+    Tree tree{data.begin(), data.end()};
+    const std::vector<Digest> path{tree.paths(&trans_idx, 1)};
+    Digest leaf;
+
+    memcpy(leaf.data(), tree.digest(0, trans_idx), Hash::DIGEST_SIZE);
+
+    libsnark::protoboard<FieldT> pb;
+
+    DigVar out{pb, DIGEST_VARS, FMT("out")};
+    DigVar trans{pb, DIGEST_VARS, FMT("trans")};
+    std::vector<Level> other;
+    PbVariablePP<FieldT> idx{pb, FMT("idx")};
+
+    for (size_t i = 0; i < HEIGHT - 1; ++i)
+        other.emplace_back(make_uniform_array<Level>(pb, DIGEST_VARS, FMT("other_%llu", i)));
+
+    GadTree gadget{pb, out, trans, other, idx, FMT("merkle_tree"), leaves_n};
+
+    pb.set_input_sizes(DIGEST_VARS);
+    gadget.generate_r1cs_constraints();
+
+    trans.generate_r1cs_witness(leaf);
+    pb.val(idx) = trans_idx;
+
+    // the slot of the path node itself is not used, the leaf there matches zero siblings
+    for (size_t i = 0; i < other.size(); ++i)
+        for (size_t j = 0, k = 0; j < ARITY; ++j)
+            if (j == trans_idx / pow(ARITY, i) % ARITY)
+                other[i][j].generate_r1cs_witness(leaf);
+            else
+                other[i][j].generate_r1cs_witness(path[i * (ARITY - 1) + k++]);
+
+    gadget.generate_r1cs_witness();
+
+    // zero choices keep the index when its leaf digit is 0, a second one at position 0 otherwise
+    for (size_t j = 0, c = trans_idx % ARITY; choice_ones != 1 && j < ARITY; ++j)
+        pb.val(gadget.choices()[0][j]) = choice_ones == 2 && (j == c || j == 0) ? 1 : 0;
+
+    // the root of the tree, laid out in variables of its own
+    libsnark::protoboard<FieldT> root_pb;
+    DigVar root{root_pb, DIGEST_VARS, FMT("root")};
+    Digest digest;
+
+    memcpy(digest.data(), tree.digest(), Hash::DIGEST_SIZE);
+    root.generate_r1cs_witness(digest);
+
+    bool result = true;
+    for (size_t k = 0; k < DIGEST_VARS; ++k)
+        result &= pb.val(out[k]) == root_pb.val(root[k]);
+
+    return result && pb.is_satisfied();
+}
+
 static bool run_tests()
 {
     static constexpr size_t TREE_HEIGHT = 4;
@@ -128,7 +208,9 @@ static bool run_tests()
     std::cout << "SHA256... ";
     std::cout.flush();
     {
-        check = test_mtree<MTreeGadget<TREE_HEIGHT, Sha256Gadget<FieldT>>, true>();
+        using Gadget = MTreeGadget<TREE_HEIGHT, Sha256Gadget<FieldT>>;
+
+        check = test_mtree<Gadget, true>(Gadget::LEAVES_N - 1);
     }
     std::cout << check << '\n';
     all_check &= check;
@@ -206,6 +288,33 @@ static bool run_tests()
     std::cout << check << '\n';
     all_check &= check;
 
+    std::cout << "Index checks... ";
+    std::cout.flush();
+    {
+        using Gadget = MTreeGadget<TREE_HEIGHT, Poseidon5Gadget<Poseidon5<FieldT, 2, 1>>>;
+        using Gadget4 = MTreeGadget<TREE_HEIGHT, Poseidon5Gadget<Poseidon5<FieldT, 4, 1, 4, 60>>>;
+
+        // the last and a middle leaf of a complete tree, leaves of partial trees
+        check = check_index<Gadget>(Gadget::LEAVES_N, Gadget::LEAVES_N - 1);
+        check &= check_index<Gadget>(Gadget::LEAVES_N, 5);
+        check &= check_index<Gadget>(5, 4) && check_index<Gadget>(5, 2);
+        check &= check_index<Gadget4>(Gadget4::LEAVES_N, Gadget4::LEAVES_N - 1);
+        check &= check_index<Gadget4>(37, 36) && check_index<Gadget4>(37, 13);
+
+        // past the last leaf
+        check &= !check_index<Gadget>(5, 5) && !check_index<Gadget>(5, Gadget::LEAVES_N - 1);
+        check &= !check_index<Gadget>(1, 1);
+        check &= !check_index<Gadget4>(37, 37) && !check_index<Gadget4>(37, 39);
+        check &= !check_index<Gadget4>(37, 52);
+
+        // no choice or two choices at the leaf level
+        check &= !check_index<Gadget>(Gadget::LEAVES_N, 2, 0);
+        check &= !check_index<Gadget>(Gadget::LEAVES_N, 3, 2);
+        check &= !check_index<Gadget4>(37, 36, 0) && !check_index<Gadget4>(37, 35, 2);
+    }
+    std::cout << check << '\n';
+    all_check &= check;
+
 
     return all_check;
 }